@@ -0,0 +1,59 @@
+#include "header.h"
+
+void adaptiveStart(Adaptive *adaptive, uint64_t min, uint64_t max, uint64_t interval) {
+    memset(adaptive, 0, sizeof(*adaptive));
+    adaptive->min = min;
+    adaptive->max = max;
+    adaptive->interval = interval < min ? min : interval > max ? max : interval;
+}
+
+uint64_t adaptiveUpdate(Adaptive *adaptive, const HistorySample *sample) {
+    if (adaptive->samples++ == 0) {
+        // The first sample has no previous one to compare with
+        adaptive->first = sample->timestamp;
+    }
+    else {
+        double cpu_change = fabs(sample->cpu_usage - adaptive->last_cpu) / ADAPTIVE_CPU_STEP;
+        double memory_change = fabs(sample->memory_delta) / ADAPTIVE_MEMORY_STEP;
+        double change = cpu_change > memory_change ? cpu_change : memory_change;
+        uint64_t interval = adaptive->interval;
+        if (change >= 1.0 || sample->cpu_usage >= ADAPTIVE_CPU_HIGH) {
+            // Follow a spike from its next sample on rather than halving towards it
+            interval = adaptive->min;
+        }
+        else if (change < 0.25) {
+            interval = interval > adaptive->max / 2 ? adaptive->max : interval * 2;
+        }
+        if (interval != adaptive->interval) {
+            adaptive->interval = interval;
+            adaptive->changes++;
+        }
+    }
+    adaptive->last_cpu = sample->cpu_usage;
+    adaptive->last = sample->timestamp;
+    if (adaptive->interval == adaptive->min) {
+        adaptive->fast++;
+    }
+    return adaptive->interval;
+}
+
+void adaptiveReport(const Adaptive *adaptive, const SelfStats *self, FILE *out) {
+    if (adaptive->samples < 2) {
+        return;
+    }
+    char min[32], max[32];
+    formatDuration(adaptive->min, min, sizeof(min));
+    formatDuration(adaptive->max, max, sizeof(max));
+    double span = (double) (adaptive->last - adaptive->first);
+    double rate = (adaptive->samples - 1) / (span / 1e9);
+    fprintf(out, "Adaptive: %ld samples in %.1f s between %s and %s -- effective %.2f samples/s (every %.1f ms), %ld changes, %.0f%% of samples at %s\n",
+            adaptive->samples, span / 1e9, min, max, rate, span / 1e6 / (adaptive->samples - 1),
+            adaptive->changes, 100.0 * adaptive->fast / adaptive->samples, min);
+    // Sampling at the shortest interval throughout is what catches the same spikes without adapting
+    double fixed = span / (double) adaptive->min + 1;
+    double saved = fixed - adaptive->samples;
+    if (saved < 0) saved = 0;
+    double cpu = histMean(&self->cpu);
+    fprintf(out, "Overhead saved against a fixed %s: %.0f samples (%.0f%%), about %.1f ms of CPU at %.1f us per sample\n",
+            min, saved, 100.0 * saved / fixed, saved * cpu / 1e6, cpu / 1e3);
+}
@@ -0,0 +1,170 @@
+#include "header.h"
+#include <sys/un.h>
+
+static const char *metricNames[METRIC_COUNT] = { "cpu", "memory", "available", "sessions" };
+
+bool alertParse(AlertRule *rule, const char *spec) {
+    memset(rule, 0, sizeof(*rule));
+    if (!spec || strlen(spec) >= sizeof(rule->spec)) {
+        return false;
+    }
+    snprintf(rule->spec, sizeof(rule->spec), "%s", spec);
+    size_t name_len = strcspn(spec, "<>:");
+    int m;
+    for (m = 0; m < METRIC_COUNT; m++) {
+        if (strlen(metricNames[m]) == name_len && strncmp(spec, metricNames[m], name_len) == 0) break;
+    }
+    if (m == METRIC_COUNT) {
+        return false;
+    }
+    rule->metric = (AlertMetric) m;
+    const char *p = spec + name_len;
+    char *end;
+    if (strncmp(p, ":z=", 3) == 0) {
+        rule->kind = ALERT_SPIKE;
+        rule->threshold = strtod(p + 3, &end);
+        return end != p + 3 && *end == '\0' && rule->threshold > 0;
+    }
+    if (*p != '>' && *p != '<') {
+        return false;
+    }
+    rule->kind = *p == '>' ? ALERT_ABOVE : ALERT_BELOW;
+    rule->threshold = strtod(p + 1, &end);
+    if (end == p + 1) {
+        return false;
+    }
+    rule->samples = ALERT_DEFAULT_SAMPLES;
+    if (*end == ':') {
+        if (!isInteger(end + 1) || (rule->samples = atoi(end + 1)) <= 0) return false;
+        return true;
+    }
+    return *end == '\0';
+}
+
+int alertsOpen(Alerts *alerts, const Options *opts) {
+    memset(alerts, 0, sizeof(*alerts));
+    alerts->fd = -1;
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    uint64_t mono = nowNanos();
+    alerts->wall_offset = (int64_t) ((uint64_t) real.tv_sec * 1000000000ull + (uint64_t) real.tv_nsec) - (int64_t) mono;
+    for (int r = 0; r < opts->alert_count; r++) {
+        AlertRule *rule = &alerts->rules[alerts->count];
+        if (!alertParse(rule, opts->alerts[r])) {
+            errno = EINVAL;
+            return -1;
+        }
+        // A value that is not collected would read as 0 and fire or never fire for no reason
+        bool collected = rule->metric == METRIC_SESSIONS ? opts->user : opts->sys;
+        if (!collected) {
+            errno = EINVAL;
+            return -1;
+        }
+        alerts->count++;
+    }
+    if (opts->alert_to) {
+        // Datagrams never block the sampler: with nobody listening, a line is dropped and counted
+        if (strncmp(opts->alert_to, "unix:", 5) != 0 || serveAddress(opts->alert_to, &alerts->addr, &alerts->addr_len) == -1) {
+            errno = EINVAL;
+            return -1;
+        }
+        alerts->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (alerts->fd == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns the value a rule watches in a sample.
+ */
+static double metricValue(AlertMetric metric, const HistorySample *sample, int sessions) {
+    switch (metric) {
+        case METRIC_CPU: return sample->cpu_usage;
+        case METRIC_MEMORY: return sample->memory.used_memory;
+        case METRIC_AVAILABLE: return sample->memory.available;
+        default: return (double) sessions;
+    }
+}
+
+/**
+ * Writes one alert line to stderr or to the socket.
+ */
+static void sendAlert(Alerts *alerts, const AlertRule *rule, uint64_t timestamp, double value, double mean, double sd, double z) {
+    char line[ALERT_LINE_MAX];
+    double wall = (double) ((int64_t) timestamp + alerts->wall_offset) / 1e9;
+    int n = snprintf(line, sizeof(line),
+        "{\"time\":%.3f,\"mono_ns\":%llu,\"alert\":\"%s\",\"state\":\"%s\",\"metric\":\"%s\",\"value\":%.3f,\"mean\":%.3f,\"sd\":%.3f,\"z\":%.2f}\n",
+        wall, (unsigned long long) timestamp, rule->spec, rule->firing ? "firing" : "resolved",
+        metricNames[rule->metric], value, mean, sd, z);
+    if (n <= 0 || (size_t) n >= sizeof(line)) {
+        return;
+    }
+    if (alerts->fd == -1) {
+        fputs(line, stderr);
+        alerts->sent++;
+    }
+    else if (sendto(alerts->fd, line, (size_t) n, 0, (struct sockaddr *) &alerts->addr, alerts->addr_len) == n) {
+        alerts->sent++;
+    }
+    else {
+        alerts->dropped++;
+    }
+}
+
+void alertsEvaluate(Alerts *alerts, const HistorySample *sample, int sessions) {
+    for (int r = 0; r < alerts->count; r++) {
+        AlertRule *rule = &alerts->rules[r];
+        double value = metricValue(rule->metric, sample, sessions);
+        // The z-score is judged against the statistics before this sample joins them
+        double sd = sqrt(rule->variance);
+        double diff = value - rule->mean;
+        double z = rule->seen == 0 ? 0.0 : sd > 1e-9 ? diff / sd : (fabs(diff) > 1e-9 ? copysign(1e9, diff) : 0.0);
+        double mean = rule->mean;
+        if (rule->seen++ == 0) {
+            rule->mean = value;
+        }
+        else {
+            double step = ALERT_EWMA_ALPHA * diff;
+            rule->mean += step;
+            rule->variance = (1.0 - ALERT_EWMA_ALPHA) * (rule->variance + diff * step);
+        }
+
+        bool change;
+        if (rule->kind == ALERT_SPIKE) {
+            // A spike resolves once samples are back within half the z-score that raised it
+            if (rule->seen <= ALERT_WARMUP) change = false;
+            else change = rule->firing ? fabs(z) < rule->threshold / 2 : fabs(z) >= rule->threshold;
+        }
+        else {
+            double margin = fabs(rule->threshold) * ALERT_HYSTERESIS;
+            bool beyond = rule->kind == ALERT_ABOVE ? value > rule->threshold : value < rule->threshold;
+            bool back = rule->kind == ALERT_ABOVE ? value < rule->threshold - margin : value > rule->threshold + margin;
+            // Each transition needs its own run of samples, so one outlier neither raises nor clears it
+            rule->streak = (rule->firing ? back : beyond) ? rule->streak + 1 : 0;
+            change = rule->streak >= rule->samples;
+        }
+        if (change) {
+            rule->firing = !rule->firing;
+            rule->streak = 0;
+            if (rule->firing) rule->fired++;
+            sendAlert(alerts, rule, sample->timestamp, value, mean, sd, z);
+        }
+    }
+}
+
+void alertsClose(Alerts *alerts, FILE *out) {
+    if (alerts->count > 0) {
+        fprintf(out, "Alerts: %ld lines sent, %ld dropped --", alerts->sent, alerts->dropped);
+        for (int r = 0; r < alerts->count; r++) {
+            const AlertRule *rule = &alerts->rules[r];
+            fprintf(out, " %s fired %ld times%s%s", rule->spec, rule->fired, rule->firing ? " (still firing)" : "",
+                    r + 1 < alerts->count ? "," : "\n");
+        }
+    }
+    if (alerts->fd != -1) {
+        close(alerts->fd);
+    }
+    alerts->fd = -1;
+}
@@ -0,0 +1,635 @@
+#include "header.h"
+#include <malloc.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+static const char *engineNames[] = { "fork", "process", "thread", "inline" };
+
+const char *engineName(EngineMode mode) {
+    return engineNames[mode];
+}
+
+void benchEngines(const Options *opts) {
+    int samples = opts->samples > 0 ? opts->samples : 1;
+    printf("Sampling engine latency over %d samples (%s%s%s)\n", samples,
+           opts->sys ? "memory, cpu" : "", opts->sys && opts->user ? ", " : "", opts->user ? "users" : "");
+    printf("%-8s %12s %12s %12s\n", "engine", "min (us)", "avg (us)", "max (us)");
+
+    for (int mode = ENGINE_FORK; mode <= ENGINE_INLINE; mode++) {
+        SampleEngine engine;
+        SampleSet set = {0};
+        if (startEngine(&engine, (EngineMode) mode, opts->sys, opts->user) == -1) {
+            perror("Collector start failed");
+            exit(EXIT_FAILURE);
+        }
+        // One untimed sample so that start-up costs are not counted
+        if (engineSample(&engine, &set) == -1) {
+            perror("Sampling failed");
+            exit(EXIT_FAILURE);
+        }
+        uint64_t min = UINT64_MAX, max = 0, total = 0;
+        for (int i = 0; i < samples; i++) {
+            uint64_t start = nowNanos();
+            if (engineSample(&engine, &set) == -1) {
+                perror("Sampling failed");
+                exit(EXIT_FAILURE);
+            }
+            uint64_t elapsed = nowNanos() - start;
+            total += elapsed;
+            if (elapsed < min) min = elapsed;
+            if (elapsed > max) max = elapsed;
+        }
+        stopEngine(&engine);
+        freeSampleSet(&set);
+        printf("%-8s %12.1f %12.1f %12.1f\n", engineName((EngineMode) mode),
+               min / 1000.0, total / 1000.0 / samples, max / 1000.0);
+    }
+}
+
+/**
+ * Opens a file with stdio, below --proc-root like the ProcFile readers.
+ */
+static FILE *openRooted(const char *path) {
+    char rooted[PROC_PATH_LEN];
+    const char *file = procPath(path, rooted, sizeof(rooted));
+    return file ? fopen(file, "r") : NULL;
+}
+
+/**
+ * The /proc/stat parser as it was before the ProcFile readers.
+ */
+static int stdioCpuStats(CPU *cpu_stats) {
+    FILE *fp = openRooted("/proc/stat");
+    if (!fp) return -1;
+    long int user, nice, system, idle, iowait, irq, softirq;
+    int read_items = fscanf(fp, "cpu %ld %ld %ld %ld %ld %ld %ld",
+                            &user, &nice, &system, &idle, &iowait, &irq, &softirq);
+    fclose(fp);
+    if (read_items != 7) return -1;
+    cpu_stats->tot = user + nice + system + iowait + irq + softirq;
+    cpu_stats->time = idle;
+    return 0;
+}
+
+/**
+ * The /proc/cpuinfo parser as it was before the ProcFile readers.
+ */
+static int stdioCoreCount(void) {
+    FILE *fp = openRooted("/proc/cpuinfo");
+    if (!fp) return -1;
+    char line[256];
+    int cores = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "processor", 9) == 0) cores++;
+    }
+    fclose(fp);
+    return cores;
+}
+
+/**
+ * A /proc/meminfo parser that matches every line against every key by name.
+ */
+static int stdioMeminfo(uint64_t *values) {
+    static const char *keys[MEMINFO_FIELDS] = {
+        "MemTotal:", "MemFree:", "MemAvailable:", "Buffers:", "Cached:", "SwapTotal:", "SwapFree:",
+        "Dirty:", "Writeback:", "AnonPages:", "Slab:", "HugePages_Total:", "HugePages_Free:", "Hugepagesize:",
+    };
+    FILE *fp = openRooted("/proc/meminfo");
+    if (!fp) return -1;
+    char line[256], name[64];
+    unsigned long value;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%63s %lu", name, &value) != 2) continue;
+        for (int f = 0; f < MEMINFO_FIELDS; f++) {
+            if (strcmp(name, keys[f]) == 0) values[f] = value;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * A /proc/pressure parser that opens the file and scans each line with fscanf.
+ */
+static int stdioPressure(const char *path, PressureLine *some, PressureLine *full) {
+    FILE *fp = openRooted(path);
+    if (!fp) return -1;
+    int read_items = fscanf(fp, "some avg10=%lf avg60=%lf avg300=%lf total=%lu\n", &some->avg10, &some->avg60, &some->avg300, &some->total);
+    fscanf(fp, "full avg10=%lf avg60=%lf avg300=%lf total=%lu", &full->avg10, &full->avg60, &full->avg300, &full->total);
+    fclose(fp);
+    return read_items == 4 ? 0 : -1;
+}
+
+/**
+ * A /proc/loadavg parser that opens the file and reads it with fscanf.
+ */
+static int stdioLoadavg(LoadAvg *load) {
+    FILE *fp = openRooted("/proc/loadavg");
+    if (!fp) return -1;
+    int read_items = fscanf(fp, "%lf %lf %lf %d/%d", &load->load1, &load->load5, &load->load15, &load->running, &load->tasks);
+    fclose(fp);
+    return read_items == 5 ? 0 : -1;
+}
+
+/**
+ * A /proc/diskstats parser that opens the file and scans each line with sscanf.
+ */
+static int stdioDiskstats(DiskCounters *devices, int cap) {
+    FILE *fp = openRooted("/proc/diskstats");
+    if (!fp) return -1;
+    char line[512];
+    int count = 0;
+    unsigned long merged, inflight;
+    while (count < cap && fgets(line, sizeof(line), fp)) {
+        DiskCounters *disk = &devices[count];
+        if (sscanf(line, "%*u %*u %31s %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu", disk->name, &disk->reads, &merged,
+                   &disk->read_sectors, &disk->read_ms, &disk->writes, &merged, &disk->write_sectors, &disk->write_ms,
+                   &inflight, &disk->io_ms) == 11) count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+/**
+ * A /proc/net/dev parser that opens the file and scans each line with sscanf.
+ */
+static int stdioNetdev(NetCounters *interfaces, int cap) {
+    FILE *fp = openRooted("/proc/net/dev");
+    if (!fp) return -1;
+    char line[512];
+    int count = 0;
+    while (count < cap && fgets(line, sizeof(line), fp)) {
+        NetCounters *net = &interfaces[count];
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+        *colon = ' ';
+        if (sscanf(line, "%31s %lu %lu %*u %*u %*u %*u %*u %*u %lu %lu", net->name, &net->rx_bytes, &net->rx_packets,
+                   &net->tx_bytes, &net->tx_packets) == 5) count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+/**
+ * The /proc/uptime parser as it was before the ProcFile readers.
+ */
+static int stdioUptime(double *seconds) {
+    FILE *fp = openRooted("/proc/uptime");
+    if (!fp) return -1;
+    float uptime_seconds;
+    int read_items = fscanf(fp, "%f", &uptime_seconds);
+    fclose(fp);
+    *seconds = uptime_seconds;
+    return read_items == 1 ? 0 : -1;
+}
+
+static void reportParse(const char *name, const char *path, uint64_t stdio_ns, uint64_t proc_ns, int samples) {
+    printf("%-10s %-14s %12.0f %12.0f %8.1fx\n", name, path, (double) stdio_ns / samples,
+           (double) proc_ns / samples, (double) stdio_ns / (proc_ns ? proc_ns : 1));
+}
+
+void benchParsers(const Options *opts) {
+    int samples = opts->samples > 0 ? opts->samples : 1;
+    ProcFile stat, cpuinfo, uptime, meminfo, loadavg, diskstats, netdev;
+    if (procOpen(&stat, "/proc/stat", PROC_STAT_SIZE) == -1 ||
+        procOpen(&diskstats, "/proc/diskstats", PROC_DISKSTATS_SIZE) == -1 ||
+        procOpen(&netdev, "/proc/net/dev", PROC_NETDEV_SIZE) == -1 ||
+        procOpen(&loadavg, "/proc/loadavg", PROC_PRESSURE_SIZE) == -1 ||
+        procOpen(&meminfo, "/proc/meminfo", PROC_MEMINFO_SIZE) == -1 ||
+        procOpen(&cpuinfo, "/proc/cpuinfo", PROC_CPUINFO_SIZE) == -1 ||
+        procOpen(&uptime, "/proc/uptime", PROC_UPTIME_SIZE) == -1) {
+        perror("Error opening /proc");
+        exit(EXIT_FAILURE);
+    }
+    CPU cpu;
+    double seconds;
+    int failures = 0;
+    uint64_t start, stdio_ns, proc_ns;
+
+    printf("Parse cost over %d parses\n", samples);
+    printf("%-10s %-14s %12s %12s %9s\n", "parser", "file", "stdio (ns)", "procfs (ns)", "speedup");
+
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += stdioCpuStats(&cpu) != 0;
+    stdio_ns = nowNanos() - start;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += procRead(&stat) != 0 || parseCpuStats(stat.buf, &cpu) != 0;
+    proc_ns = nowNanos() - start;
+    reportParse("cpu", "/proc/stat", stdio_ns, proc_ns, samples);
+
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += stdioCoreCount() <= 0;
+    stdio_ns = nowNanos() - start;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += procRead(&cpuinfo) != 0 || parseCoreCount(cpuinfo.buf) <= 0;
+    proc_ns = nowNanos() - start;
+    reportParse("cores", "/proc/cpuinfo", stdio_ns, proc_ns, samples);
+
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += stdioUptime(&seconds) != 0;
+    stdio_ns = nowNanos() - start;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += procRead(&uptime) != 0 || parseUptime(uptime.buf, &seconds) != 0;
+    proc_ns = nowNanos() - start;
+    reportParse("uptime", "/proc/uptime", stdio_ns, proc_ns, samples);
+
+    uint64_t values[MEMINFO_FIELDS];
+    MeminfoIndex index = { .built = false };
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += stdioMeminfo(values) != 0;
+    stdio_ns = nowNanos() - start;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += procRead(&meminfo) != 0 || parseMeminfo(meminfo.buf, meminfo.len, &index, values) != 0;
+    proc_ns = nowNanos() - start;
+    reportParse("meminfo", "/proc/meminfo", stdio_ns, proc_ns, samples);
+
+    LoadAvg load;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += stdioLoadavg(&load) != 0;
+    stdio_ns = nowNanos() - start;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += procRead(&loadavg) != 0 || parseLoadavg(loadavg.buf, &load) != 0;
+    proc_ns = nowNanos() - start;
+    reportParse("loadavg", "/proc/loadavg", stdio_ns, proc_ns, samples);
+
+    DiskCounters devices[DISK_MAX_DEVICES];
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += stdioDiskstats(devices, DISK_MAX_DEVICES) == -1;
+    stdio_ns = nowNanos() - start;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += procRead(&diskstats) != 0 || parseDiskstats(diskstats.buf, devices, DISK_MAX_DEVICES) == -1;
+    proc_ns = nowNanos() - start;
+    reportParse("diskstats", "/proc/diskstats", stdio_ns, proc_ns, samples);
+
+    NetCounters interfaces[NET_MAX_INTERFACES];
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += stdioNetdev(interfaces, NET_MAX_INTERFACES) == -1;
+    stdio_ns = nowNanos() - start;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += procRead(&netdev) != 0 || parseNetdev(netdev.buf, interfaces, NET_MAX_INTERFACES) == -1;
+    proc_ns = nowNanos() - start;
+    reportParse("netdev", "/proc/net/dev", stdio_ns, proc_ns, samples);
+
+    // Kernels without pressure stall information only have the load row
+    ProcFile cpu_pressure;
+    if (procOpen(&cpu_pressure, "/proc/pressure/cpu", PROC_PRESSURE_SIZE) == 0) {
+        PressureLine some, full;
+        start = nowNanos();
+        for (int i = 0; i < samples; i++) failures += stdioPressure("/proc/pressure/cpu", &some, &full) != 0;
+        stdio_ns = nowNanos() - start;
+        start = nowNanos();
+        for (int i = 0; i < samples; i++) failures += procRead(&cpu_pressure) != 0 || parsePressure(cpu_pressure.buf, &some, &full) == -1;
+        proc_ns = nowNanos() - start;
+        reportParse("pressure", "/proc/pressure", stdio_ns, proc_ns, samples);
+        procClose(&cpu_pressure);
+    }
+
+    // Walking utmp with getutent on every sample, against the session watch when nothing changed
+    char *list = NULL;
+    size_t len = 0, cap = 0;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += readSessions(&list, &len, &cap) != 0;
+    stdio_ns = nowNanos() - start;
+    free(list);
+    SessionWatch watch;
+    sessionsOpen(&watch);
+    failures += sessionsRefresh(&watch) == -1;
+    start = nowNanos();
+    for (int i = 0; i < samples; i++) failures += sessionsRefresh(&watch) == -1;
+    proc_ns = nowNanos() - start;
+    sessionsClose(&watch);
+    reportParse("sessions", _PATH_UTMP, stdio_ns, proc_ns, samples);
+
+    procClose(&stat);
+    procClose(&cpuinfo);
+    procClose(&uptime);
+    procClose(&meminfo);
+    procClose(&loadavg);
+    procClose(&diskstats);
+    procClose(&netdev);
+    if (index.rebuilds > 1) {
+        printf("The /proc/meminfo index was rebuilt %ld times\n", index.rebuilds - 1);
+    }
+    if (failures) {
+        fprintf(stderr, "%d parses failed\n", failures);
+    }
+}
+
+/**
+ * Builds a stream of records that moves like a lightly loaded host sampled at `interval`:
+ * it starts from the live counters, the timestamps jitter around the sampling grid, the CPU
+ * counters advance by a varying load, and used memory drifts (and available memory with it).
+ */
+static void syntheticRecords(SampleRecord *records, long count, uint64_t interval) {
+    SampleSet set = {0};
+    if (readMemoryInfo(&set.memory) != 0 || readCpuStats(&set.cpu) != 0) {
+        perror("Error reading /proc");
+        exit(EXIT_FAILURE);
+    }
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    set.timestamp = nowNanos();
+    int64_t wall_offset = (int64_t) real.tv_sec * 1000000000ll + real.tv_nsec - (int64_t) set.timestamp;
+    int cores = count_cores();
+    SampleRecord record;
+    recordFromSample(&set, cores, 1, wall_offset, &record);
+    // USER_HZ ticks per core over one interval
+    int64_t ticks = (int64_t) (interval / 10000000ull) * cores;
+    uint64_t grid = record.timestamp;
+    srand(1);
+    for (long i = 0; i < count; i++) {
+        records[i] = record;
+        grid += interval;
+        record.timestamp = grid + (uint64_t) (rand() % 100000);
+        record.wall_time = (int64_t) record.timestamp + wall_offset;
+        int64_t busy = ticks * (rand() % 30) / 100;
+        record.cpu_tot += busy;
+        record.cpu_idle += ticks - busy;
+        int64_t drift = rand() % 4 == 0 ? (rand() % 2048) - 1024 : 0;
+        record.used_memory_kb += drift;
+        record.used_virtual_kb += drift;
+        record.available_kb -= drift;
+    }
+}
+
+void benchCodec(const Options *opts) {
+    long count = opts->samples > 0 ? opts->samples : 1;
+    SampleRecord *records;
+    Replay replay;
+    char source[MAX_STR_LEN];
+    uint64_t interval = opts->interval;
+    if (opts->replay) {
+        // Encode a real recording instead of a synthetic stream
+        if (replayOpen(&replay, opts->replay) == -1) {
+            perror("Error opening recording");
+            exit(EXIT_FAILURE);
+        }
+        count = replay.count > 0 ? replay.count : 1;
+        interval = replay.header->interval;
+        records = calloc((size_t) count, sizeof(*records));
+        if (!records) {
+            perror("Allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        for (long i = 0; replayNext(&replay, &records[i]); i++);
+        replayClose(&replay);
+        snprintf(source, sizeof(source), "%s", opts->replay);
+    }
+    else {
+        records = malloc((size_t) count * sizeof(*records));
+        if (!records) {
+            perror("Allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        syntheticRecords(records, count, interval);
+        char every[32];
+        formatDuration(interval, every, sizeof(every));
+        snprintf(source, sizeof(source), "synthetic, every %s", every);
+    }
+    uint8_t *packed = malloc((size_t) count * RECORD_PACKED_MAX);
+    if (!packed) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    Codec codec;
+    codecInit(&codec, interval);
+    size_t bytes = 0;
+    uint64_t start = nowNanos();
+    for (long i = 0; i < count; i++) {
+        bytes += codecEncode(&codec, &records[i], packed + bytes);
+    }
+    uint64_t encode_ns = nowNanos() - start;
+
+    codecInit(&codec, interval);
+    SampleRecord record;
+    long mismatches = 0;
+    const uint8_t *p = packed, *end = packed + bytes;
+    start = nowNanos();
+    for (long i = 0; i < count && p; i++) {
+        p = codecDecode(&codec, p, end, &record);
+        mismatches += memcmp(&record, &records[i], sizeof(record)) != 0;
+    }
+    uint64_t decode_ns = nowNanos() - start;
+
+    double per_sample = (double) bytes / count;
+    printf("Recording codec over %ld samples (%s)\n", count, source);
+    printf("%-22s %12zu bytes/sample\n", "raw records", sizeof(SampleRecord));
+    printf("%-22s %12.2f bytes/sample (%.1fx smaller)\n", "packed records", per_sample, sizeof(SampleRecord) / per_sample);
+    printf("%-22s %12.1f ns/sample\n", "encode", (double) encode_ns / count);
+    printf("%-22s %12.1f ns/sample, %.0f samples/s, %.0f MB/s packed\n", "decode", (double) decode_ns / count,
+           count / (decode_ns / 1e9), bytes / (decode_ns / 1e3));
+    printf("%-22s %12.2f MB\n", "one week of 1-sec", per_sample * 7 * 24 * 3600 / 1e6);
+    if (mismatches) {
+        fprintf(stderr, "%ld samples did not decode to the original\n", mismatches);
+    }
+    free(packed);
+    free(records);
+}
+
+void benchLibrary(const Options *opts) {
+    int samples = opts->samples > 0 ? opts->samples : 1;
+    static const struct { const char *name; unsigned flags; } sets[] = {
+        { "memory", SYSSTATS_MEMORY },
+        { "cpu", SYSSTATS_CPU },
+        { "sessions", SYSSTATS_SESSIONS },
+        { "all", SYSSTATS_ALL },
+    };
+    SysStatsSnapshot *snapshot = malloc(sizeof(*snapshot));
+    if (!snapshot) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    printf("sysstats_sample cost over %d calls\n", samples);
+    printf("%-10s %12s %12s %12s %14s\n", "collectors", "min (ns)", "avg (ns)", "max (ns)", "heap growth");
+    for (size_t k = 0; k < sizeof(sets) / sizeof(sets[0]); k++) {
+        SysStats *stats = sysstats_open(sets[k].flags);
+        if (!stats || sysstats_sample(stats, snapshot) == -1) {
+            perror("Sampling failed");
+            exit(EXIT_FAILURE);
+        }
+        // Any allocation kept across calls would show up as heap growth
+        size_t heap = mallinfo2().uordblks;
+        uint64_t min = UINT64_MAX, max = 0, total = 0;
+        for (int i = 0; i < samples; i++) {
+            uint64_t start = nowNanos();
+            if (sysstats_sample(stats, snapshot) == -1) {
+                perror("Sampling failed");
+                exit(EXIT_FAILURE);
+            }
+            uint64_t elapsed = nowNanos() - start;
+            total += elapsed;
+            if (elapsed < min) min = elapsed;
+            if (elapsed > max) max = elapsed;
+        }
+        long growth = (long) (mallinfo2().uordblks - heap);
+        sysstats_close(stats);
+        printf("%-10s %12.0f %12.0f %12.0f %12ld B\n", sets[k].name, (double) min, (double) total / samples, (double) max, growth);
+    }
+    free(snapshot);
+}
+
+/**
+ * Opens one load-test connection and sends the scrape request.
+ */
+static int openScrape(const struct sockaddr_storage *addr, socklen_t len, int epoll_fd, BenchScrape *scrape) {
+    scrape->fd = socket(addr->ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (scrape->fd == -1) {
+        return -1;
+    }
+    scrape->start = nowNanos();
+    scrape->received = 0;
+    scrape->ok = false;
+    if (connect(scrape->fd, (const struct sockaddr *) addr, len) == -1 && errno != EINPROGRESS) {
+        close(scrape->fd);
+        return -1;
+    }
+    // Wait until the connection is up before sending the request
+    struct epoll_event event = { .events = EPOLLOUT, .data.ptr = scrape };
+    scrape->sent = false;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, scrape->fd, &event) == -1) {
+        close(scrape->fd);
+        return -1;
+    }
+    return 0;
+}
+
+void benchServe(const Options *opts) {
+    long total = opts->samples > 0 ? opts->samples : 1;
+    struct sockaddr_storage addr;
+    socklen_t len;
+    if (!opts->serve || serveAddress(opts->serve, &addr, &len) == -1) {
+        fprintf(stderr, "--bench=serve needs the address of a running server, e.g. --serve=unix:/tmp/mySystemStats.sock\n");
+        exit(EXIT_FAILURE);
+    }
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    BenchScrape *scrapes = calloc(SERVE_BENCH_CONNECTIONS, sizeof(*scrapes));
+    if (epoll_fd == -1 || !scrapes) {
+        perror("Load test setup failed");
+        exit(EXIT_FAILURE);
+    }
+    Histogram latency;
+    histInit(&latency);
+    long started = 0, done = 0, failed = 0;
+    uint64_t bytes = 0;
+    int open = 0;
+    uint64_t start = nowNanos();
+    for (int k = 0; k < SERVE_BENCH_CONNECTIONS && started < total; k++, started++) {
+        if (openScrape(&addr, len, epoll_fd, &scrapes[k]) == -1) failed++;
+        else open++;
+    }
+    struct epoll_event events[64];
+    char buf[4096];
+    while (open > 0) {
+        int n = epoll_wait(epoll_fd, events, 64, 5000);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            fprintf(stderr, "Load test stalled with %d open connections\n", open);
+            break;
+        }
+        for (int e = 0; e < n; e++) {
+            BenchScrape *scrape = events[e].data.ptr;
+            bool finished = false;
+            if (!scrape->sent) {
+                static const char request[] = "GET /metrics HTTP/1.0\r\nHost: localhost\r\n\r\n";
+                if (send(scrape->fd, request, sizeof(request) - 1, MSG_NOSIGNAL) != (ssize_t) sizeof(request) - 1) {
+                    finished = true;
+                }
+                else {
+                    scrape->sent = true;
+                    struct epoll_event event = { .events = EPOLLIN, .data.ptr = scrape };
+                    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, scrape->fd, &event);
+                }
+            }
+            else {
+                ssize_t got;
+                while ((got = recv(scrape->fd, buf, sizeof(buf), 0)) > 0) {
+                    if (scrape->received == 0) scrape->ok = got >= 12 && memcmp(buf, "HTTP/1.0 200", 12) == 0;
+                    scrape->received += (size_t) got;
+                }
+                finished = got == 0 || (got == -1 && errno != EAGAIN);
+            }
+            if (!finished) {
+                continue;
+            }
+            close(scrape->fd);
+            open--;
+            if (scrape->ok) {
+                histAdd(&latency, nowNanos() - scrape->start);
+                bytes += scrape->received;
+                done++;
+            }
+            else {
+                failed++;
+            }
+            if (started < total) {
+                started++;
+                if (openScrape(&addr, len, epoll_fd, scrape) == -1) failed++;
+                else open++;
+            }
+        }
+    }
+    uint64_t elapsed = nowNanos() - start;
+    close(epoll_fd);
+    free(scrapes);
+    printf("Load test of %s: %ld scrapes over %d connections\n", opts->serve, total, SERVE_BENCH_CONNECTIONS);
+    printf("%ld ok, %ld failed, %.0f scrapes/s, %.0f bytes/scrape\n", done, failed,
+           done / (elapsed / 1e9), done ? (double) bytes / done : 0.0);
+    if (done > 0) {
+        printf("Latency (ms): p50 %.3f p99 %.3f max %.3f\n", histPercentile(&latency, 50) / 1e6,
+               histPercentile(&latency, 99) / 1e6, latency.max / 1e6);
+    }
+}
+
+void benchTop(const Options *opts) {
+    int scans = opts->samples > 0 ? opts->samples : 1;
+    ProcTop top;
+    if (topOpen(&top, opts->top > 0 ? opts->top : DEFAULT_TOP) == -1) {
+        perror("Error opening /proc");
+        exit(EXIT_FAILURE);
+    }
+    pid_t *children = malloc(TOP_BENCH_PIDS * sizeof(pid_t));
+    if (!children) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    int started = 0;
+    printf("Process scan cost over %d scans (%d scan threads besides the caller)\n", scans, top.threads);
+    printf("%10s %12s %12s %12s\n", "processes", "min (ms)", "avg (ms)", "us/process");
+    // Idle children raise the process count in steps
+    for (int target = 0; target <= TOP_BENCH_PIDS; target = target ? target * 2 : 1000) {
+        fflush(stdout);
+        while (started < target) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                for (;;) pause();
+            }
+            if (pid == -1) {
+                break;
+            }
+            children[started++] = pid;
+        }
+        if (topScan(&top, nowNanos()) == -1) {
+            perror("Scan failed");
+            break;
+        }
+        uint64_t min = UINT64_MAX, total = 0;
+        for (int i = 0; i < scans; i++) {
+            if (topScan(&top, nowNanos()) == -1) {
+                perror("Scan failed");
+                break;
+            }
+            total += top.scan_ns;
+            if (top.scan_ns < min) min = top.scan_ns;
+        }
+        printf("%10d %12.3f %12.3f %12.2f\n", top.live, min / 1e6, total / 1e6 / scans, total / 1e3 / scans / (top.live ? top.live : 1));
+        if (started < target) {
+            fprintf(stderr, "Stopped at %d extra processes: %s\n", started, strerror(errno));
+            break;
+        }
+    }
+    for (int k = 0; k < started; k++) kill(children[k], SIGKILL);
+    for (int k = 0; k < started; k++) waitpid(children[k], NULL, 0);
+    free(children);
+    topClose(&top);
+}
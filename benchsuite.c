@@ -0,0 +1,334 @@
+#define _GNU_SOURCE
+#include "header.h"
+#include <fcntl.h>
+
+/**
+ * The benchmark suite behind `make bench`: every collector and parser on live /proc and on
+ * a captured fixture, every graph and render function at large history sizes, and the
+ * sampling loop at fixed rates. Each benchmark is one CSV row with its nanoseconds and
+ * allocations per operation, so that two runs can be diffed between commits.
+ */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static long allocations;
+
+// These replace the allocator of the whole process, libc included, so fopen's buffers count too
+void *malloc(size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+/**
+ * Everything the benchmarks share: the live readers, the fixture contents and the display state.
+ */
+typedef struct {
+    ProcFile stat, cpuinfo, uptime, meminfo, loadavg, diskstats, netdev, pressure;
+    char *fixture[8];
+    size_t fixture_len[8];
+    MeminfoIndex index;
+    CpuSample cpu;
+    DiskCounters devices[DISK_MAX_DEVICES];
+    NetCounters interfaces[NET_MAX_INTERFACES];
+    History history;
+    Frame frame;
+    SessionWatch sessions;
+    ProcTop top;
+    char *list;
+    size_t list_len, list_cap;
+} Suite;
+
+/**
+ * The files read by the parsers, relative to /proc or to the fixture's proc directory.
+ */
+enum { FILE_STAT, FILE_CPUINFO, FILE_UPTIME, FILE_MEMINFO, FILE_LOADAVG, FILE_DISKSTATS, FILE_NETDEV, FILE_PRESSURE, FILE_COUNT };
+static const char *suiteFiles[FILE_COUNT] = {
+    "stat", "cpuinfo", "uptime", "meminfo", "loadavg", "diskstats", "net/dev", "pressure/cpu"
+};
+
+typedef int (*BenchOp)(Suite *suite);
+
+/**
+ * Time after which a benchmark stops short of its operation count, so that large synthetic
+ * hosts finish in about the same time as small ones.
+ */
+#define BENCH_BUDGET 2000000000ull
+
+/**
+ * Runs one benchmark and writes its row. One warm-up call lets buffers reach their final
+ * size first, so that the allocations counted are those of the steady state.
+ */
+static void runBench(FILE *csv, Suite *suite, const char *name, const char *input, long ops, BenchOp op) {
+    int failures = op(suite) != 0;
+    long allocs = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+    uint64_t start = nowNanos(), elapsed = 0;
+    long done;
+    for (done = 0; done < ops && elapsed < BENCH_BUDGET; done++) {
+        failures += op(suite) != 0;
+        elapsed = nowNanos() - start;
+    }
+    ops = done;
+    allocs = __atomic_load_n(&allocations, __ATOMIC_RELAXED) - allocs;
+    fprintf(csv, "%s,%s,%ld,%.1f,%.2f\n", name, input, ops, (double) elapsed / ops, (double) allocs / ops);
+    if (failures) {
+        fprintf(stderr, "%s (%s): %d operations failed\n", name, input, failures);
+    }
+}
+
+/**
+ * Reads a whole fixture file into memory, NUL-terminated like a ProcFile buffer.
+ */
+static int loadFixture(const char *dir, const char *name, char **buf, size_t *len) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/proc/%s", dir, name);
+    ProcFile file;
+    if (procOpen(&file, path, 4096) == -1 || procRead(&file) == -1) {
+        procClose(&file);
+        return -1;
+    }
+    *buf = file.buf;
+    *len = file.len;
+    // The buffer now belongs to the suite
+    file.buf = NULL;
+    procClose(&file);
+    return 0;
+}
+
+static int readStat(Suite *s) { return procRead(&s->stat) || parseCpuCores(s->stat.buf, &s->cpu); }
+static int readCpuinfo(Suite *s) { return procRead(&s->cpuinfo) || parseCoreCount(s->cpuinfo.buf) <= 0; }
+static int readUptimeFile(Suite *s) { double up; return procRead(&s->uptime) || parseUptime(s->uptime.buf, &up); }
+static int readMeminfo(Suite *s) { uint64_t kb[MEMINFO_FIELDS]; return procRead(&s->meminfo) || parseMeminfo(s->meminfo.buf, s->meminfo.len, &s->index, kb); }
+static int readLoadavg(Suite *s) { LoadAvg load; return procRead(&s->loadavg) || parseLoadavg(s->loadavg.buf, &load); }
+static int readDiskstats(Suite *s) { return procRead(&s->diskstats) || parseDiskstats(s->diskstats.buf, s->devices, DISK_MAX_DEVICES) < 0; }
+static int readNetdev(Suite *s) { return procRead(&s->netdev) || parseNetdev(s->netdev.buf, s->interfaces, NET_MAX_INTERFACES) < 0; }
+static int readPressure(Suite *s) { PressureLine some, full; return procRead(&s->pressure) || parsePressure(s->pressure.buf, &some, &full) < 0; }
+
+static int parseStatFixture(Suite *s) { return parseCpuCores(s->fixture[FILE_STAT], &s->cpu); }
+static int parseCpuinfoFixture(Suite *s) { return parseCoreCount(s->fixture[FILE_CPUINFO]) <= 0; }
+static int parseUptimeFixture(Suite *s) { double up; return parseUptime(s->fixture[FILE_UPTIME], &up); }
+static int parseMeminfoFixture(Suite *s) { uint64_t kb[MEMINFO_FIELDS]; return parseMeminfo(s->fixture[FILE_MEMINFO], s->fixture_len[FILE_MEMINFO], &s->index, kb); }
+static int parseLoadavgFixture(Suite *s) { LoadAvg load; return parseLoadavg(s->fixture[FILE_LOADAVG], &load); }
+static int parseDiskstatsFixture(Suite *s) { return parseDiskstats(s->fixture[FILE_DISKSTATS], s->devices, DISK_MAX_DEVICES) < 0; }
+static int parseNetdevFixture(Suite *s) { return parseNetdev(s->fixture[FILE_NETDEV], s->interfaces, NET_MAX_INTERFACES) < 0; }
+static int parsePressureFixture(Suite *s) { PressureLine some, full; return parsePressure(s->fixture[FILE_PRESSURE], &some, &full) < 0; }
+
+static const BenchOp liveOps[FILE_COUNT] = {
+    readStat, readCpuinfo, readUptimeFile, readMeminfo, readLoadavg, readDiskstats, readNetdev, readPressure
+};
+static const BenchOp fixtureOps[FILE_COUNT] = {
+    parseStatFixture, parseCpuinfoFixture, parseUptimeFixture, parseMeminfoFixture,
+    parseLoadavgFixture, parseDiskstatsFixture, parseNetdevFixture, parsePressureFixture
+};
+
+static int collectMemory(Suite *s) { MemoryInfo memory; return readMemoryInfo(&memory); }
+static int collectCpu(Suite *s) { CpuSample cpu; return readCpuStats(&cpu); }
+static int collectCores(Suite *s) { return count_cores() <= 0; }
+static int collectUtmp(Suite *s) { return readSessions(&s->list, &s->list_len, &s->list_cap); }
+static int collectSessions(Suite *s) { return sessionsRefresh(&s->sessions) == -1; }
+static int collectTop(Suite *s) { return topScan(&s->top, nowNanos()); }
+
+static int renderMemoryRow(Suite *s) {
+    // The row the memory view formats for one sample, graph included
+    static const HistorySample sample = { .memory = { .total_memory = 16.0, .used_memory = 3.5, .total_virtual = 18.0,
+                                                      .used_virtual = 3.6 }, .memory_delta = 0.02 };
+    char row[MAX_STR_LEN];
+    formatMemoryRow(&sample, true, false, row, sizeof(row));
+    return 0;
+}
+
+static int renderMemory(Suite *s) {
+    frameBegin(&s->frame);
+    memoryUsage(&s->frame, &s->history, s->history.count, true, false, false);
+    return 0;
+}
+
+static int renderCpu(Suite *s) {
+    frameBegin(&s->frame);
+    appendAndPrintCpuGraphics(&s->frame, &s->history);
+    return 0;
+}
+
+static int renderFlush(Suite *s) {
+    frameBegin(&s->frame);
+    memoryUsage(&s->frame, &s->history, s->history.count, true, false, false);
+    appendAndPrintCpuGraphics(&s->frame, &s->history);
+    return frameFlush(&s->frame);
+}
+
+/**
+ * Fills the history with `count` samples of a slowly moving host.
+ */
+static void fillHistory(History *history, int count) {
+    HistorySample sample = {0};
+    sample.memory.total_memory = 16.0;
+    sample.memory.total_virtual = 20.0;
+    for (int i = 0; i < count; i++) {
+        sample.timestamp = (uint64_t) i * 1000000000ull;
+        sample.memory.used_memory = 4.0 + (i % 97) / 50.0;
+        sample.memory.used_virtual = sample.memory.used_memory + 0.5;
+        sample.memory_delta = (i % 7 - 3) / 100.0;
+        sample.cpu_usage = (i * 37) % 100;
+        historyPush(history, &sample);
+    }
+}
+
+/**
+ * Runs the sampling loop of the live display at a fixed interval: inline engine, history,
+ * frame render and flush. The row reports CPU time, not wall time, per sample.
+ */
+static void benchLoop(FILE *csv, const char *name, const char *host, uint64_t interval, int samples) {
+    Options opts = { .samples = samples, .interval = interval, .sys = true, .user = true, .graph = true,
+                     .engine = ENGINE_INLINE, .format = FORMAT_TEXT, .resolution = -1 };
+    SampleEngine engine;
+    SampleSet set = {0};
+    Display display;
+    CollectorSet collectors;
+    if (startEngine(&engine, ENGINE_INLINE, true, true) == -1 || displayInit(&display, &opts, samples) == -1 ||
+        collectorsOpen(&collectors, &opts, false) == -1) {
+        perror("Error starting the sampling loop");
+        exit(EXIT_FAILURE);
+    }
+    display.collectors = &collectors;
+    Scheduler sched;
+    schedStart(&sched, interval);
+    long allocs = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+    uint64_t cpu = selfCpuTime();
+    int failures = 0;
+    for (int i = 0; i < samples; i++) {
+        set.timestamp = schedNext(&sched);
+        failures += engineSample(&engine, &set) == -1;
+        displayUpdate(&display, &set, 1, countSessions(&set));
+        displayRender(&display, &set, "Benchmark");
+    }
+    cpu = selfCpuTime() - cpu;
+    allocs = __atomic_load_n(&allocations, __ATOMIC_RELAXED) - allocs;
+    fprintf(csv, "%s,%s,%d,%.1f,%.2f\n", name, host, samples, (double) cpu / samples, (double) allocs / samples);
+    if (failures) {
+        fprintf(stderr, "%s: %d samples failed\n", name, failures);
+    }
+    displayFree(&display);
+    collectorsClose(&collectors);
+    stopEngine(&engine);
+    freeSampleSet(&set);
+}
+
+int main(int argc, char **argv) {
+    const char *fixtures = "fixtures/vm";
+    const char *root = NULL;
+    const char *output = NULL;
+    long ops = 20000;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--fixtures=", 11) == 0) fixtures = argv[i] + 11;
+        else if (strncmp(argv[i], "--proc-root=", 12) == 0) root = argv[i] + 12;
+        else if (strncmp(argv[i], "--csv=", 6) == 0) output = argv[i] + 6;
+        else if (strncmp(argv[i], "--ops=", 6) == 0 && isInteger(argv[i] + 6) && atol(argv[i] + 6) > 0) ops = atol(argv[i] + 6);
+        else {
+            fprintf(stderr, "Usage: %s [--fixtures=DIR] [--proc-root=DIR] [--csv=FILE] [--ops=N]\n", argv[0]);
+            return 1;
+        }
+    }
+    FILE *csv = output ? fopen(output, "w") : stdout;
+    if (!csv) {
+        perror("Error opening the CSV file");
+        return 1;
+    }
+    // Frames go to standard output, which must not mix with the rows
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    int rows_fd = output ? -1 : dup(STDOUT_FILENO);
+    if (null_fd == -1 || (!output && (rows_fd == -1 || !(csv = fdopen(rows_fd, "w"))))) {
+        perror("Error redirecting the frames");
+        return 1;
+    }
+    dup2(null_fd, STDOUT_FILENO);
+
+    Suite suite;
+    memset(&suite, 0, sizeof(suite));
+    ProcFile *live[FILE_COUNT] = {
+        &suite.stat, &suite.cpuinfo, &suite.uptime, &suite.meminfo, &suite.loadavg, &suite.diskstats, &suite.netdev, &suite.pressure
+    };
+    fprintf(csv, "benchmark,input,ops,ns_per_op,allocs_per_op\n");
+
+    // The fixtures are loaded before the root is set, so that their paths are not placed below it
+    bool loaded[FILE_COUNT];
+    for (int f = 0; f < FILE_COUNT; f++) {
+        loaded[f] = loadFixture(fixtures, suiteFiles[f], &suite.fixture[f], &suite.fixture_len[f]) == 0;
+    }
+    // With a root, every "live" benchmark reads that tree instead, e.g. a host made by --synthesize
+    if (procSetRoot(root) == -1) {
+        perror("Error setting the proc root");
+        return 1;
+    }
+    const char *host = procRooted() ? root : "live";
+
+    for (int f = 0; f < FILE_COUNT; f++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%s", suiteFiles[f]);
+        if (procOpen(live[f], path, 4096) == 0) {
+            runBench(csv, &suite, suiteFiles[f], host, ops, liveOps[f]);
+        }
+        if (loaded[f]) {
+            suite.index.built = false;
+            runBench(csv, &suite, suiteFiles[f], fixtures, ops, fixtureOps[f]);
+        }
+    }
+
+    runBench(csv, &suite, "memoryStats", host, ops, collectMemory);
+    runBench(csv, &suite, "cpuStats", host, ops, collectCpu);
+    runBench(csv, &suite, "count_cores", host, ops, collectCores);
+    runBench(csv, &suite, "userOutput", host, ops, collectUtmp);
+    sessionsOpen(&suite.sessions);
+    runBench(csv, &suite, "sessionsRefresh", host, ops, collectSessions);
+    if (topOpen(&suite.top, DEFAULT_TOP) == 0) {
+        runBench(csv, &suite, "topScan", host, ops / 100 > 0 ? ops / 100 : 1, collectTop);
+        topClose(&suite.top);
+    }
+
+    runBench(csv, &suite, "formatMemoryRow", "row", ops, renderMemoryRow);
+    static const int sizes[] = { 128, 1024, 16384 };
+    frameInit(&suite.frame, FRAME_SIZE, false);
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        char input[32];
+        snprintf(input, sizeof(input), "history=%d", sizes[k]);
+        if (historyInit(&suite.history, sizes[k]) == -1) {
+            perror("History allocation failed");
+            return 1;
+        }
+        fillHistory(&suite.history, sizes[k]);
+        // Larger histories take proportionally longer, so they get fewer operations
+        long render_ops = ops * 128 / sizes[k] / 10 > 0 ? ops * 128 / sizes[k] / 10 : 1;
+        runBench(csv, &suite, "memoryUsage", input, render_ops, renderMemory);
+        runBench(csv, &suite, "appendAndPrintCpuGraphics", input, render_ops, renderCpu);
+        runBench(csv, &suite, "frameFlush", input, render_ops, renderFlush);
+        historyFree(&suite.history);
+    }
+    frameFree(&suite.frame);
+
+    benchLoop(csv, "loop_100hz", host, 10000000ull, 100);
+    benchLoop(csv, "loop_1khz", host, 1000000ull, 500);
+
+    for (int f = 0; f < FILE_COUNT; f++) {
+        procClose(live[f]);
+        free(suite.fixture[f]);
+    }
+    sessionsClose(&suite.sessions);
+    free(suite.list);
+    fclose(csv);
+    return 0;
+}
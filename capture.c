@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+#include "header.h"
+#include <sys/stat.h>
+
+// Every file a collector reads, as on the live system; files a host may not have are optional
+static const struct {
+    const char *path;
+    bool optional;
+} captureFiles[] = {
+    { "/proc/stat", false },
+    { "/proc/cpuinfo", false },
+    { "/proc/uptime", false },
+    { "/proc/meminfo", false },
+    { "/proc/loadavg", false },
+    { "/proc/diskstats", true },
+    { "/proc/net/dev", true },
+    { "/proc/pressure/cpu", true },
+    { "/proc/pressure/memory", true },
+    { "/proc/pressure/io", true },
+    { "/proc/self/cgroup", true },
+    { "/proc/self/mountinfo", true },
+    { "/proc/sys/kernel/ostype", true },
+    { "/proc/sys/kernel/hostname", true },
+    { "/proc/sys/kernel/version", true },
+    { "/proc/sys/kernel/osrelease", true },
+    { _PATH_UTMP, true },
+};
+
+/**
+ * Creates the directory of `path` and every missing parent below `dir`.
+ */
+static int makeParents(const char *dir, const char *path) {
+    char parent[PROC_PATH_LEN];
+    if ((size_t) snprintf(parent, sizeof(parent), "%s%s", dir, path) >= sizeof(parent)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    for (char *c = parent + strlen(dir) + 1; (c = strchr(c, '/')); c++) {
+        *c = '\0';
+        if (mkdir(parent, 0755) == -1 && errno != EEXIST) {
+            return -1;
+        }
+        *c = '/';
+    }
+    return 0;
+}
+
+/**
+ * Writes `len` bytes as the file `path` below `dir`.
+ */
+static int writeCaptured(const char *dir, const char *path, const char *buf, size_t len) {
+    char file[PROC_PATH_LEN];
+    if (makeParents(dir, path) == -1) {
+        return -1;
+    }
+    snprintf(file, sizeof(file), "%s%s", dir, path);
+    FILE *fp = fopen(file, "w");
+    if (!fp) {
+        return -1;
+    }
+    size_t written = fwrite(buf, 1, len, fp);
+    if (fclose(fp) != 0 || written != len) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Rewrites /proc/stat for `cores` cores: core N takes the counters of source core N modulo
+ * the source count, the aggregate line is their sum, and the other lines are kept.
+ */
+static int scaleStat(const char *buf, int cores, char **out, size_t *len) {
+    uint64_t source[MAX_CORES][10];
+    int sources = 0;
+    const char *rest = buf;
+    for (const char *p = scanNextLine(buf); strncmp(p, "cpu", 3) == 0; p = scanNextLine(p)) {
+        uint64_t core;
+        const char *q = scanU64(p + 3, &core);
+        rest = scanNextLine(p);
+        if (!q || sources == MAX_CORES) {
+            continue;
+        }
+        memset(source[sources], 0, sizeof(source[sources]));
+        for (int k = 0; k < 10 && (q = scanU64(q, &source[sources][k])); k++);
+        sources++;
+    }
+    if (sources == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    FILE *fp = open_memstream(out, len);
+    if (!fp) {
+        return -1;
+    }
+    uint64_t total[10] = {0};
+    for (int c = 0; c < cores; c++) {
+        for (int k = 0; k < 10; k++) total[k] += source[c % sources][k];
+    }
+    fprintf(fp, "cpu ");
+    for (int k = 0; k < 10; k++) fprintf(fp, " %" PRIu64, total[k]);
+    fprintf(fp, "\n");
+    for (int c = 0; c < cores; c++) {
+        fprintf(fp, "cpu%d", c);
+        for (int k = 0; k < 10; k++) fprintf(fp, " %" PRIu64, source[c % sources][k]);
+        fprintf(fp, "\n");
+    }
+    fputs(rest, fp);
+    return fclose(fp);
+}
+
+/**
+ * Rewrites /proc/cpuinfo for `cores` cores by repeating the block of the first processor.
+ */
+static int scaleCpuinfo(const char *buf, int cores, char **out, size_t *len) {
+    if (strncmp(buf, "processor", 9) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    // The block is everything after the "processor" line up to the blank line that ends it
+    const char *body = scanNextLine(buf);
+    const char *end = strstr(body, "\n\n");
+    int body_len = end ? (int) (end - body) + 1 : (int) strlen(body);
+    FILE *fp = open_memstream(out, len);
+    if (!fp) {
+        return -1;
+    }
+    for (int c = 0; c < cores; c++) {
+        fprintf(fp, "processor\t: %d\n%.*s\n", c, body_len, body);
+    }
+    return fclose(fp);
+}
+
+/**
+ * Rewrites utmp with `sessions` user sessions. Records other than sessions, like the boot
+ * time, are kept; the sessions copy the first one found, or a blank record on pts/N.
+ */
+static int scaleUtmp(const char *buf, size_t buf_len, int sessions, char **out, size_t *len) {
+    const struct utmp *entry = (const struct utmp *) buf;
+    size_t count = buf_len / sizeof(struct utmp), kept = 0;
+    struct utmp session;
+    memset(&session, 0, sizeof(session));
+    session.ut_type = USER_PROCESS;
+    snprintf(session.ut_host, sizeof(session.ut_host), "synthetic");
+    for (size_t k = 0; k < count; k++) {
+        if (entry[k].ut_type == USER_PROCESS) {
+            session = entry[k];
+            break;
+        }
+    }
+    *len = 0;
+    if (!(*out = malloc((count + (size_t) sessions) * sizeof(struct utmp) + 1))) {
+        return -1;
+    }
+    struct utmp *records = (struct utmp *) *out;
+    for (size_t k = 0; k < count; k++) {
+        if (entry[k].ut_type != USER_PROCESS) records[kept++] = entry[k];
+    }
+    for (int s = 0; s < sessions; s++) {
+        struct utmp *record = &records[kept++];
+        *record = session;
+        // Sessions are told apart by process and terminal
+        record->ut_pid = 100000 + s;
+        snprintf(record->ut_line, sizeof(record->ut_line), "pts/%d", s);
+        // ut_id holds 4 bytes and needs no terminator
+        char id[16];
+        snprintf(id, sizeof(id), "%d", s % 10000);
+        memcpy(record->ut_id, id, sizeof(record->ut_id));
+        snprintf(record->ut_user, sizeof(record->ut_user), "user%d", s);
+    }
+    *len = kept * sizeof(struct utmp);
+    return 0;
+}
+
+/**
+ * Recreates the /sys/block entries that tell whole disks from partitions.
+ */
+static int captureBlockDevices(const char *dir) {
+    char path[PROC_PATH_LEN], target[PROC_PATH_LEN];
+    const char *block = procPath("/sys/block", path, sizeof(path));
+    DIR *devices = block ? opendir(block) : NULL;
+    if (!devices) {
+        return 0;
+    }
+    int count = 0;
+    struct dirent *device;
+    while ((device = readdir(devices))) {
+        if (device->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(target, sizeof(target), "%s/sys/block/%s", dir, device->d_name);
+        if (makeParents(dir, "/sys/block/") == -1 || (mkdir(target, 0755) == -1 && errno != EEXIST)) {
+            closedir(devices);
+            return -1;
+        }
+        count++;
+    }
+    closedir(devices);
+    return count;
+}
+
+int captureHost(const char *dir, int cores, int sessions) {
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+        return -1;
+    }
+    int files = 0;
+    for (size_t f = 0; f < sizeof(captureFiles) / sizeof(captureFiles[0]); f++) {
+        const char *path = captureFiles[f].path;
+        ProcFile file;
+        bool scale_utmp = sessions > 0 && strcmp(path, _PATH_UTMP) == 0;
+        if (procOpen(&file, path, PROC_STAT_SIZE) == -1 || procRead(&file) == -1) {
+            int saved = errno;
+            procClose(&file);
+            if (saved == ENOENT && scale_utmp) {
+                // Nobody is logged in: the sessions are made up from a blank record
+                char *records = NULL;
+                size_t len = 0;
+                if (scaleUtmp("", 0, sessions, &records, &len) == -1 || writeCaptured(dir, path, records, len) == -1) {
+                    free(records);
+                    return -1;
+                }
+                free(records);
+                files++;
+                continue;
+            }
+            if (captureFiles[f].optional && saved == ENOENT) {
+                continue;
+            }
+            fprintf(stderr, "%s: %s\n", path, strerror(saved));
+            errno = saved;
+            return -1;
+        }
+        char *scaled = NULL;
+        size_t len = 0;
+        int status = 0;
+        if (cores > 0 && strcmp(path, "/proc/stat") == 0) status = scaleStat(file.buf, cores, &scaled, &len);
+        else if (cores > 0 && strcmp(path, "/proc/cpuinfo") == 0) status = scaleCpuinfo(file.buf, cores, &scaled, &len);
+        else if (scale_utmp) status = scaleUtmp(file.buf, file.len, sessions, &scaled, &len);
+        if (status == 0) {
+            status = writeCaptured(dir, path, scaled ? scaled : file.buf, scaled ? len : file.len);
+        }
+        int saved = errno;
+        free(scaled);
+        procClose(&file);
+        if (status == -1) {
+            fprintf(stderr, "%s: %s\n", path, strerror(saved));
+            errno = saved;
+            return -1;
+        }
+        files++;
+    }
+    int devices = captureBlockDevices(dir);
+    if (devices == -1) {
+        return -1;
+    }
+    printf("Captured %d files and %d block devices into %s\n", files, devices, dir);
+    if (cores > 0) printf("Scaled to %d cores\n", cores);
+    if (sessions > 0) printf("Scaled to %d sessions\n", sessions);
+    return 0;
+}
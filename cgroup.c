@@ -0,0 +1,245 @@
+#include "header.h"
+
+static const char *cgroupFiles[CGROUP_FILES] = {
+    "memory.current", "memory.max", "memory.stat", "cpu.stat", "cpu.max"
+};
+static const char *const memoryKeys[] = { "anon", "file", "inactive_file" };
+static const char *const cpuKeys[] = { "usage_usec", "nr_periods", "nr_throttled", "throttled_usec" };
+
+/**
+ * Finds where the cgroup2 hierarchy is mounted; this runs once, so stdio is fine.
+ */
+static int findMount(char *mount, size_t len) {
+    char path[PROC_PATH_LEN];
+    const char *mountinfo = procPath("/proc/self/mountinfo", path, sizeof(path));
+    FILE *fp = mountinfo ? fopen(mountinfo, "r") : NULL;
+    if (!fp) {
+        return -1;
+    }
+    char line[1024], point[CGROUP_PATH_LEN];
+    while (fgets(line, sizeof(line), fp)) {
+        // The filesystem type follows the " - " separator
+        const char *type = strstr(line, " - ");
+        if (type && strncmp(type + 3, "cgroup2 ", 8) == 0 && sscanf(line, "%*s %*s %*s %*s %255s", point) == 1) {
+            snprintf(mount, len, "%s", point);
+            fclose(fp);
+            return 0;
+        }
+    }
+    fclose(fp);
+    errno = ENOENT;
+    return -1;
+}
+
+/**
+ * Turns a cgroup path into its directory: a directory that is already a cgroup is taken as
+ * it is, anything else is looked up below the cgroup2 mount.
+ */
+static int findDirectory(const char *path, const char *mount, char *dir, size_t len) {
+    char probe[2 * CGROUP_PATH_LEN], rooted[PROC_PATH_LEN];
+    snprintf(probe, sizeof(probe), "%s/cgroup.controllers", path);
+    // Directories keep their live names, which procOpen places below --proc-root; only the checks map them here
+    const char *controllers = procPath(probe, rooted, sizeof(rooted));
+    if (path[0] == '/' && controllers && access(controllers, F_OK) == 0) {
+        snprintf(dir, len, "%s", path);
+        return 0;
+    }
+    if (!mount[0]) {
+        errno = ENOENT;
+        return -1;
+    }
+    snprintf(dir, len, "%s/%s", mount, path[0] == '/' ? path + 1 : path);
+    const char *found = procPath(dir, rooted, sizeof(rooted));
+    return found ? access(found, F_OK) : -1;
+}
+
+/**
+ * Opens the files of one cgroup; the files of controllers that are not enabled stay closed.
+ */
+static int openGroup(Cgroup *group, const char *path, const char *mount) {
+    char dir[CGROUP_PATH_LEN + 64], file[2 * CGROUP_PATH_LEN];
+    memset(group, 0, sizeof(*group));
+    for (int f = 0; f < CGROUP_FILES; f++) {
+        group->files[f].fd = -1;
+    }
+    snprintf(group->path, sizeof(group->path), "%s", path[0] ? path : "/");
+    if (findDirectory(group->path, mount, dir, sizeof(dir)) == -1) {
+        return -1;
+    }
+    for (int f = 0; f < CGROUP_FILES; f++) {
+        snprintf(file, sizeof(file), "%s/%s", dir, cgroupFiles[f]);
+        size_t cap = f == CGROUP_MEMORY_STAT || f == CGROUP_CPU_STAT ? CGROUP_STAT_SIZE : CGROUP_FILE_SIZE;
+        // A missing file is a controller that is not enabled; running out of descriptors is an error
+        if (procOpen(&group->files[f], file, cap) == -1 && errno != ENOENT) {
+            return -1;
+        }
+    }
+    group->current.memory_max = CGROUP_UNLIMITED;
+    group->current.quota = CGROUP_UNLIMITED;
+    return 0;
+}
+
+int cgroupOpen(CgroupStats *cgroups, const char *paths) {
+    memset(cgroups, 0, sizeof(*cgroups));
+    char mount[CGROUP_PATH_LEN] = "";
+    findMount(mount, sizeof(mount));
+    char self[CGROUP_PATH_LEN];
+    if (!paths[0]) {
+        // Without a path, watch the cgroup the process runs in
+        ProcFile file;
+        if (procOpen(&file, "/proc/self/cgroup", PROC_UPTIME_SIZE) == -1) {
+            return -1;
+        }
+        int status = procRead(&file) == -1 ? -1 : parseSelfCgroup(file.buf, self, sizeof(self));
+        procClose(&file);
+        if (status == -1) {
+            return -1;
+        }
+        paths = self;
+    }
+    int count = 1;
+    for (const char *c = paths; *c; c++) {
+        if (*c == ',') count++;
+    }
+    // Every cgroup holds its files open, which can take more descriptors than the default soft limit
+    struct rlimit files;
+    rlim_t needed = (rlim_t) count * CGROUP_FILES + 64;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < needed) {
+        files.rlim_cur = files.rlim_max < needed ? files.rlim_max : needed;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+    if (!(cgroups->groups = calloc((size_t) count, sizeof(Cgroup)))) {
+        return -1;
+    }
+    for (const char *p = paths; cgroups->count < count; p += strcspn(p, ",") + 1) {
+        char path[CGROUP_PATH_LEN];
+        snprintf(path, sizeof(path), "%.*s", (int) strcspn(p, ","), p);
+        if (openGroup(&cgroups->groups[cgroups->count], path, mount) == -1) {
+            int saved = errno;
+            cgroups->count++;
+            cgroupClose(cgroups);
+            errno = saved;
+            return -1;
+        }
+        cgroups->count++;
+    }
+    return 0;
+}
+
+/**
+ * Reads one file of a cgroup. A cgroup that was removed fails its reads; its files are
+ * closed and its last counters stay on screen, so the other cgroups keep being sampled.
+ */
+static const char *readFile(Cgroup *group, CgroupFile f) {
+    ProcFile *file = &group->files[f];
+    if (file->fd == -1) {
+        return NULL;
+    }
+    if (procRead(file) == -1) {
+        procClose(file);
+        return NULL;
+    }
+    return file->buf;
+}
+
+int cgroupSample(CgroupStats *cgroups) {
+    for (int g = 0; g < cgroups->count; g++) {
+        Cgroup *group = &cgroups->groups[g];
+        CgroupCounters *counters = &group->current;
+        group->previous = *counters;
+        const char *buf;
+        uint64_t memory[3] = {0}, cpu[4] = {0};
+        if ((buf = readFile(group, CGROUP_MEMORY_CURRENT)) && parseCgroupLimit(buf, &counters->memory, NULL) == -1) {
+            return -1;
+        }
+        if ((buf = readFile(group, CGROUP_MEMORY_MAX)) && parseCgroupLimit(buf, &counters->memory_max, NULL) == -1) {
+            return -1;
+        }
+        if ((buf = readFile(group, CGROUP_CPU_MAX)) && parseCgroupLimit(buf, &counters->quota, &counters->period) == -1) {
+            return -1;
+        }
+        if ((buf = readFile(group, CGROUP_MEMORY_STAT))) {
+            if (parseFlatKeyed(buf, memoryKeys, 3, memory) == -1) {
+                return -1;
+            }
+            counters->anon = memory[0];
+            counters->file = memory[1];
+            counters->inactive_file = memory[2];
+        }
+        if ((buf = readFile(group, CGROUP_CPU_STAT))) {
+            if (parseFlatKeyed(buf, cpuKeys, 4, cpu) == -1) {
+                return -1;
+            }
+            counters->usage = cpu[0];
+            counters->periods = cpu[1];
+            counters->throttled_periods = cpu[2];
+            counters->throttled = cpu[3];
+        }
+    }
+    cgroups->samples++;
+    return 0;
+}
+
+/**
+ * Returns the growth of a counter, or 0 if it went back.
+ */
+static uint64_t counterDelta(uint64_t now, uint64_t before) {
+    return now >= before ? now - before : 0;
+}
+
+void cgroupDelta(CgroupStats *cgroups, uint64_t elapsed) {
+    double elapsed_us = elapsed / 1e3;
+    for (int g = 0; g < cgroups->count; g++) {
+        Cgroup *group = &cgroups->groups[g];
+        const CgroupCounters *now = &group->current, *before = &group->previous;
+        group->cpu_usage = elapsed_us > 0 ? 100.0 * counterDelta(now->usage, before->usage) / elapsed_us : 0.0;
+        group->throttled_ms = counterDelta(now->throttled, before->throttled) / 1e3;
+        uint64_t periods = counterDelta(now->periods, before->periods);
+        group->throttled_share = periods > 0 ? 100.0 * counterDelta(now->throttled_periods, before->throttled_periods) / periods : 0.0;
+    }
+}
+
+void cgroupClose(CgroupStats *cgroups) {
+    for (int g = 0; g < cgroups->count; g++) {
+        for (int f = 0; f < CGROUP_FILES; f++) {
+            procClose(&cgroups->groups[g].files[f]);
+        }
+    }
+    free(cgroups->groups);
+    cgroups->groups = NULL;
+    cgroups->count = 0;
+}
+
+void cgroupOutput(Frame *frame, const CgroupStats *cgroups) {
+    framePrintf(frame, "--------------------------------------------\n");
+    framePrintf(frame, "### Cgroups ### (CPU and throttling since the last sample)\n");
+    for (int g = 0; g < cgroups->count; g++) {
+        const Cgroup *group = &cgroups->groups[g];
+        const CgroupCounters *counters = &group->current;
+        framePrintf(frame, "%s\n", group->path);
+        if (group->files[CGROUP_MEMORY_CURRENT].fd == -1) {
+            framePrintf(frame, "  Memory: controller not enabled\n");
+        }
+        else {
+            double used = counters->memory / 1e9;
+            // The working set leaves out the page cache that would be reclaimed first
+            double working = counterDelta(counters->memory, counters->inactive_file) / 1e9;
+            if (counters->memory_max == CGROUP_UNLIMITED) framePrintf(frame, "  Memory: %.2f GB, no limit", used);
+            else framePrintf(frame, "  Memory: %.2f GB of %.2f GB (%.1f%%)", used, counters->memory_max / 1e9, 100.0 * counters->memory / counters->memory_max);
+            framePrintf(frame, " -- working set %.2f GB, anon %.2f GB, file %.2f GB\n", working, counters->anon / 1e9, counters->file / 1e9);
+        }
+        if (group->files[CGROUP_CPU_STAT].fd == -1) {
+            framePrintf(frame, "  CPU: not available\n");
+            continue;
+        }
+        framePrintf(frame, "  CPU: %.1f%%", group->cpu_usage);
+        if (counters->quota != CGROUP_UNLIMITED && counters->period > 0) {
+            double quota = 100.0 * counters->quota / counters->period;
+            framePrintf(frame, " of a %.0f%% quota (%.1f%% used) -- throttled %.1f ms, in %.1f%% of periods\n", quota,
+                        100.0 * group->cpu_usage / quota, group->throttled_ms, group->throttled_share);
+        }
+        else {
+            framePrintf(frame, ", no quota\n");
+        }
+    }
+}
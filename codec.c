@@ -0,0 +1,182 @@
+#include "header.h"
+
+/**
+ * Field bits of a packed record; the fields that change on almost every sample come first so
+ * that their tag fits in one byte.
+ */
+enum {
+    FIELD_TIMESTAMP = 1 << 1,
+    FIELD_USED_MEMORY = 1 << 2,
+    FIELD_CPU_TOT = 1 << 3,
+    FIELD_CPU_IDLE = 1 << 4,
+    FIELD_USED_SWAP = 1 << 5,
+    FIELD_SESSIONS = 1 << 6,
+    FIELD_WALL_OFFSET = 1 << 7,
+    FIELD_TOTAL_MEMORY = 1 << 8,
+    FIELD_TOTAL_SWAP = 1 << 9,
+    FIELD_CORES = 1 << 10,
+    FIELD_AVAILABLE = 1 << 11,
+    FIELD_CACHED = 1 << 12,
+    FIELD_DIRTY = 1 << 13,
+    FIELD_ANON_PAGES = 1 << 14,
+    FIELD_SLAB = 1 << 15,
+    FIELD_BUFFERS = 1 << 16,
+    FIELD_WRITEBACK = 1 << 17,
+    FIELD_HUGE_TOTAL = 1 << 18,
+    FIELD_HUGE_FREE = 1 << 19,
+};
+
+// The memory breakdown comes after the fields of RECORD_VERSION_BASIC, so those decode unchanged
+#define CODEC_FIELDS 19
+
+#define TAG_KEYFRAME 1
+// Marks the first record written by a run, after the bits of the fields
+#define TAG_RUN ((uint64_t) 2 << CODEC_FIELDS)
+
+size_t putVarint(uint8_t *out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t) value;
+    return n;
+}
+
+const uint8_t *getVarint(const uint8_t *p, const uint8_t *end, uint64_t *value) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        v |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = v;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+uint64_t zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+void codecInit(Codec *codec, uint64_t interval) {
+    memset(codec, 0, sizeof(*codec));
+    codec->interval = interval;
+}
+
+/**
+ * The fields of a record as the codec sees them: swap instead of virtual memory, and the
+ * wall-clock time as an offset from the monotonic time, since both hardly ever change.
+ */
+static void unpackFields(const SampleRecord *record, int64_t field[CODEC_FIELDS]) {
+    field[0] = (int64_t) record->timestamp;
+    field[1] = (int64_t) record->used_memory_kb;
+    field[2] = record->cpu_tot;
+    field[3] = record->cpu_idle;
+    field[4] = (int64_t) (record->used_virtual_kb - record->used_memory_kb);
+    field[5] = record->sessions;
+    field[6] = record->wall_time - (int64_t) record->timestamp;
+    field[7] = (int64_t) record->total_memory_kb;
+    field[8] = (int64_t) (record->total_virtual_kb - record->total_memory_kb);
+    field[9] = record->cores;
+    field[10] = (int64_t) record->available_kb;
+    field[11] = (int64_t) record->cached_kb;
+    field[12] = (int64_t) record->dirty_kb;
+    field[13] = (int64_t) record->anon_pages_kb;
+    field[14] = (int64_t) record->slab_kb;
+    field[15] = (int64_t) record->buffers_kb;
+    field[16] = (int64_t) record->writeback_kb;
+    field[17] = (int64_t) record->huge_total_kb;
+    field[18] = (int64_t) record->huge_free_kb;
+}
+
+static void packFields(const int64_t field[CODEC_FIELDS], SampleRecord *record) {
+    record->timestamp = (uint64_t) field[0];
+    record->used_memory_kb = (uint64_t) field[1];
+    record->cpu_tot = field[2];
+    record->cpu_idle = field[3];
+    record->used_virtual_kb = (uint64_t) (field[1] + field[4]);
+    record->sessions = (uint32_t) field[5];
+    record->wall_time = field[6] + field[0];
+    record->total_memory_kb = (uint64_t) field[7];
+    record->total_virtual_kb = (uint64_t) (field[7] + field[8]);
+    record->cores = (uint32_t) field[9];
+    record->available_kb = (uint64_t) field[10];
+    record->cached_kb = (uint64_t) field[11];
+    record->dirty_kb = (uint64_t) field[12];
+    record->anon_pages_kb = (uint64_t) field[13];
+    record->slab_kb = (uint64_t) field[14];
+    record->buffers_kb = (uint64_t) field[15];
+    record->writeback_kb = (uint64_t) field[16];
+    record->huge_total_kb = (uint64_t) field[17];
+    record->huge_free_kb = (uint64_t) field[18];
+}
+
+size_t codecEncode(Codec *codec, const SampleRecord *record, uint8_t *out) {
+    int64_t field[CODEC_FIELDS], prev[CODEC_FIELDS];
+    unpackFields(record, field);
+    bool keyframe = codec->records == 0 || codec->since_keyframe >= RECORD_KEYFRAME_INTERVAL;
+    if (keyframe) {
+        // A keyframe holds every field in full, so decoding can start there
+        memset(prev, 0, sizeof(prev));
+        codec->since_keyframe = 0;
+    }
+    else {
+        unpackFields(&codec->prev, prev);
+        // Timestamps are stored as their deviation from the sampling grid
+        prev[0] += (int64_t) codec->interval;
+    }
+    uint64_t tag = keyframe ? TAG_KEYFRAME : 0;
+    if (codec->records == 0) tag |= TAG_RUN;
+    int64_t delta[CODEC_FIELDS];
+    for (int k = 0; k < CODEC_FIELDS; k++) {
+        delta[k] = field[k] - prev[k];
+        if (delta[k] != 0) tag |= (uint64_t) 2 << k;
+    }
+    size_t n = putVarint(out, tag);
+    for (int k = 0; k < CODEC_FIELDS; k++) {
+        if (delta[k] != 0) n += putVarint(out + n, zigzag(delta[k]));
+    }
+    codec->prev = *record;
+    codec->records++;
+    codec->since_keyframe++;
+    return n;
+}
+
+const uint8_t *codecDecode(Codec *codec, const uint8_t *p, const uint8_t *end, SampleRecord *record) {
+    uint64_t tag;
+    if (!(p = getVarint(p, end, &tag))) {
+        return NULL;
+    }
+    int64_t field[CODEC_FIELDS];
+    if (tag & TAG_KEYFRAME) {
+        memset(field, 0, sizeof(field));
+    }
+    else if (codec->records == 0) {
+        // A delta with nothing to apply it to
+        errno = EINVAL;
+        return NULL;
+    }
+    else {
+        unpackFields(&codec->prev, field);
+        field[0] += (int64_t) codec->interval;
+    }
+    for (int k = 0; k < CODEC_FIELDS; k++) {
+        if (!(tag & ((uint64_t) 2 << k))) continue;
+        uint64_t value;
+        if (!(p = getVarint(p, end, &value))) {
+            return NULL;
+        }
+        field[k] += unzigzag(value);
+    }
+    packFields(field, record);
+    codec->run = (tag & TAG_RUN) != 0;
+    codec->prev = *record;
+    codec->records++;
+    return p;
+}
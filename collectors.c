@@ -0,0 +1,305 @@
+#include "header.h"
+
+/**
+ * Returns the history a frame is drawn from: the samples, or the rollup tier of --resolution.
+ */
+static const History *shownHistory(const Display *display) {
+    const Options *opts = display->opts;
+    return opts->resolution >= 0 ? &display->rollups.tiers[opts->resolution].history : &display->history;
+}
+
+static bool systemEnabled(const Options *opts) {
+    return opts->sys;
+}
+
+static void memoryRender(Frame *frame, const void *state, const Display *display) {
+    const Options *opts = display->opts;
+    memoryUsage(frame, shownHistory(display), display->window, opts->graph, opts->seq, opts->available);
+}
+
+static bool usersEnabled(const Options *opts) {
+    return opts->user;
+}
+
+static void usersRender(Frame *frame, const void *state, const Display *display) {
+    const SampleSet *set = display->set;
+    framePrintf(frame, "--------------------------------------------\n");
+    framePrintf(frame, "### Sessions/users ###\n");
+    // Recorded and published samples only carry the number of sessions
+    if (set->sessions) framePrintf(frame, "%.*s", (int) set->sessions_len, set->sessions);
+    else framePrintf(frame, "%d sessions\n", display->sessions);
+    // Only the session watch knows who came and went
+    if (set->sessions_version > 0) framePrintf(frame, "Logins: %d, logouts: %d since the last sample\n", set->logins, set->logouts);
+}
+
+static void cpuRender(Frame *frame, const void *state, const Display *display) {
+    const Options *opts = display->opts;
+    cpu_output(frame, opts->graph, shownHistory(display), display->cores);
+    if (opts->resolution >= 0) {
+        rollupOutput(frame, &display->rollups, opts->resolution);
+    }
+    if (opts->per_core > 0 && display->ncores > 0) {
+        perCoreOutput(frame, display->cores_usage, display->ncores, opts->per_core);
+    }
+}
+
+static bool topEnabled(const Options *opts) {
+    return opts->top > 0;
+}
+
+static int topInit(void *state, const Options *opts) {
+    return topOpen(state, opts->top);
+}
+
+static int topSample(void *state, uint64_t timestamp) {
+    return topScan(state, timestamp);
+}
+
+static void topRender(Frame *frame, const void *state, const Display *display) {
+    topOutput(frame, state);
+}
+
+static void topFree(void *state) {
+    topClose(state);
+}
+
+static bool pressureEnabled(const Options *opts) {
+    return opts->pressure;
+}
+
+static int pressureInit(void *state, const Options *opts) {
+    if (pressureOpen(state) == -1) {
+        return -1;
+    }
+    if (opts->psi_trigger > 0 && pressureTrigger(state, opts->psi_trigger, opts->psi_window) == -1) {
+        // Some kernels and sandboxes refuse triggers; the timer still drives every sample
+        char window[32];
+        formatDuration(opts->psi_window, window, sizeof(window));
+        if (errno == EINVAL) {
+            fprintf(stderr, "Pressure trigger refused with a window of %s: without CAP_SYS_RESOURCE the window must be a multiple of 2 s; sampling on the timer only\n", window);
+        }
+        else if (errno == EPERM || errno == EACCES) {
+            fprintf(stderr, "Pressure trigger not permitted: before Linux 6.5 it needs CAP_SYS_RESOURCE; sampling on the timer only\n");
+        }
+        else {
+            perror("Pressure trigger unavailable, sampling on the timer only");
+        }
+    }
+    return 0;
+}
+
+static int pressureRead(void *state, uint64_t timestamp) {
+    return pressureSample(state, timestamp);
+}
+
+static void pressureRender(Frame *frame, const void *state, const Display *display) {
+    pressureOutput(frame, state);
+}
+
+static void pressureFree(void *state) {
+    pressureClose(state);
+}
+
+static int pressureWatch(const void *state, int *fds, int cap) {
+    const Pressure *pressure = state;
+    int n = 0;
+    for (int r = 0; r < PRESSURE_RESOURCES && n < cap; r++) {
+        if (pressure->triggers[r] != -1) fds[n++] = pressure->triggers[r];
+    }
+    return n;
+}
+
+static bool pressureWake(void *state, int fd) {
+    Pressure *pressure = state;
+    for (int r = 0; r < PRESSURE_RESOURCES; r++) {
+        if (pressure->triggers[r] == fd) {
+            pressure->triggered++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool diskEnabled(const Options *opts) {
+    return opts->disk;
+}
+
+static int diskInit(void *state, const Options *opts) {
+    return diskOpen(state);
+}
+
+static int diskRead(void *state, uint64_t timestamp) {
+    return diskSample(state);
+}
+
+static void diskRates(void *state, uint64_t elapsed) {
+    diskDelta(state, elapsed);
+}
+
+static void diskRender(Frame *frame, const void *state, const Display *display) {
+    diskOutput(frame, state);
+}
+
+static void diskFree(void *state) {
+    diskClose(state);
+}
+
+static bool netEnabled(const Options *opts) {
+    return opts->net;
+}
+
+static int netInit(void *state, const Options *opts) {
+    return netOpen(state);
+}
+
+static int netRead(void *state, uint64_t timestamp) {
+    return netSample(state);
+}
+
+static void netRates(void *state, uint64_t elapsed) {
+    netDelta(state, elapsed);
+}
+
+static void netRender(Frame *frame, const void *state, const Display *display) {
+    netOutput(frame, state);
+}
+
+static void netFree(void *state) {
+    netClose(state);
+}
+
+static bool cgroupEnabled(const Options *opts) {
+    return opts->cgroup != NULL;
+}
+
+static int cgroupInit(void *state, const Options *opts) {
+    return cgroupOpen(state, opts->cgroup);
+}
+
+static int cgroupRead(void *state, uint64_t timestamp) {
+    return cgroupSample(state);
+}
+
+static void cgroupRates(void *state, uint64_t elapsed) {
+    cgroupDelta(state, elapsed);
+}
+
+static void cgroupRender(Frame *frame, const void *state, const Display *display) {
+    cgroupOutput(frame, state);
+}
+
+static void cgroupFree(void *state) {
+    cgroupClose(state);
+}
+
+/**
+ * Every section of the display, in the order it is shown. The first three are read by the
+ * sample engine; the others run next to it.
+ */
+static const CollectorOps registry[] = {
+    { "memory", "--system", 0, systemEnabled, NULL, NULL, NULL, memoryRender, NULL, NULL, NULL },
+    { "users", "--user", 0, usersEnabled, NULL, NULL, NULL, usersRender, NULL, NULL, NULL },
+    { "cpu", "--system", 0, systemEnabled, NULL, NULL, NULL, cpuRender, NULL, NULL, NULL },
+    { "top", "--top", sizeof(ProcTop), topEnabled, topInit, topSample, NULL, topRender, topFree, NULL, NULL },
+    { "pressure", "--pressure", sizeof(Pressure), pressureEnabled, pressureInit, pressureRead, NULL, pressureRender, pressureFree, pressureWatch, pressureWake },
+    { "disk", "--disk", sizeof(DiskStats), diskEnabled, diskInit, diskRead, diskRates, diskRender, diskFree, NULL, NULL },
+    { "net", "--net", sizeof(NetStats), netEnabled, netInit, netRead, netRates, netRender, netFree, NULL, NULL },
+    { "cgroup", "--cgroup", sizeof(CgroupStats), cgroupEnabled, cgroupInit, cgroupRead, cgroupRates, cgroupRender, cgroupFree, NULL, NULL },
+};
+
+int collectorsOpen(CollectorSet *set, const Options *opts, bool live) {
+    memset(set, 0, sizeof(*set));
+    for (size_t k = 0; k < sizeof(registry) / sizeof(registry[0]); k++) {
+        const CollectorOps *ops = &registry[k];
+        if (!ops->enabled(opts) || (!live && ops->sample)) {
+            continue;
+        }
+        Collector *collector = &set->collectors[set->count];
+        collector->ops = ops;
+        histInit(&collector->latency);
+        collector->state = ops->size > 0 ? calloc(1, ops->size) : NULL;
+        if ((ops->size > 0 && !collector->state) || (ops->init && ops->init(collector->state, opts) == -1)) {
+            int saved = errno;
+            free(collector->state);
+            collectorsClose(set);
+            errno = saved;
+            return -1;
+        }
+        set->count++;
+    }
+    return 0;
+}
+
+const char *collectorsUnshown(const Options *opts) {
+    // Records and shared memory only carry what the sample engine reads
+    if (opts->format == FORMAT_TEXT && !opts->daemon && !opts->replay && !opts->attach && !opts->serve) {
+        return NULL;
+    }
+    for (size_t k = 0; k < sizeof(registry) / sizeof(registry[0]); k++) {
+        if (registry[k].sample && registry[k].enabled(opts)) {
+            return registry[k].option;
+        }
+    }
+    return NULL;
+}
+
+int collectorsSample(CollectorSet *set, uint64_t timestamp) {
+    for (int c = 0; c < set->count; c++) {
+        Collector *collector = &set->collectors[c];
+        if (!collector->ops->sample) {
+            continue;
+        }
+        uint64_t start = nowNanos();
+        if (collector->ops->sample(collector->state, timestamp) == -1) {
+            return -1;
+        }
+        // Every collector gets the engine's timestamp, so all rates cover the same interval
+        if (collector->samples > 0 && collector->ops->delta) {
+            collector->ops->delta(collector->state, timestamp - collector->last);
+        }
+        histAdd(&collector->latency, nowNanos() - start);
+        collector->last = timestamp;
+        collector->samples++;
+    }
+    return 0;
+}
+
+int collectorsWatch(const CollectorSet *set, int *fds, int cap) {
+    int n = 0;
+    for (int c = 0; c < set->count; c++) {
+        const Collector *collector = &set->collectors[c];
+        if (collector->ops->watch) {
+            n += collector->ops->watch(collector->state, fds + n, cap - n);
+        }
+    }
+    return n;
+}
+
+bool collectorsWake(CollectorSet *set, int fd) {
+    for (int c = 0; c < set->count; c++) {
+        Collector *collector = &set->collectors[c];
+        if (collector->ops->wake && collector->ops->wake(collector->state, fd)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void collectorsRender(Frame *frame, const CollectorSet *set, const Display *display) {
+    for (int c = 0; c < set->count; c++) {
+        const Collector *collector = &set->collectors[c];
+        // The engine's collectors have been sampled whenever there is a frame to render
+        if (!collector->ops->sample || collector->samples > 0) {
+            collector->ops->render(frame, collector->state, display);
+        }
+    }
+}
+
+void collectorsClose(CollectorSet *set) {
+    for (int c = 0; c < set->count; c++) {
+        Collector *collector = &set->collectors[c];
+        if (collector->ops->close) collector->ops->close(collector->state);
+        free(collector->state);
+    }
+    set->count = 0;
+}
@@ -0,0 +1,154 @@
+#include "header.h"
+
+/**
+ * Returns the growth of a counter, or 0 if it went back (the device was replaced).
+ */
+static uint64_t counterDelta(uint64_t now, uint64_t before) {
+    return now >= before ? now - before : 0;
+}
+
+/**
+ * Finds a device of the previous sample by name; devices usually keep their line.
+ */
+static int findPrevious(const DiskStats *disk, int i) {
+    if (i < disk->previous_count && strcmp(disk->previous[i].name, disk->current[i].name) == 0) {
+        return i;
+    }
+    for (int j = 0; j < disk->previous_count; j++) {
+        if (strcmp(disk->previous[j].name, disk->current[i].name) == 0) return j;
+    }
+    return -1;
+}
+
+/**
+ * Tells whether a device is a whole disk: partitions have no entry in /sys/block.
+ */
+static bool isWholeDisk(const char *name) {
+    char path[64 + DEVICE_NAME_LEN], rooted[PROC_PATH_LEN];
+    int n = snprintf(path, sizeof(path), "/sys/block/%s", name);
+    // sysfs spells the '/' of names like cciss/c0d0 as '!'
+    for (char *c = path + 11; c < path + n; c++) {
+        if (*c == '/') *c = '!';
+    }
+    const char *block = procPath(path, rooted, sizeof(rooted));
+    return block && access(block, F_OK) == 0;
+}
+
+/**
+ * Counts the lines of a file read into memory; a last line without a newline counts too.
+ */
+static int countLines(const char *p) {
+    int lines = 0;
+    for (; *p; p = scanNextLine(p)) lines++;
+    return lines;
+}
+
+/**
+ * Makes room for `count` devices in every array, keeping the entries already there.
+ */
+static int diskReserve(DiskStats *disk, int count) {
+    if (count <= disk->cap) {
+        return 0;
+    }
+    int cap = disk->cap > 0 ? disk->cap : DISK_MAX_DEVICES;
+    while (cap < count) cap *= 2;
+    DiskCounters *current = realloc(disk->current, (size_t) cap * sizeof(*current));
+    if (!current) return -1;
+    disk->current = current;
+    DiskCounters *previous = realloc(disk->previous, (size_t) cap * sizeof(*previous));
+    if (!previous) return -1;
+    disk->previous = previous;
+    bool *whole = realloc(disk->whole, (size_t) cap * sizeof(*whole));
+    if (!whole) return -1;
+    disk->whole = whole;
+    bool *previous_whole = realloc(disk->previous_whole, (size_t) cap * sizeof(*previous_whole));
+    if (!previous_whole) return -1;
+    disk->previous_whole = previous_whole;
+    DiskRates *rates = realloc(disk->rates, (size_t) cap * sizeof(*rates));
+    if (!rates) return -1;
+    disk->rates = rates;
+    disk->cap = cap;
+    return 0;
+}
+
+int diskOpen(DiskStats *disk) {
+    memset(disk, 0, sizeof(*disk));
+    return procOpen(&disk->file, "/proc/diskstats", PROC_DISKSTATS_SIZE);
+}
+
+int diskSample(DiskStats *disk) {
+    // The last sample becomes the previous one, and the new one is read over the one before
+    DiskCounters *counters = disk->previous;
+    disk->previous = disk->current;
+    disk->current = counters;
+    bool *whole = disk->previous_whole;
+    disk->previous_whole = disk->whole;
+    disk->whole = whole;
+    disk->previous_count = disk->count;
+    int count;
+    // Every line is a device, so the arrays are sized before parsing and nothing is cut off
+    if (procRead(&disk->file) == -1 || diskReserve(disk, countLines(disk->file.buf)) == -1 ||
+        (count = parseDiskstats(disk->file.buf, disk->current, disk->cap)) == -1) {
+        disk->count = 0;
+        return -1;
+    }
+    disk->count = count;
+    for (int i = 0; i < count; i++) {
+        // Only a device that just appeared costs a lookup in /sys
+        int j = findPrevious(disk, i);
+        disk->whole[i] = j >= 0 ? disk->previous_whole[j] : isWholeDisk(disk->current[i].name);
+    }
+    disk->samples++;
+    return 0;
+}
+
+void diskDelta(DiskStats *disk, uint64_t elapsed) {
+    double seconds = elapsed / 1e9;
+    for (int i = 0; i < disk->count; i++) {
+        DiskRates *rates = &disk->rates[i];
+        memset(rates, 0, sizeof(*rates));
+        int j = findPrevious(disk, i);
+        if (j < 0 || seconds <= 0) {
+            continue;
+        }
+        const DiskCounters *now = &disk->current[i], *before = &disk->previous[j];
+        uint64_t reads = counterDelta(now->reads, before->reads), writes = counterDelta(now->writes, before->writes);
+        rates->read_iops = reads / seconds;
+        rates->write_iops = writes / seconds;
+        rates->read_bytes = counterDelta(now->read_sectors, before->read_sectors) * (double) DISK_SECTOR_SIZE / seconds;
+        rates->write_bytes = counterDelta(now->write_sectors, before->write_sectors) * (double) DISK_SECTOR_SIZE / seconds;
+        // Time spent per I/O, as iostat computes await
+        uint64_t waited = counterDelta(now->read_ms, before->read_ms) + counterDelta(now->write_ms, before->write_ms);
+        rates->await = reads + writes > 0 ? (double) waited / (double) (reads + writes) : 0.0;
+        rates->busy = 100.0 * counterDelta(now->io_ms, before->io_ms) / (seconds * 1e3);
+        if (rates->busy > 100.0) rates->busy = 100.0;
+    }
+}
+
+void diskClose(DiskStats *disk) {
+    procClose(&disk->file);
+    free(disk->current);
+    free(disk->previous);
+    free(disk->whole);
+    free(disk->previous_whole);
+    free(disk->rates);
+    disk->current = disk->previous = NULL;
+    disk->whole = disk->previous_whole = NULL;
+    disk->rates = NULL;
+    disk->cap = disk->count = disk->previous_count = 0;
+}
+
+void diskOutput(Frame *frame, const DiskStats *disk) {
+    framePrintf(frame, "--------------------------------------------\n");
+    framePrintf(frame, "### Disks ### (per second since the last sample)\n");
+    framePrintf(frame, "%-12s %9s %9s %11s %11s %9s %7s\n", "device", "reads", "writes", "read MB", "written MB", "await ms", "busy");
+    for (int i = 0; i < disk->count; i++) {
+        const DiskCounters *counters = &disk->current[i];
+        if (!disk->whole[i] || counters->reads + counters->writes == 0) {
+            continue;
+        }
+        const DiskRates *rates = &disk->rates[i];
+        framePrintf(frame, "%-12s %9.1f %9.1f %11.2f %11.2f %9.2f %6.1f%%\n", counters->name, rates->read_iops, rates->write_iops,
+                    rates->read_bytes / 1e6, rates->write_bytes / 1e6, rates->await, rates->busy);
+    }
+}
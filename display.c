@@ -0,0 +1,96 @@
+#include "header.h"
+
+int displayInit(Display *display, const Options *opts, int window) {
+    memset(display, 0, sizeof(*display));
+    display->opts = opts;
+    display->window = window;
+    if (historyInit(&display->history, window) == -1) {
+        return -1;
+    }
+    if (rollupInit(&display->rollups, window) == -1) {
+        historyFree(&display->history);
+        return -1;
+    }
+    display->rollups.available = opts->available;
+    if (opts->format == FORMAT_TEXT) {
+        if (frameInit(&display->frame, FRAME_SIZE, !opts->seq) == -1) {
+            rollupFree(&display->rollups);
+            historyFree(&display->history);
+            return -1;
+        }
+    }
+    else if (writerInit(&display->writer, opts->format, STDOUT_FILENO) == -1) {
+        rollupFree(&display->rollups);
+        historyFree(&display->history);
+        return -1;
+    }
+    formatDuration(opts->interval, display->every, sizeof(display->every));
+    return 0;
+}
+
+void displayUpdate(Display *display, const SampleSet *set, int cores, int sessions) {
+    HistorySample *sample = &display->current;
+    memset(sample, 0, sizeof(*sample));
+    sample->timestamp = set->timestamp;
+    display->cores = cores;
+    display->sessions = sessions;
+    if (!display->opts->sys) {
+        return;
+    }
+    History *history = &display->history;
+    sample->memory = set->memory;
+    bool available = display->opts->available;
+    sample->memory_delta = history->count > 0 ? memoryShown(&set->memory, available) - memoryShown(&historyAt(history, history->count - 1)->memory, available) : 0;
+    sample->cpu_usage = cpuUsage(set->cpu.total, &display->cpu_previous, &display->cpu_idle);
+    historyPush(history, sample);
+    rollupAdd(&display->rollups, sample);
+    if (display->opts->per_core > 0) {
+        sysstats_core_usage(display->cores_previous, set->cpu.cores, set->cpu.ncores, display->cores_usage);
+        memcpy(display->cores_previous, set->cpu.cores, (size_t) set->cpu.ncores * sizeof(CPU));
+        display->ncores = set->cpu.ncores;
+    }
+}
+
+void displayRestart(Display *display) {
+    display->cpu_previous = 0;
+    display->cpu_idle = 0;
+    memset(display->cores_previous, 0, sizeof(display->cores_previous));
+}
+
+void displayRender(Display *display, const SampleSet *set, const char *title) {
+    const Options *opts = display->opts;
+    if (opts->format != FORMAT_TEXT) {
+        // Machine-readable output skips the display entirely
+        writerRecord(&display->writer, &display->current, opts->sys ? display->cores : 0, opts->user ? display->sessions : 0);
+        return;
+    }
+    Frame *frame = &display->frame;
+    display->set = set;
+    frameBegin(frame);
+    framePrintf(frame, "%s\n", title);
+    // Every section, memory and CPU included, comes from the collector registry
+    if (display->collectors){
+        collectorsRender(frame, display->collectors, display);
+    }
+    if (frameFlush(frame) == -1) {
+        perror("Error writing frame");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void displayFree(Display *display) {
+    if (display->opts->format == FORMAT_TEXT) {
+        Frame *frame = &display->frame;
+        if (frame->frames > 0) {
+            printf("--------------------------------------------\n");
+            printf("Renderer: %ld frames, %.0f bytes/frame (%.0f for full redraws), last frame %zu bytes\n",
+                   frame->frames, (double) frame->bytes / frame->frames, (double) frame->full_bytes / frame->frames, frame->last_bytes);
+        }
+        frameFree(frame);
+    }
+    else {
+        writerFree(&display->writer);
+    }
+    rollupFree(&display->rollups);
+    historyFree(&display->history);
+}
@@ -16,10 +16,142 @@
 #include <math.h>
 #include <utmp.h>
 #include <errno.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <dirent.h>
+#include "procfs.h"
 
 #define _POSIX_C_SOURCE 200809L
 #define MAX_STR_LEN 1024
 
+/**
+ * @brief The library types under the names the program uses.
+ */
+typedef SysStatsMemory MemoryInfo;
+typedef SysStatsCpu CPU;
+typedef SysStatsCpuSample CpuSample;
+#define MAX_CORES SYSSTATS_MAX_CORES
+#define CPU_SAMPLE_SIZE(n) SYSSTATS_CPU_SAMPLE_SIZE(n)
+
+/**
+ * @brief Number of samples kept for display when the sample count is unlimited or larger than this.
+ */
+#define HISTORY_CAPACITY 128
+
+/**
+ * @brief Layout of the log-linear histogram buckets.
+ */
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+/**
+ * @brief Batch buffer size of the machine-readable output, the longest record it formats, and
+ * the longest time a record waits in the buffer (in nanoseconds).
+ */
+#define OUTPUT_BUFFER_SIZE 65536
+#define OUTPUT_RECORD_MAX 1024
+#define OUTPUT_FLUSH_INTERVAL 1000000000ull
+
+/**
+ * @brief Identification of the binary recordings written by --record.
+ */
+#define RECORD_MAGIC "MSSTATS"
+#define RECORD_VERSION 3
+#define RECORD_VERSION_BASIC 2
+#define RECORD_VERSION_RAW 1
+
+/**
+ * @brief Samples between two keyframes of a packed recording, and the longest packed record.
+ */
+#define RECORD_KEYFRAME_INTERVAL 1024
+#define RECORD_PACKED_MAX 256
+
+/**
+ * @brief Identification of the shared-memory segment published by --daemon, its default
+ * name, and the number of samples kept in its ring.
+ */
+#define SHM_MAGIC "MSSTSHM"
+#define SHM_VERSION 2
+#define SHM_DEFAULT_NAME "/mySystemStats"
+#define SHM_CAPACITY 1024
+
+/**
+ * @brief Limits of the metrics server: initial exposition buffer, room kept for the HTTP
+ * header, listen backlog, longest request, and the time a client may take (in nanoseconds).
+ */
+#define SERVE_BUFFER_SIZE 16384
+#define SERVE_HEADER_RESERVE 256
+#define SERVE_BACKLOG 1024
+#define SERVE_REQUEST_MAX 8192
+#define SERVE_CLIENT_TIMEOUT 5000000000ull
+
+/**
+ * @brief Concurrent connections opened by the --bench=serve load test.
+ */
+#define SERVE_BENCH_CONNECTIONS 256
+
+/**
+ * @brief Number of rollup tiers kept next to the sample history (1 s, 10 s, 1 min and 10 min).
+ */
+#define ROLLUP_TIERS 4
+
+/**
+ * @brief Shortest time between two frames drawn while replaying a recording, in nanoseconds.
+ */
+#define REPLAY_FRAME_INTERVAL 33000000ull
+
+/**
+ * @brief Range of the sampling interval that the + and - keys step through, in nanoseconds.
+ */
+#define INTERVAL_MIN 10000000ull
+#define INTERVAL_MAX 3600000000000ull
+
+/**
+ * @brief Initial size of the frame buffers of the terminal renderer.
+ */
+#define FRAME_SIZE 65536
+
+/**
+ * @brief Block devices and network interfaces that --disk and --net make room for up front,
+ * and the size of a sector in /proc/diskstats. The collectors grow past these with the files.
+ */
+#define DISK_MAX_DEVICES 64
+#define NET_MAX_INTERFACES 32
+#define DISK_SECTOR_SIZE 512
+
+/**
+ * @brief Most collectors in a registry, and most descriptors they can wake the sampling loop with.
+ */
+#define COLLECTORS_MAX 8
+#define COLLECTORS_MAX_WAKES 16
+
+/**
+ * @brief Limits of the process scanner behind --top: most threads it uses, fewest processes
+ * worth waking them for, processes taken per batch, and the read buffer for /proc/[pid]/stat.
+ */
+#define TOP_MAX_THREADS 8
+#define TOP_PARALLEL_MIN 1024
+#define TOP_BATCH 64
+#define TOP_STAT_SIZE 1024
+
+/**
+ * @brief Number of processes listed by --top without a value, and the most extra processes
+ * started by --bench=top.
+ */
+#define DEFAULT_TOP 10
+#define TOP_BENCH_PIDS 8000
+
+/**
+ * @brief Number of per-core bars printed on one line, and the number of hottest cores listed by default.
+ */
+#define CORE_COLUMNS 4
+#define DEFAULT_HOTTEST 5
+
 /**
  * @brief A node in a linked list for storing memory usage information.
  * 
@@ -37,276 +169,3036 @@ typedef struct LinkedList {
 }Memory;
 
 /**
- * @brief A structure to hold detailed memory statistics.
- * 
- * This structure encapsulates information about the system's memory usage, including
- * total and used physical memory, as well as total and used virtual memory. It is used
- * to aggregate memory statistics for easy access and manipulation.
+ * @brief One sample of the display history, kept as numbers rather than formatted rows.
  *
- * @param total_memory Total physical memory available on the system (in GB).
- * @param used_memory Amount of physical memory currently in use (in GB).
- * @param total_virtual Total virtual memory available on the system (in GB).
- * @param used_virtual Amount of virtual memory currently in use (in GB).
+ * @param timestamp CLOCK_MONOTONIC time of the sample in nanoseconds.
+ * @param memory Memory statistics of the sample.
+ * @param memory_delta Change in the shown physical memory figure since the previous sample (in GB).
+ * @param cpu_usage CPU usage of the sample in percent.
  */
 typedef struct {
-    double total_memory;
-    double used_memory;
-    double total_virtual;
-    double used_virtual;
-} MemoryInfo;
+    uint64_t timestamp;
+    MemoryInfo memory;
+    double memory_delta;
+    double cpu_usage;
+} HistorySample;
 
 /**
- * @brief A structure to hold CPU usage statistics.
- * 
- * Represents the CPU usage data by storing the total idle time and the total time
- * spent performing all system activities. This structure can be used to calculate
- * CPU utilization percentages and to track CPU activity over time.
+ * @brief A fixed-capacity ring buffer of history samples.
  *
- * @param time Total idle time of the CPU.
- * @param tot Total time spent on all CPU activities including system, user, and idle processes.
+ * Once the ring is full, each new sample replaces the oldest one, so memory use does not
+ * depend on how long the program runs.
+ *
+ * @param samples The ring storage, allocated once by `historyInit`.
+ * @param capacity Number of slots in the ring.
+ * @param head Slot of the oldest sample.
+ * @param count Number of samples currently kept.
+ * @param total Number of samples pushed since the start.
  */
-typedef struct CPUUsage{
-    long int time;
-    long int tot;
-}CPU;
+typedef struct {
+    HistorySample *samples;
+    int capacity;
+    int head;
+    int count;
+    long total;
+} History;
 
 /**
- * @brief Monitors and prints memory usage information.
- * 
- * This function retrieves current process memory usage and system memory information,
- * constructs a memory usage string, and stores it directly in a specified index of a 2D character array.
- * Each 'row' of this array represents a snapshot of memory usage information.
- * If graph mode is enabled, it also appends a graphical representation of memory usage to the same 'row'.
- * The function prints memory usage information for each snapshot up to the current index,
- * and if in sequential mode, it specifically prints information corresponding to the current iteration.
- * Additional empty lines may be printed for alignment in graphical mode.
- *
- * @param samples The total number of samples to process. This should match the first dimension of the 'record' array.
- * @param i The current sample index. This determines which 'row' of the 'record' array to update with the new memory usage information.
- * @param info A struct containing memory information metrics. This includes details such as used and total physical and virtual memory.
- * @param graph Boolean flag indicating if graphical mode is enabled. In graphical mode, a visual representation of memory usage changes is appended.
- * @param seq Boolean flag indicating if sequential mode is enabled. In sequential mode, only the current iteration's memory usage information is printed.
- * @param previous Pointer to a double tracking the previous memory usage. This is used for generating the graphical representation in graph mode.
- * @param record A 2D character array where each 'row' is designated to store a snapshot of memory usage information, including optional graphical representations. The size of each 'row' is defined by MAX_STR_LEN.
- * @return void
+ * @brief Minimum, maximum, sum and newest value of one quantity over a rollup bucket.
  */
-void memoryUsage(int samples, int i, MemoryInfo info, bool graph, bool seq, double *previous, char record[][MAX_STR_LEN]);
+typedef struct {
+    double min;
+    double max;
+    double sum;
+    double last;
+} Aggregate;
 
 /**
- * @brief Retrieves memory statistics and writes them to a pipe.
- * 
- * This function gathers memory statistics using sysinfo, populates a MemoryInfo struct
- * with total and used memory (physical and virtual), and writes this information to the
- * specified pipe. If an error occurs during retrieval or writing, the process and its
- * parent are terminated.
+ * @brief The samples of one time bucket of a rollup tier, summarised.
  *
- * @param pipe An array of two integers representing the read and write ends of a pipe.
- * @return void
+ * @param start CLOCK_MONOTONIC start of the bucket, a multiple of the tier width.
+ * @param count Number of samples in the bucket; the means are the sums divided by it.
+ * @param memory Used physical memory (in GB).
+ * @param virtual_memory Used virtual memory (in GB).
+ * @param available Available physical memory (in GB).
+ * @param cpu CPU usage in percent.
  */
-void memoryStats(int pipe[2]);
+typedef struct {
+    uint64_t start;
+    long count;
+    Aggregate memory;
+    Aggregate virtual_memory;
+    Aggregate available;
+    Aggregate cpu;
+} RollupBucket;
 
 /**
- * @brief Appends a graphical representation of memory usage change to a specific index of a 2D character array.
- * 
- * This function calculates the difference in memory usage since the last call and creates a visual representation of this change.
- * It then appends this graphical representation to the memory usage string stored at the specified index of the 2D array.
- * The visual representation includes a line of characters indicating the magnitude of the change, followed by a special
- * character representing the direction of the change (increase, decrease, or no change). Additionally, the function
- * formats and appends textual information about the absolute difference in memory usage and the current memory usage.
+ * @brief One rollup tier: a ring of buckets of a fixed width.
  *
- * @param memory_current The current memory usage measurement.
- * @param memory_previous A pointer to a double value representing the previous memory usage measurement. This value is updated
- *                        with `memory_current` after the graphical representation is generated.
- * @param i The index of the 2D array `record` where the memory usage information and graphical representation will be appended.
- *          This index corresponds to a specific snapshot or time point in the memory monitoring process.
- * @param record A 2D character array where each 'row' is designated to store a snapshot of memory usage information, including
- *               the graphical representation. The array should have a sufficient number of rows to accommodate all desired
- *               snapshots, and each row must have a length defined by MAX_STR_LEN to ensure there is enough space for the information.
- * 
- * @note The function assumes that `record[i]` has been properly initialized and contains any initial memory usage information
- *       before the graphical representation is appended. The function does not clear or overwrite existing content in `record[i]`
- *       except to append the new graphical representation.
+ * `history` holds one sample per bucket with the means of the bucket, so the regular
+ * memory and CPU graphics can draw a tier; `buckets` holds the full summaries in the
+ * same slots. The newest bucket is still open and is updated in place by each sample.
+ *
+ * @param width Width of a bucket in nanoseconds.
+ * @param history The bucket means, as samples.
+ * @param buckets The bucket summaries, indexed like `history.samples`.
  */
-void appendMemoryGraphicToTail(double memory_current, double *memory_previous, int i, char record[][MAX_STR_LEN]);
+typedef struct {
+    uint64_t width;
+    History history;
+    RollupBucket *buckets;
+} RollupTier;
 
 /**
- * @brief Reads login records from the utmp file and writes them to a pipe.
- * 
- * This function sets the path to the utmp file to read login records and iterates
- * through each record. For each user process found (indicating an active user session),
- * it formats a string containing the username, session ID, and host, and writes this
- * string to the specified pipe. If any step fails, it outputs an error message and
- * terminates the current process as well as its parent process.
+ * @brief All rollup tiers, from the finest to the coarsest.
  *
- * @param pipe An array of two integers representing the read and write ends of a pipe.
- * @return void
+ * @param tiers The tiers.
+ * @param available True to compute the memory change of a bucket from available memory.
  */
-void userOutput(int pipe[2]);
+typedef struct {
+    RollupTier tiers[ROLLUP_TIERS];
+    bool available;
+} Rollups;
 
 /**
- * @brief Counts the number of processor cores available on the system.
- * 
- * This function reads the "/proc/cpuinfo" file to count the number of occurrences
- * of the string "processor", which corresponds to an individual core. It returns
- * the total count of processor cores found. If the file cannot be opened, it returns -1,
- * indicating an error.
- * 
- * @return The number of processor cores on the system. Returns -1 if the file cannot be opened.
+ * @brief A screen frame built in memory and written to the terminal in one go.
+ *
+ * Sections of the display are appended to `text` with `framePrintf`. On flush, the frame is
+ * compared line by line with the previous one; in incremental mode only the changed lines are
+ * sent, using relative cursor movement, and the whole update goes out in a single write().
+ * All buffers are allocated up front and only grow if a frame outgrows them.
+ *
+ * @param text The frame being built.
+ * @param len Number of bytes in `text`.
+ * @param cap Allocated size of `text`.
+ * @param prev The previously flushed frame.
+ * @param prev_len Number of bytes in `prev`.
+ * @param prev_cap Allocated size of `prev`.
+ * @param out The escape sequences and text of the pending update.
+ * @param out_cap Allocated size of `out`.
+ * @param prev_lines Number of lines of the previously flushed frame.
+ * @param incremental True to redraw in place; false to append every frame (sequential mode).
+ * @param redraw True to clear the screen and draw the next frame in full.
+ * @param frames Number of frames flushed.
+ * @param bytes Total number of bytes written.
+ * @param full_bytes Total number of bytes that full redraws of the same frames would have written.
+ * @param last_bytes Number of bytes written by the last flush.
  */
-int count_cores();
+typedef struct {
+    char *text;
+    size_t len;
+    size_t cap;
+    char *prev;
+    size_t prev_len;
+    size_t prev_cap;
+    char *out;
+    size_t out_cap;
+    int prev_lines;
+    bool incremental;
+    bool redraw;
+    long frames;
+    uint64_t bytes;
+    uint64_t full_bytes;
+    size_t last_bytes;
+} Frame;
 
 /**
- * @brief Retrieves CPU usage statistics and writes them to a pipe.
- * 
- * This function opens and reads from the "/proc/stat" file to gather CPU statistics,
- * including time spent in different modes (user, nice, system, idle, iowait, irq,
- * softirq). It calculates total CPU time and idle time, encapsulates these values
- * in a CPU structure, and writes the structure to the specified pipe. If an error occurs
- * during any step of the process, it outputs an error message and terminates both the
- * current and parent processes to prevent further execution.
+ * @brief A histogram of unsigned values with log-linear buckets.
  *
- * @param pipe An array of two integers representing the read and write ends of a pipe.
- * @return void
+ * Values below HIST_SUB_BUCKETS have a bucket each; above that, every power of two is split
+ * into HIST_SUB_BUCKETS linear buckets, which bounds the relative error of a percentile to
+ * about 6%. Adding a value is O(1) and the histogram has a fixed size.
+ *
+ * @param buckets Number of values recorded per bucket.
+ * @param count Number of values recorded.
+ * @param sum Sum of the values recorded.
+ * @param min Smallest value recorded (UINT64_MAX if none).
+ * @param max Largest value recorded.
  */
-void cpuStats(int pipefd[2]);
+typedef struct {
+    uint64_t buckets[HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} Histogram;
 
 /**
- * @brief Calculates current CPU usage, optionally appends a graphical representation to a record array, and prints CPU usage information.
- * 
- * This function calculates the current CPU usage based on the difference in total and idle CPU times since the last measurement.
- * It then prints general CPU information, including the number of cores and the calculated CPU usage percentage. If graphical
- * output is enabled, it also calls `appendAndPrintCpuGraphics` to append a graphical representation of the current CPU usage to
- * the record array and print all records up to the current index.
- *
- * @param graphics Boolean flag indicating if graphical representation is enabled. When true, graphical CPU usage data is appended
- *                 to the record array and printed alongside textual CPU information.
- * @param i The current index for storing the graphical representation in the record array. This parameter is relevant only when
- *          graphical output is enabled.
- * @param cpu_previous Pointer to a long integer tracking the previous total CPU time. This value is updated with the current total
- *                     CPU time after calculating the current CPU usage.
- * @param time_previous Pointer to a long integer tracking the previous idle CPU time. This value is updated with the current idle
- *                      CPU time after calculating the current CPU usage.
- * @param info A structure containing the current total and idle CPU times.
- * @param record A 2D character array for storing graphical representations of CPU usage, used when graphical output is enabled. Each
- *               'row' in the array corresponds to a snapshot of CPU usage information, with the array size defined to accommodate
- *               all snapshots, and each 'row' having a length determined by MAX_STR_LEN.
+ * @brief A sampling schedule on a grid of absolute CLOCK_MONOTONIC deadlines.
+ *
+ * The first deadline is the time of the first sample and deadline k is k intervals later,
+ * so time spent between samples never accumulates as drift.
+ *
+ * @param interval Time between deadlines in nanoseconds.
+ * @param deadline The deadline of the current sample.
+ * @param last Timestamp of the previous sample.
+ * @param ticks Number of samples scheduled.
+ * @param missed Number of deadlines skipped because the previous sample overran them.
+ * @param retimed True when the interval changed or sampling resumed since the last sample.
+ * @param intervals Distribution of the actual time between consecutive samples.
+ * @param lateness Distribution of how late each sample woke up after its deadline.
  */
-void cpu_output(bool graphics, int i, long int* cpu_previous, long int* time_previous, CPU info, char record[][MAX_STR_LEN]);
+typedef struct {
+    uint64_t interval;
+    uint64_t deadline;
+    uint64_t last;
+    long ticks;
+    long missed;
+    bool retimed;
+    Histogram intervals;
+    Histogram lateness;
+} Scheduler;
 
 /**
- * @brief Constructs a graphical representation of CPU usage and appends it to the record array, then prints all records up to the current index.
- * 
- * This function creates a visual representation of the CPU usage, consisting of a series of bars corresponding to the usage percentage.
- * It then stores this graphical representation in the specified index of a 2D character array. After appending the graphical data,
- * the function prints each entry of the array up to and including the current one, effectively displaying the CPU usage history.
+ * @brief The sampling engines that can drive the collectors.
  *
- * @param usage The current CPU usage percentage to be graphically represented.
- * @param i The index in the 2D character array where the graphical representation of the current CPU usage is to be stored.
- * @param record A 2D character array where each 'row' stores a graphical representation of CPU usage. The array must be
- *               large enough to accommodate all entries, with each 'row' having a length defined by MAX_STR_LEN.
+ * ENGINE_FORK is the original engine, which creates three pipes and forks three short-lived
+ * children on every sample. ENGINE_PROCESS and ENGINE_THREAD start one long-lived worker per
+ * collector, either as a child process or as a thread, and drive it over a pair of pipes that
+ * stay open for the whole run. ENGINE_INLINE samples in the calling thread through libsysstats,
+ * with no worker and no pipe.
  */
-void appendAndPrintCpuGraphics(double usage, int i, char record[][MAX_STR_LEN]);
+typedef enum {
+    ENGINE_FORK,
+    ENGINE_PROCESS,
+    ENGINE_THREAD,
+    ENGINE_INLINE
+} EngineMode;
 
 /**
- * @brief Prints operating system information.
- * 
- * Retrieves information about the operating system using the uname function and prints
- * the system name, machine name, version, release, and architecture to the standard output.
+ * @brief Identifies the collector run by a worker.
+ */
+typedef enum {
+    COLLECT_MEMORY,
+    COLLECT_USER,
+    COLLECT_CPU,
+    COLLECT_COUNT
+} CollectorKind;
+
+/**
+ * @brief Commands the parent sends to a persistent worker over its command pipe.
+ */
+#define WORKER_SAMPLE 'S'
+#define WORKER_QUIT 'Q'
+
+/**
+ * @brief Header of every reply a persistent worker writes to its data pipe.
  *
- * @return void
+ * The header is followed by `length` bytes of payload: a MemoryInfo, the used part of a
+ * CpuSample, or the formatted session lines, depending on the collector. The session
+ * collector sends no payload when the list has not changed since its previous reply.
+ *
+ * @param status 0 if the sample was collected, otherwise the errno value of the failure.
+ * @param length Number of payload bytes following the header.
+ * @param unchanged True if the session list is the same as in the previous reply.
+ * @param logins Number of sessions that appeared since the previous reply.
+ * @param logouts Number of sessions that ended since the previous reply.
+ * @param elapsed Time the worker took to collect the sample, in nanoseconds.
+ * @param cpu_time CPU time the worker's process has used so far, in nanoseconds.
  */
-void getOSInfo();
+typedef struct {
+    int status;
+    size_t length;
+    bool unchanged;
+    int logins;
+    int logouts;
+    uint64_t elapsed;
+    uint64_t cpu_time;
+} WorkerReply;
 
 /**
- * @brief Prints the system's uptime.
- * 
- * Reads the system's uptime from "/proc/uptime", calculates the total time in days, hours,
- * minutes, and seconds format, and prints this information along with the total hours to the
- * standard output.
+ * @brief Identifies a user session across two reads of utmp.
  *
- * @return void
+ * @param pid Process id of the login process.
+ * @param line Terminal of the session.
  */
-void getUptime();
+typedef struct {
+    pid_t pid;
+    char line[UT_LINESIZE];
+} SessionKey;
 
 /**
- * @brief Prints system information and uptime.
- * 
- * A convenience function that prints a divider followed by calling `getOSInfo` to print
- * operating system details, and `getUptime` to print the system uptime.
+ * @brief A session list kept in memory and re-read only when utmp changes.
  *
- * @return void
+ * An inotify watch on _PATH_UTMP marks the list stale; refreshing an unchanged list costs
+ * one non-blocking read() of the inotify descriptor. The keys of the sessions are kept
+ * sorted, so that logins and logouts are counted with one merge of the old and new keys.
+ *
+ * @param fd The inotify descriptor, or -1 if inotify is not available.
+ * @param wd The watch on utmp, or -1 while the file is not watched.
+ * @param stale True if utmp must be read on the next refresh.
+ * @param list The formatted session lines (not NUL-terminated).
+ * @param len Number of valid bytes in `list`.
+ * @param cap Allocated size of `list`.
+ * @param keys Sorted keys of the sessions in `list`.
+ * @param previous Scratch copy of the keys before the last read.
+ * @param count Number of sessions in `list`.
+ * @param keys_cap Allocated number of entries in `keys` and `previous`.
+ * @param version Incremented every time the list changes.
+ * @param logins Number of sessions that appeared in the last refresh.
+ * @param logouts Number of sessions that ended in the last refresh.
  */
-void systemInfo();
+typedef struct {
+    int fd;
+    int wd;
+    bool stale;
+    char *list;
+    size_t len;
+    size_t cap;
+    SessionKey *keys;
+    SessionKey *previous;
+    int count;
+    int keys_cap;
+    uint64_t version;
+    int logins;
+    int logouts;
+} SessionWatch;
 
 /**
- * @brief Signal handler for SIGINT and SIGTSTP signals.
- * 
- * This function provides custom handling for SIGINT (Ctrl+C) and SIGTSTP (Ctrl+Z) signals.
- * For SIGINT, it prompts the user to confirm if they want to quit the application. If the
- * user responds with 'y' or 'Y', the application exits successfully. For SIGTSTP, the
- * function simply returns, effectively ignoring the signal. If `scanf` fails to read the
- * input due to a signal interruption (EINTR), it prints a message and resumes. Other
- * `scanf` errors trigger a fatal error message and the application exits with a failure
- * status.
+ * @brief A long-lived collector, running either as a child process or as a thread.
  *
- * @param sig The signal number of the received signal.
- * @return void
+ * @param kind The collector this worker runs.
+ * @param cmd Command pipe; the parent writes to cmd[1] and the worker reads cmd[0].
+ * @param data Data pipe; the worker writes replies to data[1] and the parent reads data[0].
+ * @param pid Process id of the worker in ENGINE_PROCESS mode.
+ * @param thread Thread handle of the worker in ENGINE_THREAD mode.
+ * @param running True while the worker is alive and owns its pipes.
+ * @param cpu_time CPU time the worker's process had used at its last reply, in nanoseconds.
  */
-void handle_sigint(int sig);
+typedef struct {
+    CollectorKind kind;
+    int cmd[2];
+    int data[2];
+    pid_t pid;
+    pthread_t thread;
+    bool running;
+    uint64_t cpu_time;
+} CollectorWorker;
 
 /**
- * @brief Checks if a string represents an integer.
- * 
- * Validates whether a given string consists solely of digit characters, potentially
- * preceded by a sign (+/-), thus representing a valid integer.
+ * @brief The set of collectors used for one run, plus the engine that drives them.
  *
- * @param str Pointer to the string to be checked.
- * @return Returns true if the string represents an integer, false otherwise.
+ * @param mode The sampling engine.
+ * @param enabled Which collectors are sampled, indexed by CollectorKind.
+ * @param workers The persistent workers, unused in ENGINE_FORK and ENGINE_INLINE mode.
+ * @param memory_stats The memory sampler in ENGINE_INLINE mode.
+ * @param cpu_stats The CPU sampler in ENGINE_INLINE mode; apart from `memory_stats` so that each is timed on its own.
+ * @param snapshot The last snapshot taken by the samplers.
+ * @param sessions The session list in ENGINE_INLINE mode.
  */
-bool isInteger(const char *str);
+typedef struct {
+    EngineMode mode;
+    bool enabled[COLLECT_COUNT];
+    CollectorWorker workers[COLLECT_COUNT];
+    SysStats *memory_stats;
+    SysStats *cpu_stats;
+    SysStatsSnapshot snapshot;
+    SessionWatch sessions;
+} SampleEngine;
 
 /**
- * @brief Parses command-line arguments to configure application parameters.
- * 
- * This function interprets the command-line arguments provided to the application,
- * setting the appropriate parameters for sample size, delay, and various boolean flags
- * indicating the operational modes (system, user, sequential, and graphics). If no mode
- * is explicitly selected, it defaults to both user and system modes enabled. It supports
- * arguments in both '--key=value' and positional formats. Positional numeric arguments
- * are interpreted as 'samples' and 'delay' if not preceded by a flag, in that order.
+ * @brief The results of one sample across all collectors.
  *
- * @param argc The number of command-line arguments.
- * @param argv Array of pointers to the argument strings.
- * @param samples Pointer to an int to store the sample size.
- * @param delay Pointer to an int to store the delay.
- * @param seq Pointer to a bool to indicate if sequential mode is enabled.
- * @param sys Pointer to a bool to indicate if system mode is enabled.
- * @param user Pointer to a bool to indicate if user mode is enabled.
- * @param graph Pointer to a bool to indicate if graphics mode is enabled.
- * @return Returns true if arguments are successfully parsed; otherwise, false.
+ * The session buffer is owned by the set and only grows, so steady-state sampling does not
+ * allocate. Release it with `freeSampleSet`.
+ *
+ * @param timestamp CLOCK_MONOTONIC time at which the sample was taken, in nanoseconds.
+ * @param memory Memory statistics from the memory collector.
+ * @param cpu Raw aggregate and per-core CPU counters from the CPU collector.
+ * @param sessions Formatted session lines from the user collector (not NUL-terminated).
+ * @param sessions_len Number of valid bytes in `sessions`.
+ * @param sessions_cap Allocated size of `sessions`.
+ * @param sessions_version Version of the session list copied into `sessions`.
+ * @param logins Number of sessions that appeared since the previous sample.
+ * @param logouts Number of sessions that ended since the previous sample.
+ * @param collect_ns Time each collector took for this sample, in nanoseconds, indexed by CollectorKind.
+ * @param worker_cpu CPU time used so far by the persistent worker processes, which are only reaped at the end, in nanoseconds.
  */
-bool parseargument(int argc, char **argv, int* samples, int* delay,bool* seq, bool* sys, bool* user, bool* graph);
+typedef struct {
+    uint64_t timestamp;
+    MemoryInfo memory;
+    CpuSample cpu;
+    char *sessions;
+    size_t sessions_len;
+    size_t sessions_cap;
+    uint64_t sessions_version;
+    int logins;
+    int logouts;
+    uint64_t collect_ns[COLLECT_COUNT];
+    uint64_t worker_cpu;
+} SampleSet;
 
 /**
- * @brief Collects and prints system information based on the provided parameters.
- * 
- * This function sets up signal handling for SIGINT and SIGTSTP, creates pipes for interprocess communication,
- * and forks separate processes to collect memory, CPU, and user session information. Each child process
- * executes a specific task and writes its output to a pipe. The parent process reads from these pipes
- * and prints the gathered information. It supports printing information in a sequential manner or all at once,
- * based on the 'seq' flag. It also handles graphical representation of the memory and CPU usage if the 'graph'
- * flag is enabled. After collecting and printing the specified number of samples with the given delay, it
- * cleans up by closing pipes and freeing allocated memory.
- *
- * @param samples Number of information samples to collect and print.
- * @param delay Time delay between each sample collection in seconds.
- * @param seq Boolean flag indicating if the output should be sequential.
- * @param sys Boolean flag indicating if system (CPU and memory) information should be collected.
- * @param user Boolean flag indicating if user session information should be collected.
- * @param graph Boolean flag indicating if graphical representation is enabled for memory and CPU usage.
- * @return void
- */
-void printinfo(int samples, int delay, bool seq, bool sys, bool user, bool graph);
+ * @brief Output formats of the sampling loop.
+ *
+ * FORMAT_TEXT is the interactive display. FORMAT_JSONL and FORMAT_CSV write one record per
+ * sample for log pipelines and skip the display entirely.
+ */
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_JSONL,
+    FORMAT_CSV
+} OutputFormat;
+
+/**
+ * @brief Formats machine-readable sample records into a reusable buffer and writes them in batches.
+ *
+ * @param format FORMAT_JSONL or FORMAT_CSV.
+ * @param fd The file descriptor the records are written to.
+ * @param buf The batch buffer, allocated once.
+ * @param len Number of bytes waiting in `buf`.
+ * @param cap Allocated size of `buf`.
+ * @param wall_offset CLOCK_REALTIME minus CLOCK_MONOTONIC, in nanoseconds, used to timestamp records.
+ * @param last_flush CLOCK_MONOTONIC time of the last flush.
+ * @param records Number of records formatted.
+ * @param flushes Number of write() calls made.
+ */
+typedef struct {
+    OutputFormat format;
+    int fd;
+    char *buf;
+    size_t len;
+    size_t cap;
+    int64_t wall_offset;
+    uint64_t last_flush;
+    long records;
+    long flushes;
+} RecordWriter;
+
+/**
+ * @brief Header at the start of a recording made with --record.
+ *
+ * A RECORD_VERSION_RAW recording is followed by fixed-size records; a RECORD_VERSION
+ * recording by packed records (see Codec). RECORD_VERSION_BASIC recordings are packed too but
+ * predate the memory breakdown, and like raw ones hold records of RECORD_BASIC_SIZE bytes.
+ *
+ * @param magic RECORD_MAGIC.
+ * @param version RECORD_VERSION, RECORD_VERSION_BASIC or RECORD_VERSION_RAW.
+ * @param record_size Size of a decoded record: sizeof(SampleRecord), or RECORD_BASIC_SIZE.
+ * @param flags Reserved, 0.
+ * @param reserved Padding, 0.
+ * @param interval The sampling interval of the recording in nanoseconds.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t interval;
+} RecordHeader;
+
+/**
+ * @brief One fixed-size sample of a recording.
+ *
+ * Memory is stored in whole kilobytes and CPU time as the raw counters read from /proc/stat,
+ * so usage can be recomputed exactly between any two records.
+ *
+ * @param timestamp CLOCK_MONOTONIC time of the sample in nanoseconds.
+ * @param wall_time CLOCK_REALTIME time of the sample in nanoseconds since the epoch.
+ * @param total_memory_kb Total physical memory.
+ * @param used_memory_kb Used physical memory.
+ * @param total_virtual_kb Total virtual memory.
+ * @param used_virtual_kb Used virtual memory.
+ * @param cpu_tot Aggregate non-idle CPU time (CPU.tot).
+ * @param cpu_idle Aggregate idle CPU time (CPU.time).
+ * @param cores Number of cores.
+ * @param sessions Number of user sessions.
+ * @param available_kb Available memory (MemAvailable).
+ * @param cached_kb Page cache.
+ * @param buffers_kb Block device buffers.
+ * @param dirty_kb Page cache waiting to be written back.
+ * @param writeback_kb Page cache being written back.
+ * @param anon_pages_kb Anonymous memory.
+ * @param slab_kb Kernel slab caches.
+ * @param huge_total_kb Memory in the huge page pool.
+ * @param huge_free_kb Free memory in the huge page pool.
+ */
+typedef struct {
+    uint64_t timestamp;
+    int64_t wall_time;
+    uint64_t total_memory_kb;
+    uint64_t used_memory_kb;
+    uint64_t total_virtual_kb;
+    uint64_t used_virtual_kb;
+    int64_t cpu_tot;
+    int64_t cpu_idle;
+    uint32_t cores;
+    uint32_t sessions;
+    uint64_t available_kb;
+    uint64_t cached_kb;
+    uint64_t buffers_kb;
+    uint64_t dirty_kb;
+    uint64_t writeback_kb;
+    uint64_t anon_pages_kb;
+    uint64_t slab_kb;
+    uint64_t huge_total_kb;
+    uint64_t huge_free_kb;
+} SampleRecord;
+
+/**
+ * @brief Size of the records of RECORD_VERSION_RAW and RECORD_VERSION_BASIC recordings, which
+ * end before the memory breakdown.
+ */
+#define RECORD_BASIC_SIZE offsetof(SampleRecord, available_kb)
+
+/**
+ * @brief State of the packed sample stream of a recording, on the writing or the reading side.
+ *
+ * Each packed record starts with a varint tag: bit 0 marks a keyframe, each further bit
+ * says that one field is present, and the bit after the fields marks the first record of a
+ * run, which is always a keyframe, so a reader can tell where a run appended to an existing
+ * recording begins. A present field is stored as the zig-zag varint of its
+ * difference from the previous record (from zero in a keyframe); fields that did not change
+ * are left out. The timestamp is stored relative to the previous one plus the interval, virtual
+ * memory as swap, and the wall-clock time as its offset from the timestamp, so a typical
+ * sample takes around ten bytes. Every RECORD_KEYFRAME_INTERVAL records a keyframe is written,
+ * from which decoding can start.
+ *
+ * @param interval The sampling interval of the recording.
+ * @param prev The previous record.
+ * @param records Number of records encoded or decoded.
+ * @param since_keyframe Records encoded since the last keyframe.
+ * @param run True if the record last decoded starts a run.
+ */
+typedef struct {
+    uint64_t interval;
+    SampleRecord prev;
+    long records;
+    long since_keyframe;
+    bool run;
+} Codec;
+
+/**
+ * @brief A recording opened for appending.
+ *
+ * @param fd The file, opened with O_APPEND.
+ * @param version Version of the recording; the records are written in its format.
+ * @param codec The packed stream, in packed recordings.
+ * @param wall_offset CLOCK_REALTIME minus CLOCK_MONOTONIC, in nanoseconds.
+ * @param records Number of records appended by this run.
+ */
+typedef struct {
+    int fd;
+    uint32_t version;
+    Codec codec;
+    int64_t wall_offset;
+    long records;
+} Recorder;
+
+/**
+ * @brief A recording mapped into memory for replay.
+ *
+ * The records are read in order with replayNext; replaySeek jumps to any record through
+ * the keyframes found when the recording was opened.
+ *
+ * @param map The mapping of the whole file.
+ * @param size Size of the mapping.
+ * @param header The header at the start of the mapping.
+ * @param data The first record, right after the header.
+ * @param end The end of the last complete record.
+ * @param pos The next record to read.
+ * @param codec The packed stream, in packed recordings.
+ * @param count Number of complete records.
+ * @param index Index of the next record to read.
+ * @param keyframes Offsets from `data` of the keyframes.
+ * @param keyframe_records Index of the record at each keyframe.
+ * @param nkeyframes Number of keyframes.
+ * @param run_start True if the record last read starts a run: the first record of the file, or
+ * the first of a run appended to it later. Besides the marker of packed records, a new run is
+ * told by its wall-clock offset, which each run fixes when it starts; that also covers raw
+ * recordings and runs appended by earlier versions.
+ * @param wall_offset Wall-clock time minus timestamp of the record last read.
+ */
+typedef struct {
+    void *map;
+    size_t size;
+    const RecordHeader *header;
+    const uint8_t *data;
+    const uint8_t *end;
+    const uint8_t *pos;
+    Codec codec;
+    long count;
+    long index;
+    size_t *keyframes;
+    long *keyframe_records;
+    long nkeyframes;
+    bool run_start;
+    int64_t wall_offset;
+} Replay;
+
+/**
+ * @brief One slot of the shared-memory ring, guarded by its own sequence counter (a seqlock).
+ *
+ * The writer makes `seq` odd, rewrites the record, then sets `seq` to 2 * (index + 1), where
+ * index is the sample number. A reader copies the record and keeps it only if `seq` was
+ * the expected even value both before and after the copy.
+ *
+ * @param seq The sequence counter.
+ * @param record The sample.
+ */
+typedef struct {
+    uint64_t seq;
+    SampleRecord record;
+} ShmSlot;
+
+/**
+ * @brief The shared-memory segment published by --daemon.
+ *
+ * @param magic SHM_MAGIC.
+ * @param version SHM_VERSION.
+ * @param capacity Number of slots in the ring.
+ * @param interval The sampling interval of the daemon in nanoseconds.
+ * @param pid Process id of the daemon.
+ * @param running 1 while the daemon is publishing, 0 once it has stopped.
+ * @param published Number of samples published; sample N is in slot N % capacity.
+ * @param slots The ring.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    uint64_t interval;
+    int32_t pid;
+    uint32_t running;
+    uint64_t published;
+    ShmSlot slots[];
+} ShmSegment;
+
+/**
+ * @brief The writing side of a shared-memory segment.
+ *
+ * @param name Name of the segment, as given to shm_open.
+ * @param fd The segment, locked with flock(LOCK_EX) for as long as the daemon runs.
+ * @param segment The mapped segment.
+ * @param size Size of the mapping.
+ * @param wall_offset CLOCK_REALTIME minus CLOCK_MONOTONIC, in nanoseconds.
+ */
+typedef struct {
+    const char *name;
+    int fd;
+    ShmSegment *segment;
+    size_t size;
+    int64_t wall_offset;
+} ShmPublisher;
+
+/**
+ * @brief The reading side of a shared-memory segment.
+ *
+ * @param fd The segment, to check the lock of the daemon.
+ * @param segment The mapped segment, read-only.
+ * @param size Size of the mapping.
+ * @param next Number of the next sample to read.
+ * @param dropped Samples that were overwritten before they could be read.
+ */
+typedef struct {
+    int fd;
+    const ShmSegment *segment;
+    size_t size;
+    uint64_t next;
+    uint64_t dropped;
+} ShmReader;
+
+/**
+ * @brief One connection to the metrics server.
+ *
+ * @param fd The connection.
+ * @param since When the connection was accepted (CLOCK_MONOTONIC, in nanoseconds).
+ * @param request Bytes of request read so far.
+ * @param matched Newlines seen in a row, to find the blank line that ends the request.
+ * @param out The part of the response still to send.
+ * @param left Length of `out`.
+ * @param copy The rest of the response, copied for a client that could not take it at once.
+ * @param prev The previous connection in the server's list.
+ * @param next The next connection in the server's list.
+ */
+typedef struct ServeClient {
+    int fd;
+    uint64_t since;
+    size_t request;
+    int matched;
+    const char *out;
+    size_t left;
+    char *copy;
+    struct ServeClient *prev;
+    struct ServeClient *next;
+} ServeClient;
+
+/**
+ * @brief A metrics server answering scrapes in the Prometheus text format.
+ *
+ * The whole HTTP response is rendered once per sample into `buf`; every scrape is answered
+ * by sending that buffer as it is.
+ *
+ * @param listen_fd The listening socket.
+ * @param epoll_fd The epoll instance the sockets are registered with.
+ * @param path Path of the Unix socket, removed on close, or NULL for TCP.
+ * @param buf The response buffer; the body starts at SERVE_HEADER_RESERVE.
+ * @param len End of the body in `buf`.
+ * @param cap Size of `buf`.
+ * @param response The response, i.e. the HTTP header written right before the body.
+ * @param response_len Length of the response.
+ * @param clients Open connections.
+ * @param active Number of open connections.
+ * @param peak Highest number of open connections.
+ * @param connections Connections accepted.
+ * @param scrapes Responses sent in full.
+ * @param expired Connections closed because they took too long.
+ * @param samples Number of responses rendered.
+ */
+typedef struct {
+    int listen_fd;
+    int epoll_fd;
+    char *path;
+    char *buf;
+    size_t len;
+    size_t cap;
+    char *response;
+    size_t response_len;
+    ServeClient *clients;
+    long active;
+    long peak;
+    long connections;
+    long scrapes;
+    long expired;
+    long samples;
+} Server;
+
+/**
+ * @brief One connection of the --bench=serve load test.
+ *
+ * @param fd The connection.
+ * @param start When the connection was opened.
+ * @param sent True once the request has been sent.
+ * @param ok True if the response started with a 200 status.
+ * @param received Bytes of response received.
+ */
+typedef struct {
+    int fd;
+    uint64_t start;
+    bool sent;
+    bool ok;
+    size_t received;
+} BenchScrape;
+
+/**
+ * @brief An entry of the open-addressing table that keeps the CPU ticks of every process
+ * between two scans.
+ *
+ * @param pid Process id, or 0 for an empty slot.
+ * @param starttime Start time of the process, so that a reused pid is not mistaken for it.
+ * @param ticks CPU time of the process at the scan, in clock ticks.
+ */
+typedef struct {
+    pid_t pid;
+    uint64_t starttime;
+    uint64_t ticks;
+} ProcTicks;
+
+/**
+ * @brief Scanner of /proc/[pid]/stat and statm that keeps the busiest processes.
+ *
+ * Files are opened with openat() relative to a /proc descriptor held open. On hosts with
+ * more than one CPU, a pool of threads waits at a barrier and shares the scan in batches
+ * once there are TOP_PARALLEL_MIN processes or more; the calling thread scans too. Per-process
+ * CPU usage comes from the ticks stored at the previous scan, keyed by pid and start time,
+ * and the busiest processes are picked with a min-heap of `shown` entries.
+ *
+ * @param proc_fd Descriptor of /proc.
+ * @param dir Directory stream listing /proc, on its own descriptor.
+ * @param procs The processes of the last scan.
+ * @param count Number of entries in `procs`.
+ * @param cap Allocated number of entries in `procs`.
+ * @param live Number of processes read successfully by the last scan.
+ * @param cursor Index of the next batch to scan.
+ * @param table Spare tick table, filled at the next scan.
+ * @param table_cap Number of slots in `table` (a power of two).
+ * @param previous Tick table of the previous scan.
+ * @param previous_cap Number of slots in `previous` (a power of two).
+ * @param heap Indexes into `procs` of the busiest processes, busiest first after a scan.
+ * @param shown Number of processes to keep.
+ * @param found Number of valid entries in `heap`.
+ * @param last Timestamp of the previous scan, in nanoseconds.
+ * @param clock_ticks Clock ticks per second.
+ * @param page_size Page size in bytes.
+ * @param threads Number of scan threads besides the caller.
+ * @param workers The scan threads.
+ * @param start Barrier the threads wait at for a scan.
+ * @param done Barrier the threads meet at when a scan is finished.
+ * @param gate Held while the pool is started.
+ * @param quit True when the threads should exit.
+ * @param scans Number of scans.
+ * @param scan_ns Duration of the last scan, in nanoseconds.
+ */
+typedef struct {
+    int proc_fd;
+    DIR *dir;
+    ProcSample *procs;
+    int count;
+    int cap;
+    int live;
+    int cursor;
+    ProcTicks *table;
+    size_t table_cap;
+    ProcTicks *previous;
+    size_t previous_cap;
+    int *heap;
+    int shown;
+    int found;
+    uint64_t last;
+    long clock_ticks;
+    long page_size;
+    int threads;
+    pthread_t workers[TOP_MAX_THREADS];
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    pthread_mutex_t gate;
+    bool quit;
+    long scans;
+    uint64_t scan_ns;
+} ProcTop;
+
+/**
+ * @brief Initial buffer size of the /proc/pressure and /proc/loadavg readers, and the default,
+ * shortest and longest window of a stall trigger in nanoseconds. Without CAP_SYS_RESOURCE the
+ * kernel only accepts windows that are a multiple of 2 s (and before Linux 6.5 no trigger at all).
+ */
+#define PROC_PRESSURE_SIZE 256
+#define PSI_TRIGGER_WINDOW 2000000000ULL
+#define PSI_WINDOW_MIN 500000000ULL
+#define PSI_WINDOW_MAX 10000000000ULL
+
+/**
+ * @brief The resources that report pressure stall information.
+ */
+typedef enum {
+    PRESSURE_CPU,
+    PRESSURE_MEMORY,
+    PRESSURE_IO,
+    PRESSURE_RESOURCES
+} PressureResource;
+
+/**
+ * @brief Pressure of one resource at the last sample.
+ *
+ * @param some Time at least one task was stalled on the resource.
+ * @param full Time all non-idle tasks were stalled at once.
+ * @param some_delta Growth of `some.total` since the previous sample, in microseconds.
+ * @param full_delta Growth of `full.total` since the previous sample, in microseconds.
+ * @param has_full True if the kernel reports a "full" line for the resource.
+ */
+typedef struct {
+    PressureLine some;
+    PressureLine full;
+    uint64_t some_delta;
+    uint64_t full_delta;
+    bool has_full;
+} PressureStat;
+
+/**
+ * @brief Collector of pressure stall information and of the load averages.
+ *
+ * The pressure files and /proc/loadavg are held open and re-read in place. When stall
+ * triggers are set, each resource gets its own descriptor, which the kernel marks with
+ * POLLPRI when the stall threshold is crossed within the window.
+ *
+ * @param files The /proc/pressure readers, one per resource.
+ * @param loadavg The /proc/loadavg reader.
+ * @param available True if the kernel reports pressure stall information.
+ * @param stats Pressure of each resource at the last sample.
+ * @param load Load averages at the last sample.
+ * @param timestamp CLOCK_MONOTONIC time of the last sample, in nanoseconds.
+ * @param elapsed Time between the last two samples, in nanoseconds.
+ * @param samples Number of samples taken.
+ * @param triggers Trigger descriptor of each resource, or -1.
+ * @param triggered Number of samples taken because a trigger fired.
+ */
+typedef struct {
+    ProcFile files[PRESSURE_RESOURCES];
+    ProcFile loadavg;
+    bool available;
+    PressureStat stats[PRESSURE_RESOURCES];
+    LoadAvg load;
+    uint64_t timestamp;
+    uint64_t elapsed;
+    long samples;
+    int triggers[PRESSURE_RESOURCES];
+    long triggered;
+} Pressure;
+
+/**
+ * @brief Rates of one block device between the last two samples.
+ *
+ * @param read_iops Reads completed per second.
+ * @param write_iops Writes completed per second.
+ * @param read_bytes Bytes read per second.
+ * @param write_bytes Bytes written per second.
+ * @param await Mean time an I/O took, queueing included, in milliseconds.
+ * @param busy Share of the interval the device had I/O in flight, in percent.
+ */
+typedef struct {
+    double read_iops;
+    double write_iops;
+    double read_bytes;
+    double write_bytes;
+    double await;
+    double busy;
+} DiskRates;
+
+/**
+ * @brief Collector of the block devices in /proc/diskstats.
+ *
+ * Every line of the file is kept, so that partitions, loop and ram devices never crowd out a
+ * disk; they are only skipped when printed. Whether a device is a whole disk is looked up in
+ * /sys/block once, when it first appears. The arrays are sized from the file and only
+ * reallocated when it gains lines.
+ *
+ * @param file The /proc/diskstats reader.
+ * @param current Counters of the last sample.
+ * @param previous Counters of the sample before.
+ * @param count Number of entries in `current`.
+ * @param previous_count Number of entries in `previous`.
+ * @param whole True for the entries of `current` that are whole disks.
+ * @param previous_whole The same for the entries of `previous`.
+ * @param rates Rates of the entries of `current`; zero for a device seen for the first time.
+ * @param cap Number of entries allocated in each array.
+ * @param samples Number of samples taken.
+ */
+typedef struct {
+    ProcFile file;
+    DiskCounters *current;
+    DiskCounters *previous;
+    int count;
+    int previous_count;
+    bool *whole;
+    bool *previous_whole;
+    DiskRates *rates;
+    int cap;
+    long samples;
+} DiskStats;
+
+/**
+ * @brief Rates of one network interface between the last two samples.
+ *
+ * @param rx_bytes Bytes received per second.
+ * @param rx_packets Packets received per second.
+ * @param tx_bytes Bytes sent per second.
+ * @param tx_packets Packets sent per second.
+ */
+typedef struct {
+    double rx_bytes;
+    double rx_packets;
+    double tx_bytes;
+    double tx_packets;
+} NetRates;
+
+/**
+ * @brief Collector of the network interfaces in /proc/net/dev.
+ *
+ * Like DiskStats, the arrays are sized from the file, so hosts with hundreds of veth
+ * interfaces keep all of them.
+ *
+ * @param file The /proc/net/dev reader.
+ * @param current Counters of the last sample.
+ * @param previous Counters of the sample before.
+ * @param count Number of entries in `current`.
+ * @param previous_count Number of entries in `previous`.
+ * @param rates Rates of the entries of `current`; zero for an interface seen for the first time.
+ * @param cap Number of entries allocated in each array.
+ * @param samples Number of samples taken.
+ */
+typedef struct {
+    ProcFile file;
+    NetCounters *current;
+    NetCounters *previous;
+    int count;
+    int previous_count;
+    NetRates *rates;
+    int cap;
+    long samples;
+} NetStats;
+
+/**
+ * @brief The files of one cgroup v2 directory that --cgroup reads.
+ */
+typedef enum {
+    CGROUP_MEMORY_CURRENT,
+    CGROUP_MEMORY_MAX,
+    CGROUP_MEMORY_STAT,
+    CGROUP_CPU_STAT,
+    CGROUP_CPU_MAX,
+    CGROUP_FILES
+} CgroupFile;
+
+/**
+ * @brief The counters of one cgroup at one sample.
+ *
+ * @param memory Memory charged to the cgroup, in bytes (memory.current).
+ * @param memory_max Memory limit in bytes, or CGROUP_UNLIMITED (memory.max).
+ * @param anon Anonymous memory, in bytes (anon in memory.stat).
+ * @param file Page cache, in bytes (file in memory.stat).
+ * @param inactive_file Page cache the kernel can reclaim first, in bytes (inactive_file in memory.stat).
+ * @param usage CPU time used, in microseconds (usage_usec in cpu.stat).
+ * @param periods Enforcement periods that have elapsed (nr_periods in cpu.stat).
+ * @param throttled_periods Periods in which the cgroup was throttled (nr_throttled in cpu.stat).
+ * @param throttled Time the cgroup was throttled, in microseconds (throttled_usec in cpu.stat).
+ * @param quota CPU time allowed per period in microseconds, or CGROUP_UNLIMITED (cpu.max).
+ * @param period Length of a period in microseconds (cpu.max).
+ */
+typedef struct {
+    uint64_t memory;
+    uint64_t memory_max;
+    uint64_t anon;
+    uint64_t file;
+    uint64_t inactive_file;
+    uint64_t usage;
+    uint64_t periods;
+    uint64_t throttled_periods;
+    uint64_t throttled;
+    uint64_t quota;
+    uint64_t period;
+} CgroupCounters;
+
+/**
+ * @brief One cgroup watched by --cgroup, with its files held open.
+ *
+ * Controllers that are not enabled in the cgroup leave their files closed; their counters stay 0.
+ *
+ * @param path Path of the cgroup below the cgroup2 mount, as shown.
+ * @param files The readers of the files, indexed by CgroupFile.
+ * @param current Counters of the last sample.
+ * @param previous Counters of the sample before.
+ * @param cpu_usage CPU used between the last two samples, in percent of one CPU.
+ * @param throttled_ms Time throttled between the last two samples, in milliseconds.
+ * @param throttled_share Share of the periods between the last two samples that were throttled, in percent.
+ */
+typedef struct {
+    char path[CGROUP_PATH_LEN];
+    ProcFile files[CGROUP_FILES];
+    CgroupCounters current;
+    CgroupCounters previous;
+    double cpu_usage;
+    double throttled_ms;
+    double throttled_share;
+} Cgroup;
+
+/**
+ * @brief Collector of the memory and CPU of one or more cgroup v2 directories.
+ *
+ * @param groups The watched cgroups.
+ * @param count Number of entries in `groups`.
+ * @param samples Number of samples taken.
+ */
+typedef struct {
+    Cgroup *groups;
+    int count;
+    long samples;
+} CgroupStats;
+
+/**
+ * @brief The stages of a sample that the monitor times on itself.
+ *
+ * The first three match CollectorKind. STAGE_ENGINE is the whole engine sample as the loop
+ * waits for it, STAGE_RENDER the drawing or writing of one frame.
+ */
+typedef enum {
+    STAGE_MEMORY,
+    STAGE_USER,
+    STAGE_CPU,
+    STAGE_ENGINE,
+    STAGE_RENDER,
+    STAGE_COUNT
+} SelfStage;
+
+/**
+ * @brief What the monitor costs: the latency of every stage, and its own CPU time.
+ *
+ * CPU time is that of the process and its threads, of the children it has reaped (the
+ * collectors of ENGINE_FORK) and of the persistent worker processes, as they report it.
+ *
+ * @param stages Latency of every stage, in nanoseconds, indexed by SelfStage.
+ * @param cpu CPU time used by the monitor from one sample to the next, in nanoseconds.
+ * @param start CLOCK_MONOTONIC time the monitor started, in nanoseconds.
+ * @param cpu_start CPU time used when the monitor started, in nanoseconds.
+ * @param cpu_last CPU time used at the last sample, in nanoseconds.
+ * @param samples Number of samples recorded.
+ */
+typedef struct {
+    Histogram stages[STAGE_COUNT];
+    Histogram cpu;
+    uint64_t start;
+    uint64_t cpu_start;
+    uint64_t cpu_last;
+    long samples;
+} SelfStats;
+
+/**
+ * @brief When --adaptive speeds up: a CPU usage change of ADAPTIVE_CPU_STEP points or a
+ * memory change of ADAPTIVE_MEMORY_STEP GB between samples, or CPU usage at or above
+ * ADAPTIVE_CPU_HIGH percent. Below a quarter of both steps the host is steady and the
+ * interval doubles.
+ */
+#define ADAPTIVE_CPU_STEP 10.0
+#define ADAPTIVE_MEMORY_STEP 0.1
+#define ADAPTIVE_CPU_HIGH 90.0
+
+/**
+ * @brief The state of --adaptive: the interval moves between `min` and `max` with the signal.
+ *
+ * @param min Shortest interval, taken as soon as the signal moves, in nanoseconds.
+ * @param max Longest interval, reached by doubling while the host is steady, in nanoseconds.
+ * @param interval Current interval in nanoseconds.
+ * @param last_cpu CPU usage of the previous sample, in percent.
+ * @param samples Number of samples seen.
+ * @param first Timestamp of the first sample.
+ * @param last Timestamp of the newest sample.
+ * @param fast Number of samples after which the interval was `min`.
+ * @param changes Number of times the interval changed.
+ */
+typedef struct {
+    uint64_t min;
+    uint64_t max;
+    uint64_t interval;
+    double last_cpu;
+    long samples;
+    uint64_t first;
+    uint64_t last;
+    long fast;
+    long changes;
+} Adaptive;
+
+/**
+ * @brief Limits and tuning of the --alert rules.
+ *
+ * ALERT_EWMA_ALPHA is the weight of the newest sample in the running mean and variance,
+ * a spike rule only fires once ALERT_WARMUP samples have shaped them, a threshold rule holds
+ * for ALERT_DEFAULT_SAMPLES samples unless the rule says otherwise, and a threshold rule only
+ * resolves once the value is back by ALERT_HYSTERESIS of the threshold.
+ */
+#define ALERT_MAX_RULES 16
+#define ALERT_SPEC_LEN 64
+#define ALERT_EWMA_ALPHA 0.1
+#define ALERT_WARMUP 10
+#define ALERT_DEFAULT_SAMPLES 3
+#define ALERT_HYSTERESIS 0.05
+#define ALERT_LINE_MAX 512
+
+/**
+ * @brief The sampled values an alert rule can watch.
+ */
+typedef enum {
+    METRIC_CPU,
+    METRIC_MEMORY,
+    METRIC_AVAILABLE,
+    METRIC_SESSIONS,
+    METRIC_COUNT
+} AlertMetric;
+
+/**
+ * @brief What makes an alert rule fire: a sustained threshold either way, or a z-score spike.
+ */
+typedef enum {
+    ALERT_ABOVE,
+    ALERT_BELOW,
+    ALERT_SPIKE
+} AlertKind;
+
+/**
+ * @brief One --alert rule and its streaming state, which is O(1) whatever the history length.
+ *
+ * @param spec The rule as given on the command line.
+ * @param metric The value watched.
+ * @param kind What makes the rule fire.
+ * @param threshold The threshold, or the z-score of a spike.
+ * @param samples Consecutive samples a threshold must hold for to fire, and to resolve.
+ * @param mean EWMA of the value.
+ * @param variance EWMA variance of the value.
+ * @param seen Number of samples evaluated.
+ * @param streak Consecutive samples that point the other way from the current state.
+ * @param firing True while the alert is raised.
+ * @param fired Number of times the alert was raised.
+ */
+typedef struct {
+    char spec[ALERT_SPEC_LEN];
+    AlertMetric metric;
+    AlertKind kind;
+    double threshold;
+    int samples;
+    double mean;
+    double variance;
+    long seen;
+    int streak;
+    bool firing;
+    long fired;
+} AlertRule;
+
+/**
+ * @brief The --alert rules and where their lines go.
+ *
+ * @param rules The rules.
+ * @param count Number of rules.
+ * @param fd Datagram socket for --alert-to=unix:PATH, or -1 to write to stderr.
+ * @param addr Address of the listening socket.
+ * @param addr_len Length of `addr`.
+ * @param wall_offset CLOCK_REALTIME minus CLOCK_MONOTONIC, in nanoseconds.
+ * @param sent Number of alert lines sent.
+ * @param dropped Number of alert lines the socket did not take (no listener, or its queue full).
+ */
+typedef struct {
+    AlertRule rules[ALERT_MAX_RULES];
+    int count;
+    int fd;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int64_t wall_offset;
+    long sent;
+    long dropped;
+} Alerts;
+
+/**
+ * @brief Command-line options of the program.
+ *
+ * @param samples Number of samples to take, or 0 to sample until interrupted.
+ * @param interval Time between samples in nanoseconds.
+ * @param seq True for sequential output.
+ * @param sys True to show system (memory and CPU) information.
+ * @param user True to show user session information.
+ * @param graph True to draw the memory and CPU graphics.
+ * @param engine The sampling engine to use.
+ * @param format The output format.
+ * @param record Path of the recording to append samples to, or NULL.
+ * @param replay Path of a recording to replay instead of sampling, or NULL.
+ * @param replay_from Index of the first sample of the recording to show.
+ * @param per_core Number of hottest cores to list in the per-core view, or 0 to hide the view.
+ * @param bench Name of the benchmark to run instead of printing statistics, or NULL.
+ * @param resolution The rollup tier to draw, or -1 to draw the individual samples.
+ * @param daemon Name of the shared-memory segment to publish samples to, or NULL.
+ * @param attach Name of the shared-memory segment to display instead of sampling, or NULL.
+ * @param serve Address to serve metrics on ("unix:PATH" or "tcp:PORT"), or NULL.
+ * @param top Number of busiest processes to list, or 0 to hide the process view.
+ * @param available True to show and graph available memory instead of total minus free.
+ * @param pressure True to show pressure stall information and the load averages.
+ * @param psi_trigger Stall time per window that wakes the sampler early, in nanoseconds, or 0.
+ * @param psi_window Window the stall time of --psi-trigger is measured over, in nanoseconds.
+ * @param disk True to show the throughput of the block devices.
+ * @param net True to show the throughput of the network interfaces.
+ * @param cgroup Comma-separated cgroup paths to show, "" for the cgroup of the process, or NULL.
+ * @param self_stats True to print the cost of every stage and the CPU used by the monitor at exit.
+ * @param proc_root Directory laid out like / that every collector reads instead of the live system, or NULL.
+ * @param capture Directory to copy the files read by the collectors into instead of sampling, or NULL.
+ * @param synth_cores Number of cores to rewrite a capture for, or 0 to keep the captured ones.
+ * @param synth_sessions Number of sessions to rewrite a capture for, or 0 to keep the captured ones.
+ * @param adaptive_min Shortest interval of --adaptive in nanoseconds.
+ * @param adaptive_max Longest interval of --adaptive in nanoseconds, or 0 for a fixed interval.
+ * @param alerts The --alert rules, as given.
+ * @param alert_count Number of --alert rules.
+ * @param alert_to Where alert lines go: NULL for stderr, or "unix:PATH".
+ */
+typedef struct {
+    int samples;
+    uint64_t interval;
+    bool seq;
+    bool sys;
+    bool user;
+    bool graph;
+    EngineMode engine;
+    OutputFormat format;
+    const char *record;
+    const char *replay;
+    long replay_from;
+    int per_core;
+    const char *bench;
+    int resolution;
+    const char *daemon;
+    const char *attach;
+    const char *serve;
+    int top;
+    bool available;
+    bool pressure;
+    uint64_t psi_trigger;
+    uint64_t psi_window;
+    bool disk;
+    bool net;
+    const char *cgroup;
+    bool self_stats;
+    const char *proc_root;
+    const char *capture;
+    int synth_cores;
+    int synth_sessions;
+    uint64_t adaptive_min;
+    uint64_t adaptive_max;
+    const char *alerts[ALERT_MAX_RULES];
+    int alert_count;
+    const char *alert_to;
+} Options;
+
+struct Display;
+
+/**
+ * @brief The hooks of a collector shown by the display.
+ *
+ * Memory, users and CPU are read by the sample engine, in its workers, and carried by every
+ * record; their entries have no state and no `sample` hook, and only render from the display.
+ * Every other collector runs in the sampling loop next to the engine and is sampled with the
+ * timestamp of the engine's sample, so that all rates cover the same interval. `delta` is
+ * called from the second sample on, with the time since the previous one; `wake` and `watch`
+ * are only set by collectors that can ask for a sample between two ticks.
+ *
+ * @param name Name of the collector.
+ * @param option The command-line option that enables it.
+ * @param size Size of the collector's state, or 0.
+ * @param enabled Returns true if the options ask for the collector.
+ * @param init Initialises the state; returns 0, or -1 with errno set. NULL without state.
+ * @param sample Reads the raw counters; returns 0, or -1 with errno set. NULL for the engine's collectors.
+ * @param delta Turns the last two readings into rates over `elapsed` nanoseconds, or NULL.
+ * @param render Adds the collector's section to the frame of the display.
+ * @param close Releases the state, or NULL.
+ * @param watch Stores up to `cap` descriptors that signal with EPOLLPRI and returns their number, or NULL.
+ * @param wake Returns true if the event on `fd` asks for a sample now, or NULL.
+ */
+typedef struct {
+    const char *name;
+    const char *option;
+    size_t size;
+    bool (*enabled)(const Options *opts);
+    int (*init)(void *state, const Options *opts);
+    int (*sample)(void *state, uint64_t timestamp);
+    void (*delta)(void *state, uint64_t elapsed);
+    void (*render)(Frame *frame, const void *state, const struct Display *display);
+    void (*close)(void *state);
+    int (*watch)(const void *state, int *fds, int cap);
+    bool (*wake)(void *state, int fd);
+} CollectorOps;
+
+/**
+ * @brief An enabled collector and its state.
+ *
+ * @param ops The collector's hooks.
+ * @param state The collector's state, allocated with `ops->size` bytes.
+ * @param last Timestamp of the previous sample, in nanoseconds.
+ * @param samples Number of samples taken.
+ * @param latency Time each sample and delta took, in nanoseconds.
+ */
+typedef struct {
+    const CollectorOps *ops;
+    void *state;
+    uint64_t last;
+    long samples;
+    Histogram latency;
+} Collector;
+
+/**
+ * @brief The collectors enabled for one run, in the order they are shown.
+ *
+ * @param collectors The enabled collectors.
+ * @param count Number of entries in `collectors`.
+ */
+typedef struct {
+    Collector collectors[COLLECTORS_MAX];
+    int count;
+} CollectorSet;
+
+/**
+ * @brief State of the live display that changes with signals and key presses.
+ *
+ * The sampling loop reads signals from a signalfd and keys from the terminal, and turns them
+ * into these flags; nothing runs in a signal handler and sampling never waits for an answer.
+ *
+ * @param interactive True when keys are read from the terminal, so the quit prompt can be answered.
+ * @param paused True while sampling is paused.
+ * @param confirming True while the quit prompt is shown.
+ * @param quit True once the loop should stop.
+ * @param redraw True when the frame must be drawn again without a new sample.
+ * @param relayout True when the terminal was resized and the screen must be redrawn in full.
+ * @param retimed True when the sampling interval changed or sampling resumed.
+ * @param interval The sampling interval in nanoseconds.
+ */
+typedef struct {
+    bool interactive;
+    bool paused;
+    bool confirming;
+    bool quit;
+    bool redraw;
+    bool relayout;
+    bool retimed;
+    uint64_t interval;
+} Controls;
+
+/**
+ * @brief Everything that happens to a sample after it has been collected.
+ *
+ * The display keeps the history and the CPU counters needed to turn raw samples into usage,
+ * and sends each sample either to the interactive frame or to the record writer, depending
+ * on the output format. Live sampling and replay both go through it.
+ *
+ * @param opts The options the display was created with.
+ * @param history The sample history.
+ * @param rollups The rollup tiers, fed from the same samples.
+ * @param window Number of memory rows reserved on screen.
+ * @param frame The terminal frame, in FORMAT_TEXT.
+ * @param writer The record writer, in FORMAT_JSONL and FORMAT_CSV.
+ * @param current The newest sample.
+ * @param cpu_previous Previous aggregate non-idle CPU time.
+ * @param cpu_idle Previous aggregate idle CPU time.
+ * @param cores Number of cores of the newest sample.
+ * @param sessions Number of user sessions of the newest sample.
+ * @param ncores Number of per-core entries in `cores_usage`.
+ * @param cores_previous Per-core counters of the previous sample.
+ * @param cores_usage Per-core utilization of the newest sample.
+ * @param every The sampling interval, formatted for display.
+ * @param collectors The collectors of the registry whose sections are shown, or NULL.
+ * @param set The samples of the frame being rendered.
+ */
+typedef struct Display {
+    const Options *opts;
+    History history;
+    Rollups rollups;
+    int window;
+    Frame frame;
+    RecordWriter writer;
+    HistorySample current;
+    long int cpu_previous;
+    long int cpu_idle;
+    int cores;
+    int sessions;
+    int ncores;
+    CPU cores_previous[MAX_CORES];
+    double cores_usage[MAX_CORES];
+    char every[32];
+    const CollectorSet *collectors;
+    const SampleSet *set;
+} Display;
+
+/**
+ * @brief Formats the memory row of one history sample.
+ *
+ * The row holds used (or available) and total physical memory, and used and total virtual
+ * memory. If graph mode is enabled, the graphical representation of the change since the
+ * previous sample is appended.
+ *
+ * @param sample The history sample to format.
+ * @param graph Boolean flag indicating if graphical mode is enabled.
+ * @param available True to show available memory instead of total minus free.
+ * @param row Buffer receiving the row, including its trailing newline.
+ * @param len Size of `row`.
+ * @return void
+ */
+void formatMemoryRow(const HistorySample *sample, bool graph, bool available, char *row, size_t len);
+
+/**
+ * @brief Returns the physical memory figure shown and graphed by the display.
+ *
+ * @param memory The memory statistics.
+ * @param available True for available memory, false for total minus free.
+ * @return The figure in GB.
+ */
+double memoryShown(const MemoryInfo *memory, bool available);
+
+/**
+ * @brief Monitors and prints memory usage information.
+ * 
+ * This function retrieves current process memory usage and adds it to the frame, followed by one memory
+ * row per sample kept in the history. Rows are formatted from the numeric samples only when
+ * they are printed. If graph mode is enabled, each row also carries a graphical representation
+ * of the change in memory usage. In sequential mode only the newest row is printed and older
+ * rows are left blank. Empty lines pad the section to `window` rows so that the layout of the
+ * screen stays the same while the history fills up. When the newest sample carries the
+ * /proc/meminfo breakdown, it is printed below the rows.
+ *
+ * @param frame The frame the section is added to.
+ * @param history The sample history; its newest sample is the current one.
+ * @param window Number of rows reserved for the section, at least the history capacity.
+ * @param graph Boolean flag indicating if graphical mode is enabled. In graphical mode, a visual representation of memory usage changes is appended.
+ * @param seq Boolean flag indicating if sequential mode is enabled. In sequential mode, only the current iteration's memory usage information is printed.
+ * @param available True to show and graph available memory instead of total minus free.
+ * @return void
+ */
+void memoryUsage(Frame *frame, const History *history, int window, bool graph, bool seq, bool available);
+
+/**
+ * @brief Retrieves memory statistics and writes them to a pipe.
+ * 
+ * This function gathers memory statistics using sysinfo, populates a MemoryInfo struct
+ * with total and used memory (physical and virtual), and writes this information to the
+ * specified pipe. If an error occurs during retrieval or writing, the process and its
+ * parent are terminated.
+ *
+ * @param pipe An array of two integers representing the read and write ends of a pipe.
+ * @return void
+ */
+void memoryStats(int pipe[2]);
+
+/**
+ * @brief Appends a graphical representation of memory usage change to a row.
+ * 
+ * This function creates a visual representation of the change in memory usage since the previous sample
+ * and appends it to the memory usage string in `row`.
+ * The visual representation includes a line of characters indicating the magnitude of the change, followed by a special
+ * character representing the direction of the change (increase, decrease, or no change). Additionally, the function
+ * formats and appends textual information about the absolute difference in memory usage and the current memory usage.
+ *
+ * @param memory_current The current memory usage measurement.
+ * @param memory_delta The change in memory usage since the previous sample, as stored in the history.
+ * @param row A NUL-terminated row holding the memory usage information to append to.
+ * @param len The size of the `row` buffer. The graphic is cut short rather than overflowing it.
+ */
+void appendMemoryGraphicToTail(double memory_current, double memory_delta, char *row, size_t len);
+
+/**
+ * @brief Reads login records from the utmp file and writes them to a pipe.
+ * 
+ * This function sets the path to the utmp file to read login records and iterates
+ * through each record. For each user process found (indicating an active user session),
+ * it formats a string containing the username, session ID, and host, and writes this
+ * string to the specified pipe. If any step fails, it outputs an error message and
+ * terminates the current process as well as its parent process.
+ *
+ * @param pipe An array of two integers representing the read and write ends of a pipe.
+ * @return void
+ */
+void userOutput(int pipe[2]);
+
+/**
+ * @brief Retrieves CPU usage statistics and writes them to a pipe.
+ * 
+ * This function opens and reads from the "/proc/stat" file to gather CPU statistics,
+ * including time spent in different modes (user, nice, system, idle, iowait, irq,
+ * softirq), for the whole machine and for every core. It calculates total CPU time and
+ * idle time, encapsulates these values in a CpuSample structure, and writes the used
+ * part of the structure (see CPU_SAMPLE_SIZE) to the specified pipe. If an error occurs
+ * during any step of the process, it outputs an error message and terminates both the
+ * current and parent processes to prevent further execution.
+ *
+ * @param pipe An array of two integers representing the read and write ends of a pipe.
+ * @return void
+ */
+void cpuStats(int pipefd[2]);
+
+/**
+ * @brief Computes the CPU usage since the previous sample.
+ *
+ * The usage is based on the difference in total and idle CPU times since the last measurement.
+ *
+ * @param info A structure containing the current total and idle CPU times.
+ * @param cpu_previous Pointer to a long integer tracking the previous total CPU time. This value is updated with the current total
+ *                     CPU time after calculating the current CPU usage.
+ * @param time_previous Pointer to a long integer tracking the previous idle CPU time. This value is updated with the current idle
+ *                      CPU time after calculating the current CPU usage.
+ * @return The CPU usage in percent.
+ */
+double cpuUsage(CPU info, long int* cpu_previous, long int* time_previous);
+
+/**
+ * @brief Prints CPU usage information and, optionally, the CPU usage history as graphics.
+ * 
+ * This function prints general CPU information, including the number of cores and the CPU usage
+ * percentage of the newest history sample. If graphical output is enabled, it also calls
+ * `appendAndPrintCpuGraphics` to print one graphical row per sample kept in the history.
+ *
+ * @param frame The frame the section is added to.
+ * @param graphics Boolean flag indicating if graphical representation is enabled.
+ * @param history The sample history; its newest sample is the current one.
+ * @param cores The number of cores to print.
+ */
+void cpu_output(Frame *frame, bool graphics, const History *history, int cores);
+
+/**
+ * @brief Prints one compact bar per core, followed by the hottest cores.
+ *
+ * The bars are laid out in columns so that a 128-core machine fits on one screen. The hottest
+ * cores are chosen with a bounded insertion into a small array rather than a full sort.
+ *
+ * @param frame The frame the section is added to.
+ * @param usage Utilization of each core in percent, as computed by `coreUsage`.
+ * @param ncores Number of cores.
+ * @param hottest Number of hottest cores to list.
+ * @return void
+ */
+void perCoreOutput(Frame *frame, const double *usage, int ncores, int hottest);
+
+/**
+ * @brief Formats the graphical representation of one CPU usage value.
+ *
+ * The representation is a series of bars corresponding to the usage percentage, followed by the percentage.
+ *
+ * @param usage The CPU usage percentage to be graphically represented.
+ * @param row Buffer receiving the row, without a trailing newline.
+ * @param len Size of `row`.
+ * @return void
+ */
+void formatCpuRow(double usage, char *row, size_t len);
+
+/**
+ * @brief Prints the graphical representation of every CPU usage sample kept in the history.
+ *
+ * Rows are formatted with `formatCpuRow` as they are printed, effectively displaying the CPU usage history.
+ *
+ * @param frame The frame the rows are added to.
+ * @param history The sample history.
+ */
+void appendAndPrintCpuGraphics(Frame *frame, const History *history);
+
+/**
+ * @brief Prints operating system information.
+ * 
+ * Retrieves information about the operating system using the uname function and prints
+ * the system name, machine name, version, release, and architecture to the standard output.
+ * Under --proc-root the first four come from the captured /proc/sys/kernel files instead.
+ *
+ * @return void
+ */
+void getOSInfo();
+
+/**
+ * @brief Prints the system's uptime.
+ * 
+ * Reads the system's uptime from "/proc/uptime" (kept open between calls), calculates the total time in days, hours,
+ * minutes, and seconds format, and prints this information along with the total hours to the
+ * standard output.
+ *
+ * @return void
+ */
+void getUptime();
+
+/**
+ * @brief Prints system information and uptime.
+ * 
+ * A convenience function that prints a divider followed by calling `getOSInfo` to print
+ * operating system details, and `getUptime` to print the system uptime.
+ *
+ * @return void
+ */
+void systemInfo();
+
+/**
+ * @brief Applies a signal read from the signalfd of the sampling loop to the controls.
+ *
+ * SIGINT (Ctrl+C) shows the quit prompt when the display is interactive, and stops the loop
+ * otherwise. SIGTERM stops the loop. SIGTSTP (Ctrl+Z) pauses or resumes sampling instead of
+ * suspending the process. SIGWINCH asks for the screen to be redrawn in full.
+ *
+ * @param controls The controls of the loop.
+ * @param sig The signal number of the received signal.
+ * @return void
+ */
+void handleSignal(Controls *controls, int sig);
+
+/**
+ * @brief Applies a key pressed on the terminal to the controls.
+ *
+ * While the quit prompt is shown, 'y' or 'Y' stops the loop and any other key dismisses the
+ * prompt. Otherwise 'q' shows the prompt, 'p' or space pauses or resumes sampling, '+' doubles
+ * and '-' halves the sampling interval, within INTERVAL_MIN and INTERVAL_MAX.
+ *
+ * @param controls The controls of the loop.
+ * @param key The key.
+ * @return void
+ */
+void handleKey(Controls *controls, char key);
+
+/**
+ * @brief Checks if a string represents an integer.
+ * 
+ * Validates whether a given string consists solely of digit characters, potentially
+ * preceded by a sign (+/-), thus representing a valid integer.
+ *
+ * @param str Pointer to the string to be checked.
+ * @return Returns true if the string represents an integer, false otherwise.
+ */
+bool isInteger(const char *str);
+
+/**
+ * @brief Parses command-line arguments to configure application parameters.
+ * 
+ * This function interprets the command-line arguments provided to the application,
+ * setting the appropriate parameters for sample size, delay, and various boolean flags
+ * indicating the operational modes (system, user, sequential, and graphics). If no mode
+ * is explicitly selected, it defaults to both user and system modes enabled. It supports
+ * arguments in both '--key=value' and positional formats. Positional numeric arguments
+ * are interpreted as 'samples' and 'delay' if not preceded by a flag, in that order.
+ * `--record=FILE` appends every sample to a binary recording, `--replay=FILE` shows a
+ * recording instead of sampling and `--from=N` starts it at sample N, `--format=text|jsonl|csv` selects the output format, `--tdelay` accepts a unit suffix (s, ms, us or ns; seconds if none),
+ * `--serve=unix:PATH|tcp:PORT` serves the samples as Prometheus metrics, `--daemon[=NAME]` publishes the samples to shared memory instead of displaying them,
+ * `--attach[=NAME]` displays the samples of a daemon, `--resolution=1s|10s|1m|10m` draws a rollup tier instead of the samples,
+ * `--memory=used|available` picks the physical memory figure shown and graphed, `--per-core[=N]` adds the per-core view listing the N hottest cores (5 by default), `--top[=N]` adds the N busiest processes (10 by default),
+ * `--pressure` adds pressure stall information and the load averages, `--psi-trigger=DURATION[:WINDOW]` also samples whenever a resource stalls that long within WINDOW (2 s by default),
+ * `--disk` and `--net` add the throughput of the block devices and of the network interfaces,
+ * `--cgroup[=PATH,...]` adds the memory and CPU of cgroups against their limits (the cgroup of the process by default),
+ * `--self-stats` prints the latency of every stage and the CPU used by the monitor at exit,
+ * `--proc-root=DIR` reads every collector's files below DIR instead of the live system, `--capture=DIR` copies those files into DIR
+ * instead of sampling and `--synthesize=CORES:SESSIONS` rewrites the capture for that many cores and sessions,
+ * `--adaptive=MIN:MAX` moves the interval between MIN and MAX with how fast CPU usage and memory change,
+ * `--alert=RULE` (up to 16 times) raises and resolves alerts on cpu, memory, available or sessions and `--alert-to=unix:PATH` sends them to a socket instead of stderr,
+ * `--engine=fork|process|thread|inline` selects the sampling engine and `--bench[=engines|parse|codec|library|serve|top]`
+ * runs a benchmark instead of printing statistics.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv Array of pointers to the argument strings.
+ * @param opts Options to fill in; fields not named on the command line keep their value.
+ * @return Returns true if arguments are successfully parsed; otherwise, false.
+ */
+bool parseargument(int argc, char **argv, Options *opts);
+
+/**
+ * @brief Collects and prints system information based on the provided parameters.
+ * 
+ * This function starts the sampling engine chosen in the options and runs one epoll loop over a
+ * timerfd armed at the next sampling deadline, a signalfd for SIGINT, SIGTERM, SIGTSTP and
+ * SIGWINCH, and the terminal when standard input is one. With the persistent engines the
+ * collectors are started once and asked for a new sample over their pipes on every tick; with
+ * the fork engine new pipes and children are created for every sample. The gathered
+ * information is printed in a sequential manner or all at once, based on the 'seq' flag. It
+ * also handles graphical representation of the memory and CPU usage if the 'graph' flag is
+ * enabled. Samples are taken on a grid of absolute deadlines, so the time spent collecting and
+ * rendering does not stretch the interval; deadlines that pass while a sample is still in
+ * progress are counted as missed, and the interval statistics are printed at the end. The quit
+ * prompt, pausing, interval changes and terminal resizes are handled between ticks, so none of
+ * them blocks sampling.
+ *
+ * @param opts The parsed command-line options.
+ * @return void
+ */
+void printinfo(const Options *opts);
+
+/**
+ * @brief Prepares a record writer; CSV output starts with its header line.
+ *
+ * @param writer The writer to initialise.
+ * @param format FORMAT_JSONL or FORMAT_CSV.
+ * @param fd The file descriptor to write to.
+ * @return 0 on success, -1 if the buffer could not be allocated.
+ */
+int writerInit(RecordWriter *writer, OutputFormat format, int fd);
+
+/**
+ * @brief Formats one sample record into the batch buffer.
+ *
+ * The record holds the wall-clock and monotonic timestamps, the MemoryInfo fields, the CPU
+ * usage, the core count and the session count. The buffer is written out when it is nearly
+ * full or when its oldest record has waited OUTPUT_FLUSH_INTERVAL.
+ *
+ * @param writer The writer.
+ * @param sample The sample to write.
+ * @param cores Number of cores.
+ * @param sessions Number of user sessions.
+ * @return void
+ */
+void writerRecord(RecordWriter *writer, const HistorySample *sample, int cores, int sessions);
+
+/**
+ * @brief Writes the buffered records with one write() call.
+ *
+ * @param writer The writer.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int writerFlush(RecordWriter *writer);
+
+/**
+ * @brief Flushes the remaining records and frees the buffer.
+ *
+ * @param writer The writer.
+ * @return void
+ */
+void writerFree(RecordWriter *writer);
+
+/**
+ * @brief Counts the session lines of a sample.
+ *
+ * @param set The sample.
+ * @return The number of user sessions.
+ */
+int countSessions(const SampleSet *set);
+
+/**
+ * @brief Prepares the history and the frame or record writer of a display.
+ *
+ * @param display The display to initialise.
+ * @param opts The options; they must outlive the display.
+ * @param window Capacity of the history and number of memory rows reserved on screen.
+ * @return 0 on success, -1 if an allocation failed.
+ */
+int displayInit(Display *display, const Options *opts, int window);
+
+/**
+ * @brief Turns a collected sample into usage figures and appends it to the history.
+ *
+ * This is O(1) per sample (plus one pass over the cores in the per-core view), so it can be
+ * called for every sample even when only some of them are drawn.
+ *
+ * @param display The display.
+ * @param set The sample.
+ * @param cores Number of cores.
+ * @param sessions Number of user sessions.
+ * @return void
+ */
+void displayUpdate(Display *display, const SampleSet *set, int cores, int sessions);
+
+/**
+ * @brief Forgets the CPU counters of the previous sample, as at the start of a run.
+ *
+ * Used when a replay reaches a run appended to the recording, whose counters cannot be
+ * compared with those of the run before it.
+ *
+ * @param display The display.
+ * @return void
+ */
+void displayRestart(Display *display);
+
+/**
+ * @brief Shows the newest sample: draws and flushes a frame, or writes a record.
+ *
+ * @param display The display.
+ * @param set The sample, for the session lines; if it has none, the number of sessions is printed.
+ * @param title The first line of the frame, e.g. the sample count and interval.
+ * @return void
+ */
+void displayRender(Display *display, const SampleSet *set, const char *title);
+
+/**
+ * @brief Prints the renderer statistics, flushes pending records and frees the display.
+ *
+ * @param display The display.
+ * @return void
+ */
+void displayFree(Display *display);
+
+/**
+ * @brief Creates the shared-memory segment of a daemon.
+ *
+ * A segment left behind by a daemon that is no longer running is replaced. The daemon holds
+ * an exclusive flock on the segment until shmDestroy, which is how liveness is checked.
+ *
+ * @param pub The publisher to initialise.
+ * @param name Name of the segment, starting with '/'.
+ * @param interval The sampling interval, for the readers.
+ * @return 0 on success, -1 on error with errno set (EEXIST if another daemon uses the name).
+ */
+int shmCreate(ShmPublisher *pub, const char *name, uint64_t interval);
+
+/**
+ * @brief Publishes one sample to the ring of the segment.
+ *
+ * Only the slot of the sample is touched, so readers never wait for the writer.
+ *
+ * @param pub The publisher.
+ * @param set The sample.
+ * @param cores Number of cores.
+ * @param sessions Number of user sessions.
+ * @return void
+ */
+void shmPublish(ShmPublisher *pub, const SampleSet *set, int cores, int sessions);
+
+/**
+ * @brief Marks the segment as stopped, unmaps it and removes its name.
+ *
+ * @param pub The publisher.
+ * @return void
+ */
+void shmDestroy(ShmPublisher *pub);
+
+/**
+ * @brief Maps the segment of a daemon for reading.
+ *
+ * The first samples read are the ones still held in the ring.
+ *
+ * @param reader The reader to initialise.
+ * @param name Name of the segment.
+ * @return 0 on success, -1 on error with errno set (EINVAL if it is not a compatible segment).
+ */
+int shmAttach(ShmReader *reader, const char *name);
+
+/**
+ * @brief Reads the next published sample, without locking and without waiting for the writer.
+ *
+ * Samples overwritten before they could be read are skipped and counted in `dropped`.
+ *
+ * @param reader The reader.
+ * @param record Receives the sample.
+ * @return 1 if a sample was read, 0 if there is no new sample.
+ */
+int shmRead(ShmReader *reader, SampleRecord *record);
+
+/**
+ * @brief Tells whether the daemon of a segment is still publishing.
+ *
+ * @param reader The reader.
+ * @return false once the daemon has stopped, including when it was killed.
+ */
+bool shmAlive(const ShmReader *reader);
+
+/**
+ * @brief Unmaps the segment.
+ *
+ * @param reader The reader.
+ * @return void
+ */
+void shmDetach(ShmReader *reader);
+
+/**
+ * @brief Parses a server address: "unix:PATH" or "tcp:PORT" (on 127.0.0.1).
+ *
+ * @param spec The address.
+ * @param addr Receives the socket address.
+ * @param len Receives the length of the socket address.
+ * @return 0 on success, -1 if the address is not valid (errno EINVAL).
+ */
+int serveAddress(const char *spec, struct sockaddr_storage *addr, socklen_t *len);
+
+/**
+ * @brief Starts listening for scrapes and registers the socket with an epoll instance.
+ *
+ * The listening socket is registered with the server itself as its epoll tag. A Unix socket
+ * file left behind by an earlier run is replaced; a path that is not a socket, or a socket
+ * another server still listens on, fails with EADDRINUSE.
+ *
+ * @param server The server to initialise.
+ * @param spec The address, see serveAddress.
+ * @param epoll_fd The epoll instance.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int serverOpen(Server *server, const char *spec, int epoll_fd);
+
+/**
+ * @brief Renders the response served until the next sample.
+ *
+ * @param server The server.
+ * @param set The sample.
+ * @param cores Number of cores.
+ * @param sessions Number of user sessions.
+ * @param uptime Time since boot in seconds.
+ * @param cpu_usage CPU usage since the previous sample in percent.
+ * @return void
+ */
+void serverPublish(Server *server, const SampleSet *set, int cores, int sessions, double uptime, double cpu_usage);
+
+/**
+ * @brief Handles an epoll event of the server: new connections, or a request to answer.
+ *
+ * Requests are read up to their blank line and answered with the current response; the
+ * connection is closed once the response is sent.
+ *
+ * @param server The server.
+ * @param tag The epoll tag of the event: the server, or one of its connections.
+ * @param events The epoll events.
+ * @return void
+ */
+void serverEvent(Server *server, void *tag, uint32_t events);
+
+/**
+ * @brief Closes the connections that have been open for longer than SERVE_CLIENT_TIMEOUT.
+ *
+ * @param server The server.
+ * @param now The current CLOCK_MONOTONIC time in nanoseconds.
+ * @return void
+ */
+void serverExpire(Server *server, uint64_t now);
+
+/**
+ * @brief Closes every connection and the listening socket, and removes the Unix socket file.
+ *
+ * @param server The server.
+ * @return void
+ */
+void serverClose(Server *server);
+
+/**
+ * @brief Looks up a rollup tier by name.
+ *
+ * @param name "1s", "10s", "1m" or "10m".
+ * @return The tier index, or -1 if there is no such tier.
+ */
+int rollupTier(const char *name);
+
+/**
+ * @brief Returns the name of a rollup tier, as accepted by rollupTier.
+ *
+ * @param tier The tier index.
+ * @return The name.
+ */
+const char *rollupName(int tier);
+
+/**
+ * @brief Allocates the bucket rings of every rollup tier.
+ *
+ * @param rollups The tiers to initialise.
+ * @param capacity Number of buckets kept per tier.
+ * @return 0 on success, -1 if an allocation failed.
+ */
+int rollupInit(Rollups *rollups, int capacity);
+
+/**
+ * @brief Frees the bucket rings of every rollup tier.
+ *
+ * @param rollups The tiers.
+ * @return void
+ */
+void rollupFree(Rollups *rollups);
+
+/**
+ * @brief Adds a sample to the open bucket of every tier, opening a new bucket where the
+ * sample falls past the end of the open one.
+ *
+ * This is O(1) per tier: the bucket keeps running sums and extremes, and the history is
+ * never re-scanned.
+ *
+ * @param rollups The tiers.
+ * @param sample The sample.
+ * @return void
+ */
+void rollupAdd(Rollups *rollups, const HistorySample *sample);
+
+/**
+ * @brief Returns the newest (open) bucket of a tier.
+ *
+ * @param rollups The tiers.
+ * @param tier The tier index.
+ * @return The bucket, or NULL if no sample has been added yet.
+ */
+const RollupBucket *rollupLast(const Rollups *rollups, int tier);
+
+/**
+ * @brief Prints the min, mean, max and last values of the newest bucket of a tier.
+ *
+ * @param frame The frame to print into.
+ * @param rollups The tiers.
+ * @param tier The tier index.
+ * @return void
+ */
+void rollupOutput(Frame *frame, const Rollups *rollups, int tier);
+
+/**
+ * @brief Converts a sample into a recording record.
+ *
+ * @param set The sample; only the aggregate CPU counters are recorded.
+ * @param cores Number of cores.
+ * @param sessions Number of user sessions.
+ * @param wall_offset CLOCK_REALTIME minus CLOCK_MONOTONIC, in nanoseconds.
+ * @param record Receives the record.
+ * @return void
+ */
+void recordFromSample(const SampleSet *set, int cores, int sessions, int64_t wall_offset, SampleRecord *record);
+
+/**
+ * @brief Converts a recording record back into a sample.
+ *
+ * @param record The record.
+ * @param set Receives the timestamp, memory and aggregate CPU counters; no per-core counters.
+ * @return void
+ */
+void sampleFromRecord(const SampleRecord *record, SampleSet *set);
+
+/**
+ * @brief Writes an unsigned LEB128 varint.
+ *
+ * @param out Receives up to 10 bytes.
+ * @param value The value.
+ * @return Number of bytes written.
+ */
+size_t putVarint(uint8_t *out, uint64_t value);
+
+/**
+ * @brief Reads an unsigned LEB128 varint.
+ *
+ * @param p The first byte.
+ * @param end The end of the buffer.
+ * @param value Receives the value.
+ * @return The byte after the varint, or NULL if it is truncated or longer than 64 bits.
+ */
+const uint8_t *getVarint(const uint8_t *p, const uint8_t *end, uint64_t *value);
+
+/**
+ * @brief Maps a signed value to an unsigned one so that small magnitudes stay small
+ * (0, -1, 1, -2 become 0, 1, 2, 3).
+ *
+ * @param value The signed value.
+ * @return The zig-zag encoding.
+ */
+uint64_t zigzag(int64_t value);
+
+/**
+ * @brief Reverses zigzag().
+ *
+ * @param value The zig-zag encoding.
+ * @return The signed value.
+ */
+int64_t unzigzag(uint64_t value);
+
+/**
+ * @brief Starts a packed stream; its first record will be a keyframe.
+ *
+ * @param codec The codec.
+ * @param interval The sampling interval of the recording.
+ * @return void
+ */
+void codecInit(Codec *codec, uint64_t interval);
+
+/**
+ * @brief Packs one record, as a keyframe or as the difference from the previous one.
+ *
+ * @param codec The codec.
+ * @param record The record.
+ * @param out Receives up to RECORD_PACKED_MAX bytes.
+ * @return Number of bytes written.
+ */
+size_t codecEncode(Codec *codec, const SampleRecord *record, uint8_t *out);
+
+/**
+ * @brief Unpacks one record.
+ *
+ * @param codec The codec.
+ * @param p The first byte of the packed record.
+ * @param end The end of the buffer.
+ * @param record Receives the record.
+ * @return The first byte of the next record, or NULL if the record is truncated, or if it is
+ * a difference and no keyframe has been decoded (errno EINVAL).
+ */
+const uint8_t *codecDecode(Codec *codec, const uint8_t *p, const uint8_t *end, SampleRecord *record);
+
+/**
+ * @brief Opens a recording for appending, writing its header if the file is new.
+ *
+ * New recordings are packed; an existing raw recording keeps getting raw records. Appending
+ * to a packed recording starts with a keyframe.
+ *
+ * @param recorder The recorder to initialise.
+ * @param path Path of the recording.
+ * @param interval The sampling interval, stored in a new header.
+ * @return 0 on success, -1 on error with errno set (EINVAL if an existing file is not a compatible recording).
+ */
+int recorderOpen(Recorder *recorder, const char *path, uint64_t interval);
+
+/**
+ * @brief Appends one record to a recording with a single write().
+ *
+ * @param recorder The recorder.
+ * @param set The sample.
+ * @param cores Number of cores.
+ * @param sessions Number of user sessions.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int recorderAppend(Recorder *recorder, const SampleSet *set, int cores, int sessions);
+
+/**
+ * @brief Closes a recording.
+ *
+ * @param recorder The recorder.
+ * @return void
+ */
+void recorderClose(Recorder *recorder);
+
+/**
+ * @brief Maps a recording into memory and checks its header.
+ *
+ * Packed recordings are scanned once to count their records and find their keyframes.
+ * A truncated last record, e.g. from a crash in the middle of a write, is ignored.
+ *
+ * @param replay The replay to initialise.
+ * @param path Path of the recording.
+ * @return 0 on success, -1 on error with errno set (EINVAL if the file is not a compatible recording).
+ */
+int replayOpen(Replay *replay, const char *path);
+
+/**
+ * @brief Reads the next record of a recording.
+ *
+ * @param replay The replay.
+ * @param record Receives the record.
+ * @return 1 if a record was read, 0 at the end of the recording.
+ */
+int replayNext(Replay *replay, SampleRecord *record);
+
+/**
+ * @brief Positions a replay so that replayNext returns the given record next.
+ *
+ * Decoding restarts at the closest keyframe before the record, so this costs at most
+ * RECORD_KEYFRAME_INTERVAL decoded records.
+ *
+ * @param replay The replay.
+ * @param index Index of the record, from 0 to `count`.
+ * @return 0 on success, -1 if the index is out of range (errno EINVAL).
+ */
+int replaySeek(Replay *replay, long index);
+
+/**
+ * @brief Unmaps a recording.
+ *
+ * @param replay The replay.
+ * @return void
+ */
+void replayClose(Replay *replay);
+
+/**
+ * @brief Clears a histogram.
+ *
+ * @param hist The histogram.
+ * @return void
+ */
+void histInit(Histogram *hist);
+
+/**
+ * @brief Records one value.
+ *
+ * @param hist The histogram.
+ * @param value The value to record.
+ * @return void
+ */
+void histAdd(Histogram *hist, uint64_t value);
+
+/**
+ * @brief Returns an upper bound of the given percentile of the recorded values.
+ *
+ * @param hist The histogram.
+ * @param percentile Percentile between 0 and 100.
+ * @return The upper limit of the bucket holding the percentile, capped at the maximum; 0 if empty.
+ */
+uint64_t histPercentile(const Histogram *hist, double percentile);
+
+/**
+ * @brief Returns the mean of the recorded values.
+ *
+ * @param hist The histogram.
+ * @return The mean, or 0 if the histogram is empty.
+ */
+double histMean(const Histogram *hist);
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return Monotonic time in nanoseconds.
+ */
+uint64_t nowNanos(void);
+
+/**
+ * @brief Starts a schedule with the given interval.
+ *
+ * @param sched The schedule.
+ * @param interval Time between samples in nanoseconds; 0 samples back to back.
+ * @return void
+ */
+void schedStart(Scheduler *sched, uint64_t interval);
+
+/**
+ * @brief Returns the deadline of the next sample without waiting for it.
+ *
+ * The first deadline is the current time. Later deadlines follow on the grid; if whole
+ * intervals have already passed, the skipped deadlines are counted as missed and the next
+ * deadline is the last one that has passed. After `schedRetime` a new grid starts one
+ * interval after the previous sample.
+ *
+ * @param sched The schedule.
+ * @return CLOCK_MONOTONIC deadline in nanoseconds.
+ */
+uint64_t schedPlan(Scheduler *sched);
+
+/**
+ * @brief Records that a sample is being taken now, for the deadline given by `schedPlan`.
+ *
+ * @param sched The schedule.
+ * @return CLOCK_MONOTONIC time of the sample in nanoseconds.
+ */
+uint64_t schedTick(Scheduler *sched);
+
+/**
+ * @brief Changes the interval of a running schedule.
+ *
+ * The missed deadlines and the time between the previous sample and the next one are not
+ * counted, so this is also how sampling resumes after a pause.
+ *
+ * @param sched The schedule.
+ * @param interval The new time between samples in nanoseconds.
+ * @return void
+ */
+void schedRetime(Scheduler *sched, uint64_t interval);
+
+/**
+ * @brief Changes the interval from the next deadline on, without starting a new grid.
+ *
+ * Unlike `schedRetime`, the next deadline is the current one plus the new interval and the
+ * time until it is counted, for an interval that changes with every sample (--adaptive).
+ *
+ * @param sched The schedule.
+ * @param interval The new time between samples in nanoseconds.
+ * @return void
+ */
+void schedAdjust(Scheduler *sched, uint64_t interval);
+
+/**
+ * @brief Waits for the next deadline and returns the timestamp of the new sample.
+ *
+ * The first call returns immediately. Later calls sleep with clock_nanosleep(TIMER_ABSTIME)
+ * until the deadline given by `schedPlan`, then record the sample with `schedTick`.
+ *
+ * @param sched The schedule.
+ * @return CLOCK_MONOTONIC time of the sample in nanoseconds.
+ */
+uint64_t schedNext(Scheduler *sched);
+
+/**
+ * @brief Prints the missed deadlines and the min/avg/p99/max of the sampling interval.
+ *
+ * @param sched The schedule.
+ * @param out The stream to print to.
+ * @return void
+ */
+void schedReport(const Scheduler *sched, FILE *out);
+
+/**
+ * @brief Returns the CPU time used by the process, its threads and its reaped children.
+ *
+ * @return User and system time, in nanoseconds.
+ */
+uint64_t selfCpuTime(void);
+
+/**
+ * @brief Starts measuring the monitor.
+ *
+ * @param self The measurements to initialise.
+ * @return void
+ */
+void selfStart(SelfStats *self);
+
+/**
+ * @brief Records the time one stage took.
+ *
+ * @param self The measurements.
+ * @param stage The stage.
+ * @param elapsed Time the stage took, in nanoseconds.
+ * @return void
+ */
+void selfRecord(SelfStats *self, SelfStage stage, uint64_t elapsed);
+
+/**
+ * @brief Records the collector times of a sample and the CPU the monitor used since the previous one.
+ *
+ * @param self The measurements.
+ * @param set The sample, with the time of each enabled collector and the CPU time of the workers.
+ * @param enabled Which collectors were sampled, indexed by CollectorKind.
+ * @return void
+ */
+void selfSample(SelfStats *self, const SampleSet *set, const bool *enabled);
+
+/**
+ * @brief Prints the p50, p99 and max latency of every stage and registry collector, and the
+ * CPU the monitor used against the time it ran.
+ *
+ * Call it once the sample engine is stopped, so that worker processes are counted as reaped children.
+ *
+ * @param self The measurements.
+ * @param collectors The registry collectors, or NULL.
+ * @param out The stream to print to.
+ * @return void
+ */
+void selfReport(const SelfStats *self, const CollectorSet *collectors, FILE *out);
+
+/**
+ * @brief Starts --adaptive at `interval`, clamped between `min` and `max`.
+ *
+ * @param adaptive The state to initialise.
+ * @param min Shortest interval in nanoseconds.
+ * @param max Longest interval in nanoseconds.
+ * @param interval Interval of the first samples in nanoseconds.
+ * @return void
+ */
+void adaptiveStart(Adaptive *adaptive, uint64_t min, uint64_t max, uint64_t interval);
+
+/**
+ * @brief Picks the interval after a sample from how much CPU usage and memory moved.
+ *
+ * A move of a full step, or CPU usage above ADAPTIVE_CPU_HIGH, drops straight to `min` so
+ * that a spike is followed closely; a steady host doubles the interval up to `max`; anything
+ * in between keeps it.
+ *
+ * @param adaptive The state.
+ * @param sample The newest sample, with its CPU usage and memory delta.
+ * @return The interval until the next sample, in nanoseconds.
+ */
+uint64_t adaptiveUpdate(Adaptive *adaptive, const HistorySample *sample);
+
+/**
+ * @brief Prints the effective sampling rate and what it saved against sampling at `min` throughout.
+ *
+ * @param adaptive The state.
+ * @param self The monitor's own cost, for the CPU time per sample.
+ * @param out The stream to print to.
+ * @return void
+ */
+void adaptiveReport(const Adaptive *adaptive, const SelfStats *self, FILE *out);
+
+/**
+ * @brief Parses an alert rule.
+ *
+ * "METRIC>VALUE[:SAMPLES]" and "METRIC<VALUE[:SAMPLES]" fire once the value stays beyond
+ * VALUE for SAMPLES samples in a row (ALERT_DEFAULT_SAMPLES by default); "METRIC:z=SIGMAS"
+ * fires when a sample is SIGMAS standard deviations away from the EWMA mean. METRIC is cpu
+ * (percent), memory or available (GB) or sessions.
+ *
+ * @param rule Receives the rule, with its state cleared.
+ * @param spec The rule.
+ * @return true if the rule is valid.
+ */
+bool alertParse(AlertRule *rule, const char *spec);
+
+/**
+ * @brief Parses the --alert rules and opens the --alert-to socket.
+ *
+ * @param alerts The rules to set up.
+ * @param opts The parsed command-line options.
+ * @return 0 on success, -1 on error with errno set; EINVAL if a rule watches a value that is
+ *         not collected (cpu and memory need --system, sessions needs --user).
+ */
+int alertsOpen(Alerts *alerts, const Options *opts);
+
+/**
+ * @brief Updates every rule with a sample and sends a line for every alert raised or resolved.
+ *
+ * Each line is one JSON object: the time, the rule, "firing" or "resolved", the value and
+ * the EWMA mean, standard deviation and z-score it was judged against.
+ *
+ * @param alerts The rules.
+ * @param sample The newest sample, with its CPU usage and memory.
+ * @param sessions Number of user sessions.
+ * @return void
+ */
+void alertsEvaluate(Alerts *alerts, const HistorySample *sample, int sessions);
+
+/**
+ * @brief Prints how many times each rule fired and how many lines were sent and dropped, and
+ * closes the socket.
+ *
+ * @param alerts The rules.
+ * @param out The stream to print the summary to.
+ * @return void
+ */
+void alertsClose(Alerts *alerts, FILE *out);
+
+/**
+ * @brief Parses a duration such as "2", "2s", "100ms", "500us" or "250000ns".
+ *
+ * @param str The duration; a number without a unit is in seconds.
+ * @param ns Receives the duration in nanoseconds.
+ * @return true if the duration is valid, false otherwise.
+ */
+bool parseDuration(const char *str, uint64_t *ns);
+
+/**
+ * @brief Formats a duration in the largest unit that represents it exactly.
+ *
+ * @param ns The duration in nanoseconds.
+ * @param buf Receives text such as "1 secs" or "100 ms".
+ * @param len Size of `buf`.
+ * @return void
+ */
+void formatDuration(uint64_t ns, char *buf, size_t len);
+
+/**
+ * @brief Allocates the buffers of a frame.
+ *
+ * @param frame The frame to initialise.
+ * @param cap Initial size of each buffer.
+ * @param incremental True to redraw changed lines in place, false to append whole frames.
+ * @return 0 on success, -1 if an allocation failed.
+ */
+int frameInit(Frame *frame, size_t cap, bool incremental);
+
+/**
+ * @brief Frees the buffers of a frame.
+ *
+ * @param frame The frame.
+ * @return void
+ */
+void frameFree(Frame *frame);
+
+/**
+ * @brief Starts building a new frame.
+ *
+ * @param frame The frame.
+ * @return void
+ */
+void frameBegin(Frame *frame);
+
+/**
+ * @brief Appends formatted text to the frame being built.
+ *
+ * @param frame The frame.
+ * @param fmt A printf format string.
+ * @return void
+ */
+void framePrintf(Frame *frame, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Makes the next flush clear the screen and draw the frame in full.
+ *
+ * Used after the terminal is resized, when the lines of the previous frame may have wrapped
+ * and relative cursor movement can no longer find its first line.
+ *
+ * @param frame The frame.
+ * @return void
+ */
+void frameRedraw(Frame *frame);
+
+/**
+ * @brief Sends the frame to standard output with a single write().
+ *
+ * The first frame, and every frame in sequential mode, is written as is. Later frames in
+ * incremental mode move the cursor back to the top of the previous frame, rewrite only the
+ * lines that changed, skip unchanged lines with a newline, and clear any leftover lines.
+ *
+ * @param frame The frame.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int frameFlush(Frame *frame);
+
+/**
+ * @brief Allocates the ring of a history.
+ *
+ * @param history The history to initialise.
+ * @param capacity Number of samples the ring keeps.
+ * @return 0 on success, -1 if the allocation failed.
+ */
+int historyInit(History *history, int capacity);
+
+/**
+ * @brief Frees the ring of a history.
+ *
+ * @param history The history.
+ * @return void
+ */
+void historyFree(History *history);
+
+/**
+ * @brief Appends a sample, replacing the oldest one if the ring is full.
+ *
+ * @param history The history.
+ * @param sample The sample to copy into the ring.
+ * @return void
+ */
+void historyPush(History *history, const HistorySample *sample);
+
+/**
+ * @brief Returns the k-th oldest sample kept in the history.
+ *
+ * @param history The history.
+ * @param k Index from 0 (oldest) to count - 1 (newest).
+ * @return Pointer to the sample inside the ring.
+ */
+const HistorySample *historyAt(const History *history, int k);
+
+/**
+ * @brief Writes a whole buffer to a file descriptor, retrying short and interrupted writes.
+ *
+ * @param fd The file descriptor to write to.
+ * @param buf The bytes to write.
+ * @param len Number of bytes to write.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int writeFull(int fd, const void *buf, size_t len);
+
+/**
+ * @brief Reads exactly `len` bytes from a file descriptor, retrying short and interrupted reads.
+ *
+ * @param fd The file descriptor to read from.
+ * @param buf Where to store the bytes.
+ * @param len Number of bytes to read.
+ * @return 0 on success, -1 on error with errno set (EPIPE if the writer closed early).
+ */
+int readFull(int fd, void *buf, size_t len);
+
+/**
+ * @brief Starts the collectors of a run with the given engine.
+ *
+ * For ENGINE_PROCESS and ENGINE_THREAD one worker is started per enabled collector; the memory
+ * and CPU collectors are enabled by `sys` and the session collector by `user`. ENGINE_FORK starts
+ * nothing up front, and ENGINE_INLINE only opens a libsysstats sampler.
+ *
+ * @param engine The engine to initialise.
+ * @param mode The sampling engine to use.
+ * @param sys True to enable the memory and CPU collectors.
+ * @param user True to enable the session collector.
+ * @return 0 on success, -1 on error with errno set. On error no worker is left running.
+ */
+int startEngine(SampleEngine *engine, EngineMode mode, bool sys, bool user);
+
+/**
+ * @brief Takes one sample from every enabled collector.
+ *
+ * With the persistent engines this costs one command write and one or two reply reads per
+ * collector. All workers are woken before any reply is read, so the collectors run in parallel.
+ * ENGINE_INLINE reads the files directly, one after the other.
+ *
+ * @param engine A started engine.
+ * @param set Receives the sample; the session buffer is reused across calls.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int engineSample(SampleEngine *engine, SampleSet *set);
+
+/**
+ * @brief Asks every worker to quit, reaps or joins it, and closes its pipes.
+ *
+ * @param engine A started engine.
+ * @return void
+ */
+void stopEngine(SampleEngine *engine);
+
+/**
+ * @brief Releases the session buffer of a sample set.
+ *
+ * @param set The sample set.
+ * @return void
+ */
+void freeSampleSet(SampleSet *set);
+
+/**
+ * @brief Formats one line per user session found in the utmp file.
+ *
+ * The lines are written to a caller-owned buffer that is grown with realloc when it is too small,
+ * so a buffer reused across calls only allocates while the session list grows.
+ *
+ * @param buf Pointer to the buffer, which may be NULL initially.
+ * @param len Receives the number of bytes written (the buffer is not NUL-terminated).
+ * @param cap Pointer to the allocated size of the buffer.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int readSessions(char **buf, size_t *len, size_t *cap);
+
+/**
+ * @brief Starts watching utmp for session changes. The first refresh reads the list.
+ *
+ * @param watch The watch to initialise.
+ * @return 0; without inotify the list is simply re-read on every refresh.
+ */
+int sessionsOpen(SessionWatch *watch);
+
+/**
+ * @brief Re-reads the session list if utmp changed since the previous refresh.
+ *
+ * Sets `logins` and `logouts` to the sessions that appeared and ended since the previous
+ * refresh; the first refresh counts neither.
+ *
+ * @param watch The watch.
+ * @return 1 if the list changed, 0 if it did not, -1 on error with errno set.
+ */
+int sessionsRefresh(SessionWatch *watch);
+
+/**
+ * @brief Stops watching utmp and frees the session list.
+ *
+ * @param watch The watch.
+ * @return void
+ */
+void sessionsClose(SessionWatch *watch);
+
+/**
+ * @brief Opens /proc and starts the scan threads.
+ *
+ * @param top The scanner to initialise.
+ * @param shown Number of busiest processes to keep.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int topOpen(ProcTop *top, int shown);
+
+/**
+ * @brief Scans every process and selects the busiest ones.
+ *
+ * Processes that exit during the scan are skipped. CPU usage is 0 at the first scan.
+ *
+ * @param top The scanner.
+ * @param timestamp CLOCK_MONOTONIC time of the scan, in nanoseconds.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int topScan(ProcTop *top, uint64_t timestamp);
+
+/**
+ * @brief Stops the scan threads and frees the scanner.
+ *
+ * @param top The scanner.
+ * @return void
+ */
+void topClose(ProcTop *top);
+
+/**
+ * @brief Prints the busiest processes of the last scan, busiest first.
+ *
+ * @param frame The frame the section is added to.
+ * @param top The scanner.
+ * @return void
+ */
+void topOutput(Frame *frame, const ProcTop *top);
+
+/**
+ * @brief Opens /proc/loadavg and the /proc/pressure files.
+ *
+ * Pressure files that cannot be opened leave `available` false; only /proc/loadavg is required.
+ *
+ * @param pressure The collector to initialise.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int pressureOpen(Pressure *pressure);
+
+/**
+ * @brief Sets a "some" stall trigger on every resource.
+ *
+ * @param pressure The collector.
+ * @param stall Stall time that fires the trigger, in nanoseconds.
+ * @param window Window the stall time is measured over, in nanoseconds.
+ * @return 0 on success, -1 on error with errno set: ENOTSUP without pressure stall information,
+ * EINVAL for a window the kernel refuses and EPERM or EACCES without the right to set triggers.
+ */
+int pressureTrigger(Pressure *pressure, uint64_t stall, uint64_t window);
+
+/**
+ * @brief Reads the load averages and the pressure of every resource.
+ *
+ * @param pressure The collector.
+ * @param timestamp CLOCK_MONOTONIC time of the sample, in nanoseconds.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int pressureSample(Pressure *pressure, uint64_t timestamp);
+
+/**
+ * @brief Closes the files and triggers of the collector.
+ *
+ * @param pressure The collector.
+ * @return void
+ */
+void pressureClose(Pressure *pressure);
+
+/**
+ * @brief Prints the load averages and the stalled time of each resource since the previous sample.
+ *
+ * @param frame The frame the section is added to.
+ * @param pressure The collector.
+ * @return void
+ */
+void pressureOutput(Frame *frame, const Pressure *pressure);
+
+/**
+ * @brief Opens /proc/diskstats.
+ *
+ * @param disk The collector to initialise.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int diskOpen(DiskStats *disk);
+
+/**
+ * @brief Reads the counters of every block device, keeping those of the previous sample.
+ *
+ * @param disk The collector.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int diskSample(DiskStats *disk);
+
+/**
+ * @brief Computes the rates of every device between the last two samples.
+ *
+ * @param disk The collector.
+ * @param elapsed Time between the two samples, in nanoseconds.
+ * @return void
+ */
+void diskDelta(DiskStats *disk, uint64_t elapsed);
+
+/**
+ * @brief Closes /proc/diskstats and frees the counters.
+ *
+ * @param disk The collector.
+ * @return void
+ */
+void diskClose(DiskStats *disk);
+
+/**
+ * @brief Prints the IOPS, throughput, await and busy time of every whole disk that did I/O.
+ *
+ * @param frame The frame the section is added to.
+ * @param disk The collector.
+ * @return void
+ */
+void diskOutput(Frame *frame, const DiskStats *disk);
+
+/**
+ * @brief Opens /proc/net/dev.
+ *
+ * @param net The collector to initialise.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int netOpen(NetStats *net);
+
+/**
+ * @brief Reads the counters of every interface, keeping those of the previous sample.
+ *
+ * @param net The collector.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int netSample(NetStats *net);
+
+/**
+ * @brief Computes the rates of every interface between the last two samples.
+ *
+ * @param net The collector.
+ * @param elapsed Time between the two samples, in nanoseconds.
+ * @return void
+ */
+void netDelta(NetStats *net, uint64_t elapsed);
+
+/**
+ * @brief Closes /proc/net/dev and frees the counters.
+ *
+ * @param net The collector.
+ * @return void
+ */
+void netClose(NetStats *net);
+
+/**
+ * @brief Prints the bytes and packets per second received and sent on every interface.
+ *
+ * @param frame The frame the section is added to.
+ * @param net The collector.
+ * @return void
+ */
+void netOutput(Frame *frame, const NetStats *net);
+
+/**
+ * @brief Finds the cgroup2 mount and opens the files of every cgroup in `paths`.
+ *
+ * @param cgroups The collector to initialise.
+ * @param paths Comma-separated cgroup paths, below the cgroup2 mount or absolute, or "" for
+ * the cgroup of the process.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int cgroupOpen(CgroupStats *cgroups, const char *paths);
+
+/**
+ * @brief Reads the counters of every cgroup, keeping those of the previous sample.
+ *
+ * @param cgroups The collector.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int cgroupSample(CgroupStats *cgroups);
+
+/**
+ * @brief Computes the CPU usage and throttling of every cgroup between the last two samples.
+ *
+ * @param cgroups The collector.
+ * @param elapsed Time between the two samples, in nanoseconds.
+ * @return void
+ */
+void cgroupDelta(CgroupStats *cgroups, uint64_t elapsed);
+
+/**
+ * @brief Closes the files of every cgroup and frees the collector.
+ *
+ * @param cgroups The collector.
+ * @return void
+ */
+void cgroupClose(CgroupStats *cgroups);
+
+/**
+ * @brief Prints the memory and CPU of every cgroup against its limits, and its throttling.
+ *
+ * @param frame The frame the section is added to.
+ * @param cgroups The collector.
+ * @return void
+ */
+void cgroupOutput(Frame *frame, const CgroupStats *cgroups);
+
+/**
+ * @brief Starts every collector of the registry that the options enable.
+ *
+ * @param set The set to fill.
+ * @param opts The parsed command-line options.
+ * @param live False to open only the collectors of the sample engine, for samples that come
+ * from a recording or shared memory.
+ * @return 0 on success, -1 on error with errno set; the collectors started so far are closed.
+ */
+int collectorsOpen(CollectorSet *set, const Options *opts, bool live);
+
+/**
+ * @brief Finds an enabled collector that the chosen output cannot show.
+ *
+ * Records, shared memory, replays and the metrics endpoint only carry what the sample engine
+ * reads; the other collectors are only shown by the live text display.
+ *
+ * @param opts The parsed command-line options.
+ * @return The option of the first such collector, or NULL if there is none.
+ */
+const char *collectorsUnshown(const Options *opts);
+
+/**
+ * @brief Samples every collector with the same timestamp and computes their rates.
+ *
+ * @param set The collectors.
+ * @param timestamp CLOCK_MONOTONIC time of the sample, in nanoseconds.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int collectorsSample(CollectorSet *set, uint64_t timestamp);
+
+/**
+ * @brief Stores the descriptors of every collector that can ask for an early sample.
+ *
+ * @param set The collectors.
+ * @param fds Receives the descriptors.
+ * @param cap Number of entries in `fds`.
+ * @return Number of descriptors stored.
+ */
+int collectorsWatch(const CollectorSet *set, int *fds, int cap);
+
+/**
+ * @brief Passes an event on a watched descriptor to the collector that owns it.
+ *
+ * @param set The collectors.
+ * @param fd The descriptor the event came on.
+ * @return True if the collector asks for a sample now.
+ */
+bool collectorsWake(CollectorSet *set, int fd);
+
+/**
+ * @brief Adds the section of every collector that has been sampled, in registry order.
+ *
+ * @param frame The frame the sections are added to.
+ * @param set The collectors.
+ * @param display The display the engine's collectors render from.
+ * @return void
+ */
+void collectorsRender(Frame *frame, const CollectorSet *set, const Display *display);
+
+/**
+ * @brief Closes every collector and frees its state.
+ *
+ * @param set The collectors.
+ * @return void
+ */
+void collectorsClose(CollectorSet *set);
+
+/**
+ * @brief Returns the command-line name of a sampling engine.
+ *
+ * @param mode The sampling engine.
+ * @return "fork", "process" or "thread".
+ */
+const char *engineName(EngineMode mode);
+
+/**
+ * @brief Measures the per-sample latency of every sampling engine.
+ *
+ * Each engine is started, warmed up with one sample, and then timed over `opts->samples`
+ * samples without any printing. The minimum, average and maximum latency are printed per engine.
+ *
+ * @param opts The parsed command-line options; `samples`, `sys` and `user` are used.
+ * @return void
+ */
+void benchEngines(const Options *opts);
+
+/**
+ * @brief Compares the /proc parsers against the stdio code they replaced.
+ *
+ * For /proc/stat, /proc/cpuinfo, /proc/uptime, /proc/meminfo, /proc/loadavg, /proc/pressure/cpu, /proc/diskstats
+ * and /proc/net/dev, times `opts->samples` parses with
+ * fopen/fscanf/fgets and with a kept-open ProcFile and the integer scanners, and prints the
+ * nanoseconds per parse of each.
+ *
+ * @param opts The parsed command-line options; `samples` is used.
+ * @return void
+ */
+void benchParsers(const Options *opts);
+
+/**
+ * @brief Measures the packed recording format: bytes per sample, and encode and decode cost.
+ *
+ * The samples come from the recording named by --replay, or else from a synthetic stream that
+ * starts from the live counters and moves like a lightly loaded host sampled every --tdelay.
+ * Every sample is checked to decode back to the original, and the size of a week of 1-second
+ * samples is projected from the bytes per sample.
+ *
+ * @param opts The parsed command-line options; `samples` is the length of the synthetic stream.
+ * @return void
+ */
+void benchCodec(const Options *opts);
+
+/**
+ * @brief Measures the cost of one sysstats_sample call for each collector and for all of them.
+ *
+ * The heap in use is compared before and after the timed calls, to show that sampling does
+ * not allocate.
+ *
+ * @param opts The parsed command-line options; `samples` is the number of calls.
+ * @return void
+ */
+void benchLibrary(const Options *opts);
+
+/**
+ * @brief Load-tests a running metrics server.
+ *
+ * SERVE_BENCH_CONNECTIONS connections scrape the server named by --serve at the same time,
+ * each opening a new connection when its scrape is done, until `samples` scrapes were made.
+ * Throughput, failures and the latency percentiles are printed.
+ *
+ * @param opts The parsed command-line options.
+ * @return void
+ */
+void benchServe(const Options *opts);
+
+/**
+ * @brief Measures the cost of a --top scan as the number of processes grows.
+ *
+ * Idle child processes are started in steps up to TOP_BENCH_PIDS; at each step the min and
+ * average scan time over `samples` scans and the cost per process are printed.
+ *
+ * @param opts The parsed command-line options.
+ * @return void
+ */
+void benchTop(const Options *opts);
+
+/**
+ * @brief Copies every file the collectors read into a directory laid out like /, for --proc-root.
+ *
+ * The files are read through procOpen, so a capture of a --proc-root tree copies that tree.
+ * With `cores` or `sessions` set, /proc/stat and /proc/cpuinfo are rewritten for that many
+ * cores by repeating the captured ones, and utmp for that many sessions, to model a large host.
+ *
+ * @param dir The directory to write, created if needed.
+ * @param cores Number of cores to write, at most MAX_CORES, or 0 to copy the files as they are.
+ * @param sessions Number of user sessions to write, or 0 to copy utmp as it is.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int captureHost(const char *dir, int cores, int sessions);
+
+/**
+ * @brief Serves the samples as Prometheus metrics instead of displaying them.
+ *
+ * A single-threaded epoll loop waits on a timerfd that fires every interval, a signalfd for
+ * SIGINT and SIGTERM, and the server's sockets. Each timer tick takes one sample and renders
+ * the response; scrapes in between are answered from that response without reading /proc.
+ * The server runs until it is stopped unless `samples` is given.
+ *
+ * @param opts The parsed command-line options; `serve` is the address.
+ * @return void
+ */
+void serveinfo(const Options *opts);
+
+/**
+ * @brief Displays the samples published by a --daemon through the regular display.
+ *
+ * Every interval of the daemon, the samples published since the last frame are read from the
+ * shared-memory segment and a frame is drawn; /proc is never read. The client stops after
+ * `samples` frames (unless 0), or when the daemon stops.
+ *
+ * @param opts The parsed command-line options; `attach` names the segment.
+ * @return void
+ */
+void attachinfo(const Options *opts);
+
+/**
+ * @brief Replays a recording made with --record through the regular display.
+ *
+ * The recording is mapped into memory and every record goes through the same history and
+ * usage computation as a live sample, as fast as it can be read. In the interactive display,
+ * frames are drawn at most once every REPLAY_FRAME_INTERVAL and once at the end; with
+ * --format=jsonl|csv every record is written. The time the replay took is printed at the end.
+ * With --from=N the replay seeks to sample N through the keyframes of the recording, and the
+ * sample before it only primes the CPU counters, so the samples shown match a full replay.
+ *
+ * @param opts The parsed command-line options; `replay` names the recording.
+ * @return void
+ */
+void replayinfo(const Options *opts);
 
 /**
  * @brief The entry point of the program.
@@ -0,0 +1,62 @@
+#include "header.h"
+
+void histInit(Histogram *hist) {
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+/**
+ * Maps a value to its bucket: values below HIST_SUB_BUCKETS get a bucket each, larger values
+ * get HIST_SUB_BUCKETS linear buckets per power of two.
+ */
+static int histBucket(uint64_t value) {
+    if (value < HIST_SUB_BUCKETS) {
+        return (int) value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = (int) ((value >> (exponent - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1));
+    return (exponent - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS + sub;
+}
+
+/**
+ * Returns the largest value that falls into a bucket.
+ */
+static uint64_t histBucketLimit(int bucket) {
+    if (bucket < HIST_SUB_BUCKETS) {
+        return (uint64_t) bucket;
+    }
+    int exponent = bucket / HIST_SUB_BUCKETS + HIST_SUB_BITS - 1;
+    uint64_t sub = (uint64_t) (bucket % HIST_SUB_BUCKETS);
+    uint64_t low = (HIST_SUB_BUCKETS + sub) << (exponent - HIST_SUB_BITS);
+    return low + ((uint64_t) 1 << (exponent - HIST_SUB_BITS)) - 1;
+}
+
+void histAdd(Histogram *hist, uint64_t value) {
+    hist->buckets[histBucket(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+}
+
+uint64_t histPercentile(const Histogram *hist, double percentile) {
+    if (hist->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) ceil(percentile / 100.0 * (double) hist->count);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += hist->buckets[b];
+        if (seen >= rank) {
+            uint64_t limit = histBucketLimit(b);
+            // The bucket limit can overshoot the largest value actually recorded
+            return limit < hist->max ? limit : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+double histMean(const Histogram *hist) {
+    return hist->count ? (double) hist->sum / (double) hist->count : 0.0;
+}
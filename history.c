@@ -0,0 +1,37 @@
+#include "header.h"
+
+int historyInit(History *history, int capacity) {
+    history->samples = malloc((size_t) capacity * sizeof(HistorySample));
+    if (!history->samples) {
+        return -1;
+    }
+    history->capacity = capacity;
+    history->head = 0;
+    history->count = 0;
+    history->total = 0;
+    return 0;
+}
+
+void historyFree(History *history) {
+    free(history->samples);
+    history->samples = NULL;
+    history->capacity = 0;
+    history->count = 0;
+}
+
+void historyPush(History *history, const HistorySample *sample) {
+    int slot = (history->head + history->count) % history->capacity;
+    if (history->count == history->capacity) {
+        // Full: overwrite the oldest sample
+        history->head = (history->head + 1) % history->capacity;
+    }
+    else {
+        history->count++;
+    }
+    history->samples[slot] = *sample;
+    history->total++;
+}
+
+const HistorySample *historyAt(const History *history, int k) {
+    return &history->samples[(history->head + k) % history->capacity];
+}
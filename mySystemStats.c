@@ -1,216 +1,787 @@
 #define _POSIX_C_SOURCE 200809L
 #include "header.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
 
-void handle_sigint(int sig) {
-    if (sig == SIGTSTP){
+#include <termios.h>
+
+// Terminal settings to restore when the program exits
+static struct termios saved_termios;
+static bool termios_saved = false;
+
+static void restoreTerminal(void) {
+    if (termios_saved) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+    }
+}
+
+/**
+ * Switches the terminal to reading single keys without echo, if standard input is a terminal
+ * in the foreground. Ctrl+C and Ctrl+Z still send their signals.
+ */
+static bool openKeys(void) {
+    if (!isatty(STDIN_FILENO) || tcgetpgrp(STDIN_FILENO) != getpgrp()) {
+        return false;
+    }
+    if (tcgetattr(STDIN_FILENO, &saved_termios) == -1) {
+        return false;
+    }
+    struct termios raw = saved_termios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) == -1) {
+        return false;
+    }
+    termios_saved = true;
+    atexit(restoreTerminal);
+    return true;
+}
+
+static void togglePause(Controls *controls) {
+    controls->paused = !controls->paused;
+    // Sampling resumes on a new grid instead of catching up on the pause
+    if (!controls->paused) controls->retimed = true;
+    controls->redraw = true;
+}
+
+void handleSignal(Controls *controls, int sig) {
+    if (sig == SIGINT && controls->interactive) {
+        controls->confirming = true;
+        controls->redraw = true;
+    }
+    else if (sig == SIGINT || sig == SIGTERM) {
+        controls->quit = true;
+    }
+    else if (sig == SIGTSTP && controls->interactive) {
+        togglePause(controls);
+    }
+    else if (sig == SIGWINCH) {
+        controls->relayout = true;
+        controls->redraw = true;
+    }
+}
+
+void handleKey(Controls *controls, char key) {
+    if (controls->confirming) {
+        controls->confirming = false;
+        controls->quit = key == 'y' || key == 'Y';
+        controls->redraw = true;
         return;
     }
-    if (sig == SIGINT){
-        char ans;
-        printf("\nDo you want to quit? [y/n]: ");
-        if (scanf(" %c", &ans) != 1) {
-        // Handle scanf failure, including interruption by a signal.
-            if (errno == EINTR) {
-                printf("\nSignal detected during input, resuming...\n");
-            } else {
-            // Other errors are considered fatal.
-                perror("Error reading input");
-                exit(EXIT_FAILURE);
-            }
-        } else if (ans == 'y' || ans == 'Y') {
-            // Exit if the user confirms.
-            exit(EXIT_SUCCESS);
-        }
+    switch (key) {
+        case 'q':
+            controls->confirming = true;
+            controls->redraw = true;
+            break;
+        case 'p':
+        case ' ':
+            togglePause(controls);
+            break;
+        case '+':
+            controls->interval = controls->interval < INTERVAL_MIN ? INTERVAL_MIN : controls->interval * 2;
+            if (controls->interval > INTERVAL_MAX) controls->interval = INTERVAL_MAX;
+            controls->retimed = true;
+            controls->redraw = true;
+            break;
+        case '-':
+            controls->interval /= 2;
+            if (controls->interval < INTERVAL_MIN) controls->interval = INTERVAL_MIN;
+            controls->retimed = true;
+            controls->redraw = true;
+            break;
     }
 }
 
+/**
+ * Arms the one-shot sampling timer at an absolute CLOCK_MONOTONIC deadline. A deadline that
+ * has already passed fires right away.
+ */
+static void armTimer(int timer_fd, uint64_t deadline) {
+    struct itimerspec at = {
+        .it_value = { (time_t) (deadline / 1000000000ull), (long) (deadline % 1000000000ull) },
+    };
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &at, NULL);
+}
 
-bool parseargument(int argc, char **argv, int* samples, int* delay,bool* seq, bool* sys, bool* user, bool* graph){
+bool parseargument(int argc, char **argv, Options *opts){
     bool smple = false;
     bool dely = false;
     for(int i = 1;i<argc;i++){
         char *token = strtok(argv[i], "=");
         if (strcmp(token, "--samples") == 0) {
-            *samples = atoi(strtok(NULL, ""));
+            opts->samples = atoi(strtok(NULL, ""));
             smple = true;
         }
         else if (strcmp(token, "--tdelay") == 0) {
-            *delay = atoi(strtok(NULL, ""));
+            if (!parseDuration(strtok(NULL, ""), &opts->interval)) return false;
             dely = true;
         }
+        else if (strcmp(token, "--engine") == 0) {
+            char *value = strtok(NULL, "");
+            if (value == NULL) return false;
+            if (strcmp(value, "fork") == 0) opts->engine = ENGINE_FORK;
+            else if (strcmp(value, "process") == 0) opts->engine = ENGINE_PROCESS;
+            else if (strcmp(value, "thread") == 0) opts->engine = ENGINE_THREAD;
+            else if (strcmp(value, "inline") == 0) opts->engine = ENGINE_INLINE;
+            else return false;
+        }
+        else if (strcmp(token, "--format") == 0) {
+            char *value = strtok(NULL, "");
+            if (value == NULL) return false;
+            if (strcmp(value, "text") == 0) opts->format = FORMAT_TEXT;
+            else if (strcmp(value, "jsonl") == 0) opts->format = FORMAT_JSONL;
+            else if (strcmp(value, "csv") == 0) opts->format = FORMAT_CSV;
+            else return false;
+        }
+        else if (strcmp(token, "--record") == 0) {
+            opts->record = strtok(NULL, "");
+            if (opts->record == NULL) return false;
+        }
+        else if (strcmp(token, "--replay") == 0) {
+            opts->replay = strtok(NULL, "");
+            if (opts->replay == NULL) return false;
+        }
+        else if (strcmp(token, "--from") == 0) {
+            char *value = strtok(NULL, "");
+            if (value == NULL || !isInteger(value)) return false;
+            opts->replay_from = atol(value);
+        }
+        else if (strcmp(token, "--daemon") == 0) {
+            char *value = strtok(NULL, "");
+            opts->daemon = value ? value : SHM_DEFAULT_NAME;
+            // A daemon runs until it is stopped unless told otherwise
+            if (!smple) opts->samples = 0;
+        }
+        else if (strcmp(token, "--serve") == 0) {
+            opts->serve = strtok(NULL, "");
+            if (opts->serve == NULL) return false;
+            if (!smple) opts->samples = 0;
+        }
+        else if (strcmp(token, "--attach") == 0) {
+            char *value = strtok(NULL, "");
+            opts->attach = value ? value : SHM_DEFAULT_NAME;
+            if (!smple) opts->samples = 0;
+        }
+        else if (strcmp(token, "--resolution") == 0) {
+            char *value = strtok(NULL, "");
+            if (value == NULL) return false;
+            if (strcmp(value, "raw") == 0) opts->resolution = -1;
+            else if ((opts->resolution = rollupTier(value)) == -1) return false;
+        }
+        else if (strcmp(token, "--per-core") == 0) {
+            char *value = strtok(NULL, "");
+            if (value != NULL && !isInteger(value)) return false;
+            opts->per_core = value ? atoi(value) : DEFAULT_HOTTEST;
+        }
+        else if (strcmp(token, "--memory") == 0) {
+            char *value = strtok(NULL, "");
+            if (value == NULL) return false;
+            if (strcmp(value, "used") == 0) opts->available = false;
+            else if (strcmp(value, "available") == 0) opts->available = true;
+            else return false;
+        }
+        else if (strcmp(token, "--top") == 0) {
+            char *value = strtok(NULL, "");
+            if (value != NULL && !isInteger(value)) return false;
+            opts->top = value ? atoi(value) : DEFAULT_TOP;
+        }
+        else if (strcmp(token, "--pressure") == 0) {
+            opts->pressure = true;
+        }
+        else if (strcmp(token, "--psi-trigger") == 0) {
+            char *stall = strtok(NULL, ":"), *window = strtok(NULL, "");
+            if (!parseDuration(stall, &opts->psi_trigger) || opts->psi_trigger == 0) return false;
+            opts->psi_window = PSI_TRIGGER_WINDOW;
+            if (window && !parseDuration(window, &opts->psi_window)) return false;
+            // The kernel only accepts a stall time within a window of 500ms to 10s
+            if (opts->psi_window < PSI_WINDOW_MIN || opts->psi_window > PSI_WINDOW_MAX || opts->psi_trigger > opts->psi_window) return false;
+            opts->pressure = true;
+        }
+        else if (strcmp(token, "--cgroup") == 0) {
+            char *value = strtok(NULL, "");
+            opts->cgroup = value ? value : "";
+        }
+        else if (strcmp(argv[i], "--self-stats") == 0) {
+            opts->self_stats = true;
+        }
+        else if (strcmp(token, "--proc-root") == 0) {
+            if (!(opts->proc_root = strtok(NULL, ""))) return false;
+        }
+        else if (strcmp(token, "--capture") == 0) {
+            if (!(opts->capture = strtok(NULL, ""))) return false;
+        }
+        else if (strcmp(token, "--adaptive") == 0) {
+            char *min = strtok(NULL, ":"), *max = strtok(NULL, "");
+            if (!parseDuration(min, &opts->adaptive_min) || !parseDuration(max, &opts->adaptive_max)) return false;
+            if (opts->adaptive_min == 0 || opts->adaptive_min > opts->adaptive_max || opts->adaptive_max > INTERVAL_MAX) return false;
+        }
+        else if (strcmp(token, "--alert") == 0) {
+            char *value = strtok(NULL, "");
+            AlertRule rule;
+            if (opts->alert_count == ALERT_MAX_RULES || !alertParse(&rule, value)) return false;
+            opts->alerts[opts->alert_count++] = value;
+        }
+        else if (strcmp(token, "--alert-to") == 0) {
+            char *value = strtok(NULL, "");
+            if (!value || strncmp(value, "unix:", 5) != 0 || value[5] == '\0') return false;
+            opts->alert_to = value;
+        }
+        else if (strcmp(token, "--synthesize") == 0) {
+            char *cores = strtok(NULL, ":"), *sessions = strtok(NULL, "");
+            if (!cores || !sessions || !isInteger(cores) || !isInteger(sessions)) return false;
+            opts->synth_cores = atoi(cores);
+            opts->synth_sessions = atoi(sessions);
+            if (opts->synth_cores > MAX_CORES) return false;
+        }
+        else if (strcmp(argv[i], "--disk") == 0) {
+            opts->disk = true;
+        }
+        else if (strcmp(argv[i], "--net") == 0) {
+            opts->net = true;
+        }
+        else if (strcmp(token, "--bench") == 0) {
+            char *value = strtok(NULL, "");
+            opts->bench = value ? value : "engines";
+        }
         else if (strcmp(argv[i], "--system") == 0) { 
-            *sys = true;
+            opts->sys = true;
         }
         else if (strcmp(argv[i], "--user") == 0) { 
-            *user = true;
+            opts->user = true;
         }
         else if (strcmp(argv[i], "--sequential") == 0) { 
-            *seq = true;
+            opts->seq = true;
         }
         else if (strcmp(argv[i], "--graphics") == 0){
-            *graph = true;
+            opts->graph = true;
         }
         else if (isInteger(argv[i]) && (i+1 < argc) && isInteger(argv[i+1]) && (!smple) && (!dely)){
-            *delay = atoi(argv[i+1]);
-            *samples = atoi(argv[i]);
+            opts->interval = (uint64_t) atoi(argv[i+1]) * 1000000000ull;
+            opts->samples = atoi(argv[i]);
             smple = true;
             dely = true;
             i += 1;
 
         }
         else if(isInteger(argv[i])&&(!smple)){
-            *samples = atoi(argv[i]);
+            opts->samples = atoi(argv[i]);
             smple = true;
         }
         else{
             return false;
         }
     }
-    if (! *sys && ! *user){
-        *user = true;
-        *sys = true;
+    if (! opts->sys && ! opts->user){
+        opts->user = true;
+        opts->sys = true;
     }
     return true;
 }
-void printinfo(int samples, int delay, bool seq, bool sys, bool user, bool graph){
-    struct sigaction act;
-    act.sa_handler = handle_sigint;
-    sigemptyset(&act.sa_mask);
-    act.sa_flags = 0;
-    volatile sig_atomic_t sigint_received = 0;
-
-    if (sigaction(SIGINT, &act, NULL) == -1) {
-        perror("sigaction error for SIGINT");
+void printinfo(const Options *opts){
+    int samples = opts->samples;
+    bool seq = opts->seq, sys = opts->sys, user = opts->user;
+    // Signals are read from the loop; workers started below inherit the mask
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (!opts->daemon) {
+        sigaddset(&mask, SIGTSTP);
+        sigaddset(&mask, SIGWINCH);
+    }
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int signal_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (epoll_fd == -1 || signal_fd == -1 || timer_fd == -1) {
+        perror("Error setting up the sampling loop");
         exit(EXIT_FAILURE);
     }
+    struct epoll_event event = { .events = EPOLLIN, .data.fd = signal_fd };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &event);
+    event.data.fd = timer_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+    // Nobody answers the quit prompt of a daemon or of a machine-readable stream
+    Controls controls = { .interval = opts->interval };
+    if (!opts->daemon && opts->format == FORMAT_TEXT && openKeys()) {
+        controls.interactive = true;
+        event.data.fd = STDIN_FILENO;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event);
+    }
 
-    if (sigaction(SIGTSTP, &act, NULL) == -1) {
-        perror("sigaction error for SIGTSTP");
+    // Measure from before the workers start, so that starting them counts too
+    SelfStats self;
+    selfStart(&self);
+    SampleEngine engine;
+    SampleSet set = {0};
+    if (startEngine(&engine, opts->engine, sys, user) == -1) {
+        perror("Collector start failed");
         exit(EXIT_FAILURE);
     }
-    int pipe_memory[2], pipe_cpu[2], pipe_user[2];
-    pid_t pid_memory, pid_cpu, pid_user;
 
-    char memory_record[samples][MAX_STR_LEN];
-    char cpu_record[samples][MAX_STR_LEN];
-    memset(memory_record, 0, sizeof(memory_record));
-    memset(cpu_record, 0, sizeof(cpu_record));
-    CPU cpu;
-    long int cpu_previous = 0, cpu_idle = 0;
-    double memory_previous;  
-    for(int i = 0; i<samples; i++){
-        if (pipe(pipe_memory) == -1 || pipe(pipe_cpu) == -1 || pipe(pipe_user) == -1){
-            perror("Pipe creation failed");
+    // Only the newest samples are kept, so memory use does not grow with the sample count
+    int window = (samples > 0 && samples < HISTORY_CAPACITY) ? samples : HISTORY_CAPACITY;
+    Display display;
+    if (displayInit(&display, opts, window) == -1) {
+        perror("Display allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    Recorder recorder;
+    if (opts->record && recorderOpen(&recorder, opts->record, opts->interval) == -1) {
+        perror("Error opening recording");
+        exit(EXIT_FAILURE);
+    }
+    CollectorSet collectors;
+    if (collectorsOpen(&collectors, opts, true) == -1) {
+        perror("Error starting the collectors");
+        exit(EXIT_FAILURE);
+    }
+    display.collectors = &collectors;
+    // A collector that can ask for a sample between two ticks flags it as an exceptional condition
+    int wake_fds[COLLECTORS_MAX_WAKES];
+    int wakes = collectorsWatch(&collectors, wake_fds, COLLECTORS_MAX_WAKES);
+    for (int w = 0; w < wakes; w++) {
+        struct epoll_event pri = { .events = EPOLLPRI, .data.fd = wake_fds[w] };
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fds[w], &pri);
+    }
+    ShmPublisher pub;
+    if (opts->daemon) {
+        if (shmCreate(&pub, opts->daemon, opts->interval) == -1) {
+            perror("Error creating shared memory");
             exit(EXIT_FAILURE);
         }
-        pid_memory = fork();
-        if (pid_memory == -1){
-            perror("Fork creation failed");
-            exit(EXIT_FAILURE);
+        printf("Publishing samples to shared memory %s every %s\n", opts->daemon, display.every);
+        fflush(stdout);
+    }
+    Alerts alerts;
+    if (alertsOpen(&alerts, opts) == -1) {
+        perror("Error setting up the alerts");
+        exit(EXIT_FAILURE);
+    }
+    // The interval follows the signal between the --adaptive bounds, starting from --tdelay
+    Adaptive adaptive;
+    bool adapting = opts->adaptive_max > 0;
+    if (adapting) {
+        adaptiveStart(&adaptive, opts->adaptive_min, opts->adaptive_max, opts->interval);
+        controls.interval = adaptive.interval;
+        formatDuration(adaptive.interval, display.every, sizeof(display.every));
+    }
+    Scheduler sched;
+    schedStart(&sched, controls.interval);
+    char title[MAX_STR_LEN];
+    bool due = true, stalled = false;
+    struct epoll_event events[8];
+    while (!controls.quit) {
+        bool sampled = due || stalled;
+        if (sampled) {
+            // A stall trigger adds a sample between two ticks and leaves the grid alone
+            set.timestamp = due ? schedTick(&sched) : nowNanos();
+            if (engineSample(&engine, &set) == -1) {
+                perror("Sampling failed");
+                exit(EXIT_FAILURE);
+            }
+            selfRecord(&self, STAGE_ENGINE, nowNanos() - set.timestamp);
+            selfSample(&self, &set, engine.enabled);
+            if (collectorsSample(&collectors, set.timestamp) == -1) {
+                perror("Collector sampling failed");
+                exit(EXIT_FAILURE);
+            }
+            int cores = sys ? count_cores() : 0;
+            int sessions = user ? countSessions(&set) : 0;
+            displayUpdate(&display, &set, cores, sessions);
+            if (opts->record && recorderAppend(&recorder, &set, cores, sessions) == -1) {
+                perror("Error writing recording");
+                exit(EXIT_FAILURE);
+            }
+            if (opts->daemon) shmPublish(&pub, &set, cores, sessions);
+            else controls.redraw = true;
+            alertsEvaluate(&alerts, &display.current, sessions);
+            if (adapting && due) {
+                // Only samples on the grid move the interval; a stall sample is already an extra one
+                uint64_t interval = adaptiveUpdate(&adaptive, &display.current);
+                if (interval != sched.interval) {
+                    schedAdjust(&sched, interval);
+                    controls.interval = interval;
+                    formatDuration(interval, display.every, sizeof(display.every));
+                }
+            }
+            if (samples > 0 && sched.ticks >= samples) {
+                controls.quit = true;
+            }
+            else if (due) {
+                // The next tick is an absolute deadline, so collection and rendering time do not add up
+                armTimer(timer_fd, schedPlan(&sched));
+            }
+            due = stalled = false;
         }
-        else if (pid_memory == 0){
-            close(pipe_memory[0]);
-            close(pipe_cpu[0]); close(pipe_cpu[1]); close(pipe_user[0]); close(pipe_user[1]);
-            dup2(pipe_memory[1], STDOUT_FILENO);
-            memoryStats(pipe_memory);
-            exit(EXIT_SUCCESS);
+        if (controls.retimed) {
+            controls.retimed = false;
+            schedRetime(&sched, controls.interval);
+            formatDuration(controls.interval, display.every, sizeof(display.every));
+            if (!controls.paused) armTimer(timer_fd, schedPlan(&sched));
         }
-        else{
-            pid_user = fork();
-            if (pid_user == -1){
-                perror("Fork creation failed");
-                exit(EXIT_FAILURE);
+        if (controls.relayout) {
+            // Sequential frames are appended, never redrawn in place
+            if (seq) controls.redraw = sampled;
+            else frameRedraw(&display.frame);
+        }
+        // Only the text display has anything to redraw between samples; records are written once per sample
+        if (controls.redraw && sched.ticks > 0 && (opts->format == FORMAT_TEXT || sampled) && !opts->daemon) {
+            int n = seq ? snprintf(title, sizeof(title), ">>> iteration %ld\n", sched.ticks) : 0;
+            if (samples > 0) n += snprintf(title + n, sizeof(title) - n, "Number of samples: %d -- every %s", samples, display.every);
+            else n += snprintf(title + n, sizeof(title) - n, "Number of samples: unlimited -- every %s", display.every);
+            if (controls.confirming) snprintf(title + n, sizeof(title) - n, "\nDo you want to quit? [y/n]");
+            else if (controls.paused) snprintf(title + n, sizeof(title) - n, "\nPaused -- press p to resume");
+            uint64_t start = nowNanos();
+            displayRender(&display, &set, title);
+            selfRecord(&self, STAGE_RENDER, nowNanos() - start);
+        }
+        controls.redraw = controls.relayout = false;
+        if (controls.quit) {
+            break;
+        }
+
+        int n = epoll_wait(epoll_fd, events, 8, -1);
+        if (n == -1 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int e = 0; e < n; e++) {
+            int fd = events[e].data.fd;
+            if (fd == timer_fd) {
+                uint64_t expirations;
+                if (read(timer_fd, &expirations, sizeof(expirations)) == (ssize_t) sizeof(expirations) && !controls.paused) {
+                    due = true;
+                }
             }
-            else if (pid_user == 0){
-                close(pipe_user[0]); close(pipe_cpu[0]); close(pipe_cpu[1]); close(pipe_memory[0]); close(pipe_memory[1]);
-                userOutput(pipe_user);
-                close(pipe_user[1]);
-                exit(EXIT_SUCCESS);
-            }
-            else{
-                pid_cpu = fork();
-                if (pid_cpu == -1){
-                    perror("Fork creation failed");
-                    exit(EXIT_FAILURE);
+            else if (fd != signal_fd && fd != STDIN_FILENO) {
+                // A collector's wake-up: the file stays readable, only the priority event matters
+                if (events[e].events & EPOLLERR) {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+                }
+                else if (collectorsWake(&collectors, fd) && !controls.paused && sched.ticks > 0) {
+                    stalled = true;
                 }
-                else if (pid_cpu == 0){
-                    close(pipe_cpu[0]); 
-                    close(pipe_memory[0]); close(pipe_memory[1]); close(pipe_user[0]); close(pipe_user[1]);
-                    dup2(pipe_cpu[1], STDOUT_FILENO);
-                    cpuStats(pipe_cpu);
-                    close(pipe_cpu[1]);
-                    exit(EXIT_SUCCESS);
+            }
+            else if (fd == signal_fd) {
+                struct signalfd_siginfo info;
+                if (read(signal_fd, &info, sizeof(info)) == (ssize_t) sizeof(info)) {
+                    handleSignal(&controls, (int) info.ssi_signo);
+                }
+            }
+            else {
+                char keys[64];
+                ssize_t got = read(STDIN_FILENO, keys, sizeof(keys));
+                if (got <= 0) {
+                    // The terminal went away: keep sampling without keys
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+                    controls.interactive = false;
                 }
-                else{
-                    close(pipe_memory[1]); close(pipe_cpu[1]); close(pipe_user[1]);
-                    // wait for child process to finish
-                    waitpid(pid_memory, NULL, 0);
-                    waitpid(pid_user, NULL, 0);
-                    waitpid(pid_cpu, NULL, 0);
-                    if(!seq){
-                        printf("\x1b%d", 7);
-                    }
-                    else{
-                        printf(">>> iteration %d\n",i+1);
-                    }
-                    printf("Number of samples: %d -- every %d secs\n",samples,delay); 
-                    if (sys){
-                        MemoryInfo info;
-                        ssize_t bytes = read(pipe_memory[0], &info, sizeof(info));
-                        if (bytes == -1){
-                            perror("Error reading from pipe");
-                        }
-                        memoryUsage(samples, i, info, graph, seq, &memory_previous, memory_record);
-                        close(pipe_memory[0]);
-                    }
-                    
-                    if (user){ 
-                        char buffer[1024];
-                        int bytesRead;
+                for (ssize_t k = 0; k < got; k++) {
+                    handleKey(&controls, keys[k]);
+                }
+            }
+        }
+    }
+    if (opts->record) {
+        recorderClose(&recorder);
+    }
+    if (opts->daemon) {
+        shmDestroy(&pub);
+    }
+    displayFree(&display);
+    schedReport(&sched, opts->format == FORMAT_TEXT ? stdout : stderr);
+    if (adapting) {
+        adaptiveReport(&adaptive, &self, opts->format == FORMAT_TEXT ? stdout : stderr);
+    }
+    alertsClose(&alerts, opts->format == FORMAT_TEXT ? stdout : stderr);
+    stopEngine(&engine);
+    if (opts->self_stats) {
+        selfReport(&self, &collectors, opts->format == FORMAT_TEXT ? stdout : stderr);
+    }
+    collectorsClose(&collectors);
+    freeSampleSet(&set);
+    close(timer_fd);
+    close(signal_fd);
+    close(epoll_fd);
+    restoreTerminal();
+}
+void replayinfo(const Options *opts){
+    Replay replay;
+    if (replayOpen(&replay, opts->replay) == -1) {
+        perror("Error opening recording");
+        exit(EXIT_FAILURE);
+    }
+    // Show the recording with the interval it was made with
+    if (opts->replay_from > replay.count) {
+        fprintf(stderr, "--from=%ld is past the end of %s (%ld samples)\n", opts->replay_from, opts->replay, replay.count);
+        exit(EXIT_FAILURE);
+    }
+    long shown = replay.count - opts->replay_from;
+    Options replay_opts = *opts;
+    replay_opts.interval = replay.header->interval;
+    replay_opts.per_core = 0;
+    int window = shown > 0 && shown < HISTORY_CAPACITY ? (int) shown : HISTORY_CAPACITY;
+    Display display;
+    CollectorSet collectors;
+    if (displayInit(&display, &replay_opts, window) == -1 || collectorsOpen(&collectors, &replay_opts, false) == -1) {
+        perror("Display allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    display.collectors = &collectors;
+    uint64_t start = nowNanos(), last_frame = 0, first = 0, last = 0;
+    SampleSet set = {0};
+    SampleRecord record;
+    char title[MAX_STR_LEN];
+    if (opts->replay_from > 0) {
+        // Usage of the first sample shown is taken against the one before it
+        replaySeek(&replay, opts->replay_from - 1);
+        replayNext(&replay, &record);
+        display.cpu_previous = (long int) record.cpu_tot;
+        display.cpu_idle = (long int) record.cpu_idle;
+    }
+    for (long i = opts->replay_from; replayNext(&replay, &record); i++) {
+        if (i == opts->replay_from) {
+            first = record.timestamp;
+        }
+        // Records carry their own wall-clock time, and a later run its own CPU counters
+        if (i == opts->replay_from || replay.run_start) {
+            display.writer.wall_offset = replay.wall_offset;
+        }
+        if (replay.run_start) {
+            displayRestart(&display);
+        }
+        last = record.timestamp;
+        sampleFromRecord(&record, &set);
+        displayUpdate(&display, &set, (int) record.cores, (int) record.sessions);
+        // Records are replayed as fast as they can be read; the screen is redrawn at a bounded rate
+        uint64_t now = nowNanos();
+        if (opts->format != FORMAT_TEXT || i + 1 == replay.count || now - last_frame >= REPLAY_FRAME_INTERVAL) {
+            snprintf(title, sizeof(title), "Replay of %s: sample %ld of %ld -- every %s", opts->replay, i + 1, replay.count, display.every);
+            displayRender(&display, &set, title);
+            last_frame = now;
+        }
+    }
+    uint64_t elapsed = nowNanos() - start;
+    displayFree(&display);
+    collectorsClose(&collectors);
+    fprintf(opts->format == FORMAT_TEXT ? stdout : stderr, "Replayed %ld samples covering %.0f secs in %.3f ms\n",
+            shown, (last - first) / 1e9, elapsed / 1e6);
+    replayClose(&replay);
+}
+void serveinfo(const Options *opts){
+    if (opts->interval == 0) {
+        fprintf(stderr, "--serve needs a sampling interval\n");
+        exit(EXIT_FAILURE);
+    }
+    // SIGINT and SIGTERM arrive through the loop, like everything else
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    sigprocmask(SIG_BLOCK, &stop, NULL);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int signal_fd = signalfd(-1, &stop, SFD_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (epoll_fd == -1 || signal_fd == -1 || timer_fd == -1) {
+        perror("Error setting up the server loop");
+        exit(EXIT_FAILURE);
+    }
+    struct itimerspec period = {
+        .it_interval = { (time_t) (opts->interval / 1000000000ull), (long) (opts->interval % 1000000000ull) },
+        .it_value = { (time_t) (opts->interval / 1000000000ull), (long) (opts->interval % 1000000000ull) },
+    };
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = &signal_fd };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &event);
+    event.data.ptr = &timer_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+    timerfd_settime(timer_fd, 0, &period, NULL);
 
-                        printf("--------------------------------------------\n");
-                        printf("### Sessions/users ###\n");
+    Server server;
+    if (serverOpen(&server, opts->serve, epoll_fd) == -1) {
+        perror("Error opening the metrics socket");
+        exit(EXIT_FAILURE);
+    }
+    SampleEngine engine;
+    SampleSet set = {0};
+    if (startEngine(&engine, opts->engine, true, true) == -1) {
+        perror("Collector start failed");
+        exit(EXIT_FAILURE);
+    }
+    char every[32];
+    formatDuration(opts->interval, every, sizeof(every));
+    printf("Serving metrics on %s, sampled every %s\n", opts->serve, every);
+    fflush(stdout);
 
-                        while ((bytesRead = read(pipe_user[0], buffer, sizeof(buffer) - 1)) > 0) {
-                            buffer[bytesRead] = '\0';
-                            printf("%s", buffer);
-                        }
-                        //close it!
-                        close(pipe_user[0]);
-                    }
-                    
-                    if (sys){
-                        CPU cpu_stats;
-                        ssize_t bytes = read(pipe_cpu[0], &cpu_stats, sizeof(cpu_stats));
-                        if (bytes== -1){ 
-                            perror("Error reading from pipe"); 
-                        }
-                        cpu_output(graph, i, &cpu_previous, &cpu_idle, cpu_stats, cpu_record);
-                        close(pipe_cpu[0]);
-                    }
-                    if (i+1 < samples) { 
-                        sleep(delay); 
-                    }
-                    if(!seq && i + 1 < samples){
-                        printf("\x1b%d", 8);
-                    }
+    CPU previous = {0, 0};
+    long samples = 0, missed = 0;
+    bool running = true, due = true;
+    struct epoll_event events[64];
+    while (running) {
+        if (due) {
+            // Sample right away at start, then on every timer tick
+            set.timestamp = nowNanos();
+            double uptime = 0;
+            if (engineSample(&engine, &set) == -1 || readUptime(&uptime) == -1) {
+                perror("Sampling failed");
+                exit(EXIT_FAILURE);
+            }
+            double usage = sysstats_cpu_usage(&previous, &set.cpu.total);
+            previous = set.cpu.total;
+            serverPublish(&server, &set, count_cores(), countSessions(&set), uptime, usage);
+            serverExpire(&server, set.timestamp);
+            due = false;
+            if (opts->samples > 0 && ++samples >= opts->samples) {
+                break;
+            }
+        }
+        int n = epoll_wait(epoll_fd, events, 64, -1);
+        if (n == -1 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int e = 0; e < n; e++) {
+            void *tag = events[e].data.ptr;
+            if (tag == &timer_fd) {
+                uint64_t ticks;
+                if (read(timer_fd, &ticks, sizeof(ticks)) == (ssize_t) sizeof(ticks)) {
+                    missed += (long) ticks - 1;
+                    due = true;
                 }
             }
+            else if (tag == &signal_fd) {
+                struct signalfd_siginfo info;
+                if (read(signal_fd, &info, sizeof(info)) == (ssize_t) sizeof(info)) running = false;
+            }
+            else {
+                serverEvent(&server, tag, events[e].events);
+            }
         }
     }
+    printf("Served %ld scrapes over %ld connections (peak %ld at once, %ld timed out) from %ld samples, %ld missed ticks\n",
+           server.scrapes, server.connections, server.peak, server.expired, server.samples, missed);
+    serverClose(&server);
+    stopEngine(&engine);
+    freeSampleSet(&set);
+    close(timer_fd);
+    close(signal_fd);
+    close(epoll_fd);
+}
+void attachinfo(const Options *opts){
+    ShmReader reader;
+    if (shmAttach(&reader, opts->attach) == -1) {
+        perror("Error attaching to shared memory");
+        exit(EXIT_FAILURE);
+    }
+    // Follow the daemon at the interval it samples with
+    Options attach_opts = *opts;
+    attach_opts.interval = reader.segment->interval;
+    attach_opts.per_core = 0;
+    int samples = opts->samples;
+    int window = (samples > 0 && samples < HISTORY_CAPACITY) ? samples : HISTORY_CAPACITY;
+    Display display;
+    CollectorSet collectors;
+    if (displayInit(&display, &attach_opts, window) == -1 || collectorsOpen(&collectors, &attach_opts, false) == -1) {
+        perror("Display allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    display.collectors = &collectors;
+    Scheduler sched;
+    schedStart(&sched, attach_opts.interval);
+    SampleSet set = {0};
+    SampleRecord record;
+    char title[MAX_STR_LEN];
+    long frames = 0, read = 0;
+    while (samples == 0 || frames < samples) {
+        schedNext(&sched);
+        bool fresh = false;
+        while (shmRead(&reader, &record)) {
+            if (read++ == 0) {
+                display.writer.wall_offset = record.wall_time - (int64_t) record.timestamp;
+            }
+            sampleFromRecord(&record, &set);
+            displayUpdate(&display, &set, (int) record.cores, (int) record.sessions);
+            fresh = true;
+            // Every sample is written in the machine-readable formats
+            if (opts->format != FORMAT_TEXT) displayRender(&display, &set, NULL);
+        }
+        if (!fresh) {
+            if (!shmAlive(&reader)) {
+                break;
+            }
+            continue;
+        }
+        if (opts->format == FORMAT_TEXT) {
+            snprintf(title, sizeof(title), "Attached to %s (pid %d): sample %" PRIu64 " -- every %s",
+                     opts->attach, (int) reader.segment->pid, reader.next, display.every);
+            displayRender(&display, &set, title);
+        }
+        frames++;
+    }
+    displayFree(&display);
+    collectorsClose(&collectors);
+    fprintf(opts->format == FORMAT_TEXT ? stdout : stderr, "Read %ld samples from %s, %" PRIu64 " dropped\n",
+            read, opts->attach, reader.dropped);
+    shmDetach(&reader);
 }
 int main(int argc, char **argv){
-   int samples = 10;
-   int delay = 1;
-   bool seq = false;
-   bool system = false;
-   bool user = false;
-   bool graph = false;
-   if(!parseargument(argc, argv, &samples, &delay, &seq, &system, &user, &graph)){
+   Options opts = {
+       .samples = 10,
+       .interval = 1000000000ull,
+       .engine = ENGINE_PROCESS,
+       .resolution = -1,
+   };
+   if(!parseargument(argc, argv, &opts)){
     printf("Incorrect argument\n");
     return 1;
    }
-   printinfo(samples,delay,seq,system,user, graph);
-   systemInfo();
+   if (opts.proc_root && procSetRoot(opts.proc_root) == -1) {
+       perror("Error setting the proc root");
+       return 1;
+   }
+   if (opts.capture) {
+       if (captureHost(opts.capture, opts.synth_cores, opts.synth_sessions) == -1) {
+           perror("Error capturing the host");
+           return 1;
+       }
+       return 0;
+   }
+   if (opts.bench) {
+       if (strcmp(opts.bench, "engines") == 0) benchEngines(&opts);
+       else if (strcmp(opts.bench, "parse") == 0) benchParsers(&opts);
+       else if (strcmp(opts.bench, "codec") == 0) benchCodec(&opts);
+       else if (strcmp(opts.bench, "library") == 0) benchLibrary(&opts);
+       else if (strcmp(opts.bench, "serve") == 0) benchServe(&opts);
+       else if (strcmp(opts.bench, "top") == 0) benchTop(&opts);
+       else {
+           printf("Incorrect argument\n");
+           return 1;
+       }
+       return 0;
+   }
+   // Rather than run a collector whose values would go nowhere
+   const char *unshown = collectorsUnshown(&opts);
+   if (unshown) {
+       fprintf(stderr, "%s is only shown by the live text display; it cannot be used with --format=jsonl|csv, --daemon, --serve, --replay or --attach\n", unshown);
+       return 1;
+   }
+   if (opts.replay) {
+       replayinfo(&opts);
+       return 0;
+   }
+   if (opts.attach) {
+       attachinfo(&opts);
+       return 0;
+   }
+   if (opts.serve) {
+       serveinfo(&opts);
+       return 0;
+   }
+   printinfo(&opts);
+   if (opts.format == FORMAT_TEXT) {
+       systemInfo();
+   }
    return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,118 @@
+#include "header.h"
+
+/**
+ * Returns the growth of a counter, or 0 if it went back (the interface was recreated).
+ */
+static uint64_t counterDelta(uint64_t now, uint64_t before) {
+    return now >= before ? now - before : 0;
+}
+
+/**
+ * Finds an interface of the previous sample by name; interfaces usually keep their line.
+ */
+static int findPrevious(const NetStats *net, int i) {
+    if (i < net->previous_count && strcmp(net->previous[i].name, net->current[i].name) == 0) {
+        return i;
+    }
+    for (int j = 0; j < net->previous_count; j++) {
+        if (strcmp(net->previous[j].name, net->current[i].name) == 0) return j;
+    }
+    return -1;
+}
+
+/**
+ * Counts the lines of a file read into memory; a last line without a newline counts too.
+ */
+static int countLines(const char *p) {
+    int lines = 0;
+    for (; *p; p = scanNextLine(p)) lines++;
+    return lines;
+}
+
+/**
+ * Makes room for `count` interfaces in every array, keeping the entries already there.
+ */
+static int netReserve(NetStats *net, int count) {
+    if (count <= net->cap) {
+        return 0;
+    }
+    int cap = net->cap > 0 ? net->cap : NET_MAX_INTERFACES;
+    while (cap < count) cap *= 2;
+    NetCounters *current = realloc(net->current, (size_t) cap * sizeof(*current));
+    if (!current) return -1;
+    net->current = current;
+    NetCounters *previous = realloc(net->previous, (size_t) cap * sizeof(*previous));
+    if (!previous) return -1;
+    net->previous = previous;
+    NetRates *rates = realloc(net->rates, (size_t) cap * sizeof(*rates));
+    if (!rates) return -1;
+    net->rates = rates;
+    net->cap = cap;
+    return 0;
+}
+
+int netOpen(NetStats *net) {
+    memset(net, 0, sizeof(*net));
+    return procOpen(&net->file, "/proc/net/dev", PROC_NETDEV_SIZE);
+}
+
+int netSample(NetStats *net) {
+    // The last sample becomes the previous one, and the new one is read over the one before
+    NetCounters *counters = net->previous;
+    net->previous = net->current;
+    net->current = counters;
+    net->previous_count = net->count;
+    int count;
+    // Every line after the two header lines is an interface
+    if (procRead(&net->file) == -1 || netReserve(net, countLines(net->file.buf) - 2) == -1 ||
+        (count = parseNetdev(net->file.buf, net->current, net->cap)) == -1) {
+        net->count = 0;
+        return -1;
+    }
+    net->count = count;
+    net->samples++;
+    return 0;
+}
+
+void netDelta(NetStats *net, uint64_t elapsed) {
+    double seconds = elapsed / 1e9;
+    for (int i = 0; i < net->count; i++) {
+        NetRates *rates = &net->rates[i];
+        memset(rates, 0, sizeof(*rates));
+        int j = findPrevious(net, i);
+        if (j < 0 || seconds <= 0) {
+            continue;
+        }
+        const NetCounters *now = &net->current[i], *before = &net->previous[j];
+        rates->rx_bytes = counterDelta(now->rx_bytes, before->rx_bytes) / seconds;
+        rates->rx_packets = counterDelta(now->rx_packets, before->rx_packets) / seconds;
+        rates->tx_bytes = counterDelta(now->tx_bytes, before->tx_bytes) / seconds;
+        rates->tx_packets = counterDelta(now->tx_packets, before->tx_packets) / seconds;
+    }
+}
+
+void netClose(NetStats *net) {
+    procClose(&net->file);
+    free(net->current);
+    free(net->previous);
+    free(net->rates);
+    net->current = net->previous = NULL;
+    net->rates = NULL;
+    net->cap = net->count = net->previous_count = 0;
+}
+
+void netOutput(Frame *frame, const NetStats *net) {
+    framePrintf(frame, "--------------------------------------------\n");
+    framePrintf(frame, "### Network ### (per second since the last sample)\n");
+    framePrintf(frame, "%-12s %11s %11s %11s %11s\n", "interface", "rx KB", "rx packets", "tx KB", "tx packets");
+    for (int i = 0; i < net->count; i++) {
+        const NetCounters *counters = &net->current[i];
+        // Interfaces that never carried a packet are left out
+        if (counters->rx_packets + counters->tx_packets == 0) {
+            continue;
+        }
+        const NetRates *rates = &net->rates[i];
+        framePrintf(frame, "%-12s %11.1f %11.1f %11.1f %11.1f\n", counters->name, rates->rx_bytes / 1e3, rates->rx_packets,
+                    rates->tx_bytes / 1e3, rates->tx_packets);
+    }
+}
@@ -0,0 +1,87 @@
+#include "header.h"
+
+int writerInit(RecordWriter *writer, OutputFormat format, int fd) {
+    memset(writer, 0, sizeof(*writer));
+    writer->buf = malloc(OUTPUT_BUFFER_SIZE);
+    if (!writer->buf) {
+        return -1;
+    }
+    writer->cap = OUTPUT_BUFFER_SIZE;
+    writer->format = format;
+    writer->fd = fd;
+
+    // Wall-clock time of a sample is derived from its monotonic timestamp with a fixed offset
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    uint64_t mono = nowNanos();
+    writer->wall_offset = (int64_t) ((uint64_t) real.tv_sec * 1000000000ull + (uint64_t) real.tv_nsec) - (int64_t) mono;
+    writer->last_flush = mono;
+
+    if (format == FORMAT_CSV) {
+        writer->len = (size_t) snprintf(writer->buf, writer->cap,
+            "time,mono_ns,used_memory_gb,total_memory_gb,used_virtual_gb,total_virtual_gb,cpu_usage,cores,sessions,"
+            "available_gb,cached_gb,buffers_gb,dirty_gb,writeback_gb,anon_pages_gb,slab_gb,huge_total_gb,huge_free_gb\n");
+    }
+    return 0;
+}
+
+void writerRecord(RecordWriter *writer, const HistorySample *sample, int cores, int sessions) {
+    if (writer->cap - writer->len < OUTPUT_RECORD_MAX) {
+        writerFlush(writer);
+    }
+    double wall = (double) ((int64_t) sample->timestamp + writer->wall_offset) / 1e9;
+    const MemoryInfo *m = &sample->memory;
+    char *p = writer->buf + writer->len;
+    size_t room = writer->cap - writer->len;
+    int n;
+    if (writer->format == FORMAT_JSONL) {
+        n = snprintf(p, room,
+            "{\"time\":%.3f,\"mono_ns\":%llu,\"used_memory_gb\":%.6f,\"total_memory_gb\":%.6f,"
+            "\"used_virtual_gb\":%.6f,\"total_virtual_gb\":%.6f,\"cpu_usage\":%.2f,\"cores\":%d,\"sessions\":%d,"
+            "\"available_gb\":%.6f,\"cached_gb\":%.6f,\"buffers_gb\":%.6f,\"dirty_gb\":%.6f,\"writeback_gb\":%.6f,"
+            "\"anon_pages_gb\":%.6f,\"slab_gb\":%.6f,\"huge_total_gb\":%.6f,\"huge_free_gb\":%.6f}\n",
+            wall, (unsigned long long) sample->timestamp, m->used_memory, m->total_memory,
+            m->used_virtual, m->total_virtual, sample->cpu_usage, cores, sessions,
+            m->available, m->cached, m->buffers, m->dirty, m->writeback, m->anon_pages, m->slab, m->huge_total, m->huge_free);
+    }
+    else {
+        n = snprintf(p, room, "%.3f,%llu,%.6f,%.6f,%.6f,%.6f,%.2f,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+            wall, (unsigned long long) sample->timestamp, m->used_memory, m->total_memory,
+            m->used_virtual, m->total_virtual, sample->cpu_usage, cores, sessions,
+            m->available, m->cached, m->buffers, m->dirty, m->writeback, m->anon_pages, m->slab, m->huge_total, m->huge_free);
+    }
+    if (n > 0 && (size_t) n < room) {
+        writer->len += (size_t) n;
+        writer->records++;
+    }
+    // Flush in batches: when the buffer is nearly full or a batch has waited long enough
+    if (writer->cap - writer->len < OUTPUT_RECORD_MAX || sample->timestamp - writer->last_flush >= OUTPUT_FLUSH_INTERVAL) {
+        writerFlush(writer);
+    }
+}
+
+int writerFlush(RecordWriter *writer) {
+    writer->last_flush = nowNanos();
+    if (writer->len == 0) {
+        return 0;
+    }
+    int status = writeFull(writer->fd, writer->buf, writer->len);
+    writer->len = 0;
+    writer->flushes++;
+    return status;
+}
+
+void writerFree(RecordWriter *writer) {
+    writerFlush(writer);
+    free(writer->buf);
+    writer->buf = NULL;
+}
+
+int countSessions(const SampleSet *set) {
+    int sessions = 0;
+    const char *end = set->sessions + set->sessions_len;
+    for (const char *p = set->sessions; p && p < end && (p = memchr(p, '\n', end - p)); p++) {
+        sessions++;
+    }
+    return sessions;
+}
@@ -0,0 +1,122 @@
+#define _GNU_SOURCE
+#include "header.h"
+#include <fcntl.h>
+
+static const char *pressurePaths[PRESSURE_RESOURCES] = {
+    "/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io"
+};
+static const char *pressureNames[PRESSURE_RESOURCES] = { "cpu", "memory", "io" };
+
+int pressureOpen(Pressure *pressure) {
+    memset(pressure, 0, sizeof(*pressure));
+    for (int r = 0; r < PRESSURE_RESOURCES; r++) {
+        pressure->files[r].fd = -1;
+        pressure->triggers[r] = -1;
+    }
+    if (procOpen(&pressure->loadavg, "/proc/loadavg", PROC_PRESSURE_SIZE) == -1) {
+        return -1;
+    }
+    // Without CONFIG_PSI, or with psi=0, only the load average is shown
+    pressure->available = true;
+    for (int r = 0; r < PRESSURE_RESOURCES; r++) {
+        if (procOpen(&pressure->files[r], pressurePaths[r], PROC_PRESSURE_SIZE) == -1) {
+            pressure->available = false;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Closes the trigger descriptors, so that a failed setup leaves none behind.
+ */
+static void closeTriggers(Pressure *pressure) {
+    for (int r = 0; r < PRESSURE_RESOURCES; r++) {
+        if (pressure->triggers[r] != -1) {
+            close(pressure->triggers[r]);
+            pressure->triggers[r] = -1;
+        }
+    }
+}
+
+int pressureTrigger(Pressure *pressure, uint64_t stall, uint64_t window) {
+    if (!pressure->available) {
+        errno = ENOTSUP;
+        return -1;
+    }
+    char trigger[64];
+    int len = snprintf(trigger, sizeof(trigger), "some %" PRIu64 " %" PRIu64, stall / 1000, window / 1000);
+    for (int r = 0; r < PRESSURE_RESOURCES; r++) {
+        // A trigger lives as long as the descriptor it was written to
+        char path[PROC_PATH_LEN];
+        const char *file = procPath(pressurePaths[r], path, sizeof(path));
+        int fd = file ? open(file, O_RDWR | O_NONBLOCK | O_CLOEXEC) : -1;
+        if (fd != -1) {
+            pressure->triggers[r] = fd;
+        }
+        if (fd == -1 || write(fd, trigger, (size_t) len + 1) == -1) {
+            int saved = errno;
+            closeTriggers(pressure);
+            errno = saved;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int pressureSample(Pressure *pressure, uint64_t timestamp) {
+    if (procRead(&pressure->loadavg) == -1 || parseLoadavg(pressure->loadavg.buf, &pressure->load) == -1) {
+        return -1;
+    }
+    pressure->elapsed = pressure->samples > 0 ? timestamp - pressure->timestamp : 0;
+    pressure->timestamp = timestamp;
+    pressure->samples++;
+    if (!pressure->available) {
+        return 0;
+    }
+    for (int r = 0; r < PRESSURE_RESOURCES; r++) {
+        PressureStat *stat = &pressure->stats[r];
+        uint64_t some = stat->some.total, full = stat->full.total;
+        int lines;
+        if (procRead(&pressure->files[r]) == -1 || (lines = parsePressure(pressure->files[r].buf, &stat->some, &stat->full)) == -1) {
+            return -1;
+        }
+        stat->has_full = lines == 1;
+        // The totals are in microseconds; the averages only move every two seconds
+        stat->some_delta = pressure->samples > 1 ? stat->some.total - some : 0;
+        stat->full_delta = pressure->samples > 1 && stat->has_full ? stat->full.total - full : 0;
+    }
+    return 0;
+}
+
+void pressureClose(Pressure *pressure) {
+    closeTriggers(pressure);
+    for (int r = 0; r < PRESSURE_RESOURCES; r++) {
+        procClose(&pressure->files[r]);
+    }
+    procClose(&pressure->loadavg);
+}
+
+void pressureOutput(Frame *frame, const Pressure *pressure) {
+    const LoadAvg *load = &pressure->load;
+    framePrintf(frame, "--------------------------------------------\n");
+    framePrintf(frame, "### Pressure ### (stalled time since the last sample, then avg10/avg60)\n");
+    framePrintf(frame, "Load: %.2f %.2f %.2f -- %d running of %d tasks\n", load->load1, load->load5, load->load15, load->running, load->tasks);
+    if (!pressure->available) {
+        framePrintf(frame, "Pressure stall information is not available\n");
+        return;
+    }
+    double elapsed_us = pressure->elapsed / 1e3;
+    for (int r = 0; r < PRESSURE_RESOURCES; r++) {
+        const PressureStat *stat = &pressure->stats[r];
+        framePrintf(frame, "%-7s some %9.1f ms %5.1f%% (%.2f/%.2f)", pressureNames[r], stat->some_delta / 1e3,
+                    elapsed_us > 0 ? 100.0 * stat->some_delta / elapsed_us : 0.0, stat->some.avg10, stat->some.avg60);
+        if (stat->has_full) {
+            framePrintf(frame, "  full %9.1f ms %5.1f%% (%.2f/%.2f)", stat->full_delta / 1e3,
+                        elapsed_us > 0 ? 100.0 * stat->full_delta / elapsed_us : 0.0, stat->full.avg10, stat->full.avg60);
+        }
+        framePrintf(frame, "\n");
+    }
+    if (pressure->triggered > 0) {
+        framePrintf(frame, "Woken by a stall trigger %ld times\n", pressure->triggered);
+    }
+}
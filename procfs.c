@@ -0,0 +1,517 @@
+#define _GNU_SOURCE
+#include "procfs.h"
+#include <fcntl.h>
+
+// Empty while the collectors read the live system
+static char procRoot[PROC_ROOT_LEN];
+
+int procSetRoot(const char *root) {
+    size_t len = root ? strlen(root) : 0;
+    // A trailing slash would double the one every absolute path starts with
+    while (len > 1 && root[len - 1] == '/') len--;
+    if (len >= sizeof(procRoot)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(procRoot, root ? root : "", len);
+    procRoot[len] = '\0';
+    // "/" is the live system
+    if (strcmp(procRoot, "/") == 0) procRoot[0] = '\0';
+    return 0;
+}
+
+bool procRooted(void) {
+    return procRoot[0] != '\0';
+}
+
+const char *procPath(const char *path, char *buf, size_t len) {
+    if (!procRoot[0] || path[0] != '/') {
+        return path;
+    }
+    if ((size_t) snprintf(buf, len, "%s%s", procRoot, path) >= len) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    return buf;
+}
+
+int procOpen(ProcFile *file, const char *path, size_t cap) {
+    char rooted[PROC_PATH_LEN];
+    if (!(path = procPath(path, rooted, sizeof(rooted)))) {
+        file->fd = -1;
+        file->buf = NULL;
+        return -1;
+    }
+    file->len = 0;
+    file->buf = malloc(cap);
+    if (!file->buf) {
+        file->fd = -1;
+        return -1;
+    }
+    file->cap = cap;
+    file->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (file->fd == -1) {
+        free(file->buf);
+        file->buf = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int procRead(ProcFile *file) {
+    size_t len = 0;
+    for (;;) {
+        // Keep one byte for the terminating NUL
+        if (file->cap - len <= 1) {
+            // The file outgrew the buffer; grow it once and keep it for the next reads
+            char *grown = realloc(file->buf, file->cap * 2);
+            if (!grown) {
+                return -1;
+            }
+            file->buf = grown;
+            file->cap *= 2;
+        }
+        ssize_t n = pread(file->fd, file->buf + len, file->cap - len - 1, (off_t) len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        len += n;
+    }
+    file->buf[len] = '\0';
+    file->len = len;
+    return 0;
+}
+
+void procClose(ProcFile *file) {
+    if (file->fd != -1) {
+        close(file->fd);
+    }
+    free(file->buf);
+    file->fd = -1;
+    file->buf = NULL;
+    file->cap = 0;
+    file->len = 0;
+}
+
+const char *scanSpaces(const char *p) {
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    return p;
+}
+
+const char *scanU64(const char *p, uint64_t *value) {
+    p = scanSpaces(p);
+    if (*p < '0' || *p > '9') {
+        return NULL;
+    }
+    uint64_t v = 0;
+    while (*p >= '0' && *p <= '9') {
+        v = v * 10 + (uint64_t) (*p - '0');
+        p++;
+    }
+    *value = v;
+    return p;
+}
+
+const char *scanNextLine(const char *p) {
+    const char *nl = strchr(p, '\n');
+    return nl ? nl + 1 : p + strlen(p);
+}
+
+int parseCpuStats(const char *buf, SysStatsCpu *cpu_stats) {
+    if (strncmp(buf, "cpu ", 4) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    // user, nice, system, idle, iowait, irq, softirq
+    uint64_t field[7];
+    const char *p = buf + 4;
+    for (int k = 0; k < 7; k++) {
+        if (!(p = scanU64(p, &field[k]))) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    cpu_stats->tot = (long int) (field[0] + field[1] + field[2] + field[4] + field[5] + field[6]);
+    cpu_stats->time = (long int) field[3];
+    return 0;
+}
+
+int parseCpuCores(const char *buf, SysStatsCpuSample *cpu_stats) {
+    if (parseCpuStats(buf, &cpu_stats->total) == -1) {
+        return -1;
+    }
+    cpu_stats->ncores = 0;
+    // The per-core lines follow the aggregate line directly
+    for (const char *p = scanNextLine(buf); strncmp(p, "cpu", 3) == 0; p = scanNextLine(p)) {
+        uint64_t core, field[7];
+        const char *q = scanU64(p + 3, &core);
+        if (!q || core >= SYSSTATS_MAX_CORES) {
+            continue;
+        }
+        int k;
+        for (k = 0; k < 7 && (q = scanU64(q, &field[k])); k++);
+        if (k < 7) {
+            continue;
+        }
+        // Clear cores skipped because they are offline
+        while (cpu_stats->ncores < (int) core) {
+            cpu_stats->cores[cpu_stats->ncores].tot = 0;
+            cpu_stats->cores[cpu_stats->ncores].time = 0;
+            cpu_stats->ncores++;
+        }
+        cpu_stats->cores[core].tot = (long int) (field[0] + field[1] + field[2] + field[4] + field[5] + field[6]);
+        cpu_stats->cores[core].time = (long int) field[3];
+        cpu_stats->ncores = (int) core + 1;
+    }
+    return 0;
+}
+
+int parseCoreCount(const char *buf) {
+    int cores = 0;
+    for (const char *p = buf; *p; p = scanNextLine(p)) {
+        if (strncmp(p, "processor", 9) == 0) {
+            cores++;
+        }
+    }
+    return cores;
+}
+
+int parseUptime(const char *buf, double *seconds) {
+    uint64_t whole, frac = 0;
+    const char *p = scanU64(buf, &whole);
+    if (!p) {
+        errno = EINVAL;
+        return -1;
+    }
+    double scale = 1.0;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            frac = frac * 10 + (uint64_t) (*p - '0');
+            scale *= 10.0;
+            p++;
+        }
+    }
+    *seconds = (double) whole + (double) frac / scale;
+    return 0;
+}
+
+/**
+ * Skips `count` space-separated fields.
+ */
+static const char *skipFields(const char *p, int count) {
+    while (count-- > 0) {
+        p = scanSpaces(p);
+        while (*p && *p != ' ' && *p != '\n') p++;
+    }
+    return p;
+}
+
+int parsePidStat(const char *buf, ProcSample *proc) {
+    // The command name is in parentheses and may itself contain spaces and parentheses
+    const char *open = strchr(buf, '(');
+    const char *close = strrchr(buf, ')');
+    if (!open || !close || close < open) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t len = (size_t) (close - open - 1);
+    if (len >= sizeof(proc->comm)) len = sizeof(proc->comm) - 1;
+    memcpy(proc->comm, open + 1, len);
+    proc->comm[len] = '\0';
+
+    // Fields 3 (state) to 13 come first; some of them can be negative
+    uint64_t utime, stime;
+    const char *p = skipFields(close + 1, 11);
+    if (!(p = scanU64(p, &utime)) || !(p = scanU64(p, &stime))) {
+        errno = EINVAL;
+        return -1;
+    }
+    // Then fields 16 to 21, up to the start time
+    if (!(p = scanU64(skipFields(p, 6), &proc->starttime))) {
+        errno = EINVAL;
+        return -1;
+    }
+    proc->ticks = utime + stime;
+    return 0;
+}
+
+int parsePidStatm(const char *buf, uint64_t *rss_pages) {
+    uint64_t size;
+    const char *p = scanU64(buf, &size);
+    if (!p || !scanU64(p, rss_pages)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+// Keys of the /proc/meminfo lines we read, in MeminfoField order
+static const struct {
+    const char *key;
+    size_t len;
+} meminfoKeys[MEMINFO_FIELDS] = {
+    { "MemTotal", 8 }, { "MemFree", 7 }, { "MemAvailable", 12 }, { "Buffers", 7 },
+    { "Cached", 6 }, { "SwapTotal", 9 }, { "SwapFree", 8 }, { "Dirty", 5 },
+    { "Writeback", 9 }, { "AnonPages", 9 }, { "Slab", 4 }, { "HugePages_Total", 15 },
+    { "HugePages_Free", 14 }, { "Hugepagesize", 12 },
+};
+
+/**
+ * Finds the line of every key by name. Keys missing from this kernel get no offset.
+ */
+static void buildMeminfoIndex(const char *buf, MeminfoIndex *index) {
+    for (int f = 0; f < MEMINFO_FIELDS; f++) {
+        index->offset[f] = MEMINFO_MISSING;
+    }
+    for (const char *p = buf; *p; p = scanNextLine(p)) {
+        const char *colon = strchr(p, ':');
+        if (!colon) {
+            break;
+        }
+        size_t len = (size_t) (colon - p);
+        for (int f = 0; f < MEMINFO_FIELDS; f++) {
+            if (meminfoKeys[f].len == len && memcmp(p, meminfoKeys[f].key, len) == 0) {
+                index->offset[f] = (size_t) (p - buf);
+                break;
+            }
+        }
+    }
+    index->built = true;
+    index->rebuilds++;
+}
+
+/**
+ * Reads every indexed value; fails if a key is no longer where the index expects it. A key
+ * must also start its line, or "Cached" could be matched inside a "SwapCached" line that moved there.
+ */
+static bool readMeminfoIndexed(const char *buf, size_t len, const MeminfoIndex *index, uint64_t *values) {
+    for (int f = 0; f < MEMINFO_FIELDS; f++) {
+        size_t offset = index->offset[f];
+        values[f] = 0;
+        if (offset == MEMINFO_MISSING) {
+            continue;
+        }
+        size_t key_len = meminfoKeys[f].len;
+        if (offset + key_len >= len || (offset > 0 && buf[offset - 1] != '\n') || buf[offset + key_len] != ':' ||
+            memcmp(buf + offset, meminfoKeys[f].key, key_len) != 0) {
+            return false;
+        }
+        if (!scanU64(buf + offset + key_len + 1, &values[f])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int parseMeminfo(const char *buf, size_t len, MeminfoIndex *index, uint64_t *values) {
+    // The lines only move when a value outgrows its padding, so the offsets of the first read almost always hold
+    if (index->built && readMeminfoIndexed(buf, len, index, values)) {
+        return 0;
+    }
+    buildMeminfoIndex(buf, index);
+    if (!readMeminfoIndexed(buf, len, index, values) || index->offset[MEMINFO_TOTAL] == MEMINFO_MISSING) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Parses a decimal number with an optional fraction, like the PSI averages.
+ */
+static const char *scanDecimal(const char *p, double *value) {
+    uint64_t whole, frac = 0;
+    if (!(p = scanU64(p, &whole))) {
+        return NULL;
+    }
+    double scale = 1.0;
+    if (*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++) {
+            frac = frac * 10 + (uint64_t) (*p - '0');
+            scale *= 10.0;
+        }
+    }
+    *value = (double) whole + (double) frac / scale;
+    return p;
+}
+
+/**
+ * Parses one "some" or "full" line of a pressure file, after its first word.
+ */
+static const char *parsePressureLine(const char *p, PressureLine *line) {
+    static const char *keys[] = { " avg10=", " avg60=", " avg300=", " total=" };
+    double *averages[] = { &line->avg10, &line->avg60, &line->avg300 };
+    for (int k = 0; k < 4; k++) {
+        size_t len = strlen(keys[k]);
+        if (strncmp(p, keys[k], len) != 0) {
+            return NULL;
+        }
+        p += len;
+        if (!(p = k < 3 ? scanDecimal(p, averages[k]) : scanU64(p, &line->total))) {
+            return NULL;
+        }
+    }
+    return p;
+}
+
+int parsePressure(const char *buf, PressureLine *some, PressureLine *full) {
+    if (strncmp(buf, "some", 4) != 0 || !parsePressureLine(buf + 4, some)) {
+        errno = EINVAL;
+        return -1;
+    }
+    // Kernels before 5.13 have no "full" line for the CPU
+    const char *p = scanNextLine(buf);
+    if (strncmp(p, "full", 4) != 0) {
+        return 0;
+    }
+    if (!parsePressureLine(p + 4, full)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 1;
+}
+
+int parseLoadavg(const char *buf, LoadAvg *load) {
+    uint64_t running, tasks;
+    const char *p = buf;
+    if (!(p = scanDecimal(p, &load->load1)) || !(p = scanDecimal(p, &load->load5)) ||
+        !(p = scanDecimal(p, &load->load15)) || !(p = scanU64(p, &running)) || *p != '/' ||
+        !scanU64(p + 1, &tasks)) {
+        errno = EINVAL;
+        return -1;
+    }
+    load->running = (int) running;
+    load->tasks = (int) tasks;
+    return 0;
+}
+
+/**
+ * Copies a device name up to the first space, tab, colon or end of line, truncating it to fit.
+ */
+static const char *scanName(const char *p, char *name, size_t cap) {
+    p = scanSpaces(p);
+    size_t len = 0;
+    for (; *p && *p != ' ' && *p != '\t' && *p != ':' && *p != '\n'; p++) {
+        if (len + 1 < cap) name[len++] = *p;
+    }
+    name[len] = '\0';
+    return len > 0 ? p : NULL;
+}
+
+int parseDiskstats(const char *buf, DiskCounters *devices, int cap) {
+    int count = 0;
+    for (const char *p = buf; *p && count < cap; p = scanNextLine(p)) {
+        DiskCounters *disk = &devices[count];
+        // major, minor, name, then reads, reads merged, sectors read, ms reading, and the same for writes
+        uint64_t major, minor, field[10];
+        const char *q = scanU64(p, &major);
+        if (!q || !(q = scanU64(q, &minor)) || !(q = scanName(q, disk->name, sizeof(disk->name)))) {
+            errno = EINVAL;
+            return -1;
+        }
+        int k;
+        for (k = 0; k < 10 && (q = scanU64(q, &field[k])); k++);
+        if (k < 10) {
+            errno = EINVAL;
+            return -1;
+        }
+        disk->reads = field[0];
+        disk->read_sectors = field[2];
+        disk->read_ms = field[3];
+        disk->writes = field[4];
+        disk->write_sectors = field[6];
+        disk->write_ms = field[7];
+        disk->io_ms = field[9];
+        count++;
+    }
+    return count;
+}
+
+int parseNetdev(const char *buf, NetCounters *interfaces, int cap) {
+    // Two header lines come before the interfaces
+    const char *p = scanNextLine(scanNextLine(buf));
+    int count = 0;
+    for (; *p && count < cap; p = scanNextLine(p)) {
+        NetCounters *net = &interfaces[count];
+        // Large counters run into the colon after the name, so it ends the name too
+        const char *q = scanName(p, net->name, sizeof(net->name));
+        if (!q || *q != ':') {
+            errno = EINVAL;
+            return -1;
+        }
+        // Eight receive fields, then eight transmit fields, bytes and packets first in each
+        uint64_t field[10];
+        int k;
+        for (k = 0, q++; k < 10 && (q = scanU64(q, &field[k])); k++);
+        if (k < 10) {
+            errno = EINVAL;
+            return -1;
+        }
+        net->rx_bytes = field[0];
+        net->rx_packets = field[1];
+        net->tx_bytes = field[8];
+        net->tx_packets = field[9];
+        count++;
+    }
+    return count;
+}
+
+int parseFlatKeyed(const char *buf, const char *const *keys, int count, uint64_t *values) {
+    int found = 0;
+    for (const char *p = buf; *p && found < count; p = scanNextLine(p)) {
+        size_t len = strcspn(p, " \n");
+        if (p[len] != ' ') {
+            continue;
+        }
+        for (int k = 0; k < count; k++) {
+            if (strlen(keys[k]) == len && strncmp(p, keys[k], len) == 0) {
+                if (!scanU64(p + len, &values[k])) {
+                    errno = EINVAL;
+                    return -1;
+                }
+                found++;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+int parseCgroupLimit(const char *buf, uint64_t *limit, uint64_t *second) {
+    const char *p = scanSpaces(buf);
+    if (strncmp(p, "max", 3) == 0) {
+        *limit = CGROUP_UNLIMITED;
+        p += 3;
+    }
+    else if (!(p = scanU64(p, limit))) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (second && !scanU64(p, second)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int parseSelfCgroup(const char *buf, char *path, size_t len) {
+    for (const char *p = buf; *p; p = scanNextLine(p)) {
+        // cgroup v1 hierarchies have an id and controllers; the unified one is "0::"
+        if (strncmp(p, "0::", 3) == 0) {
+            size_t n = strcspn(p + 3, "\n");
+            if (n >= len) n = len - 1;
+            memcpy(path, p + 3, n);
+            path[n] = '\0';
+            return 0;
+        }
+    }
+    errno = ENOENT;
+    return -1;
+}
@@ -0,0 +1,467 @@
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <utmp.h>
+#include <sys/types.h>
+#include "sysstats.h"
+
+/*
+ * The /proc readers and parsers behind libsysstats. They are internal to the library and to
+ * mySystemStats, which links the static archive; the shared library does not export them.
+ */
+
+/**
+ * @brief Initial buffer sizes of the /proc readers. A buffer only grows if the file outgrows it.
+ */
+#define PROC_STAT_SIZE 16384
+#define PROC_CPUINFO_SIZE 65536
+#define PROC_UPTIME_SIZE 128
+#define PROC_UTMP_SIZE (64 * sizeof(struct utmp))
+#define PROC_DISKSTATS_SIZE 4096
+#define PROC_NETDEV_SIZE 4096
+#define CGROUP_FILE_SIZE 128
+#define CGROUP_STAT_SIZE 2048
+
+/**
+ * @brief Longest cgroup path kept, and the value of a limit that is set to "max".
+ */
+#define CGROUP_PATH_LEN 256
+#define CGROUP_UNLIMITED UINT64_MAX
+
+/**
+ * @brief Longest --proc-root directory, and longest path once a file is placed below it.
+ */
+#define PROC_ROOT_LEN 256
+#define PROC_PATH_LEN (PROC_ROOT_LEN + 2 * CGROUP_PATH_LEN)
+
+/**
+ * @brief Initial buffer size of the /proc/meminfo reader, and the offset of a key that this
+ * kernel does not report.
+ */
+#define PROC_MEMINFO_SIZE 4096
+#define MEMINFO_MISSING ((size_t) -1)
+
+/**
+ * @brief Longest block device or network interface name kept.
+ */
+#define DEVICE_NAME_LEN 32
+
+/**
+ * @brief The /proc/meminfo lines read for SysStatsMemory.
+ */
+typedef enum {
+    MEMINFO_TOTAL,
+    MEMINFO_FREE,
+    MEMINFO_AVAILABLE,
+    MEMINFO_BUFFERS,
+    MEMINFO_CACHED,
+    MEMINFO_SWAP_TOTAL,
+    MEMINFO_SWAP_FREE,
+    MEMINFO_DIRTY,
+    MEMINFO_WRITEBACK,
+    MEMINFO_ANON_PAGES,
+    MEMINFO_SLAB,
+    MEMINFO_HUGE_TOTAL,
+    MEMINFO_HUGE_FREE,
+    MEMINFO_HUGE_SIZE,
+    MEMINFO_FIELDS
+} MeminfoField;
+
+/**
+ * @brief Byte offsets of the /proc/meminfo lines we read, found by name on the first read.
+ *
+ * Later reads only check that each key is still at its offset and parse the number after
+ * it; the index is rebuilt by name when a line moved.
+ *
+ * @param offset Offset of the line of each field, or MEMINFO_MISSING.
+ * @param built True once the index has been built.
+ * @param rebuilds Number of times the index was built.
+ */
+typedef struct {
+    size_t offset[MEMINFO_FIELDS];
+    bool built;
+    long rebuilds;
+} MeminfoIndex;
+
+/**
+ * @brief A /proc file that is opened once and re-read in place.
+ *
+ * Every read is a pread at offset 0 into the same buffer, which always ends with a NUL so that
+ * the scanners below can walk it. The buffer is allocated when the file is opened and only
+ * reallocated if the file grows past it.
+ *
+ * @param fd The open file descriptor, or -1 if the file is not open.
+ * @param buf The buffer holding the contents of the last read.
+ * @param cap Allocated size of `buf`.
+ * @param len Number of bytes of the last read, not counting the NUL.
+ */
+typedef struct {
+    int fd;
+    char *buf;
+    size_t cap;
+    size_t len;
+} ProcFile;
+
+/**
+ * @brief One process as seen by the last scan of /proc.
+ *
+ * @param pid Process id, or 0 if the process exited before it could be read.
+ * @param starttime Start time in clock ticks after boot; with the pid it identifies the process.
+ * @param ticks User and system CPU time in clock ticks.
+ * @param rss_pages Resident set size in pages.
+ * @param cpu CPU usage since the previous scan, in percent of one core.
+ * @param comm The command name.
+ */
+typedef struct {
+    pid_t pid;
+    uint64_t starttime;
+    uint64_t ticks;
+    uint64_t rss_pages;
+    double cpu;
+    char comm[16];
+} ProcSample;
+
+/**
+ * @brief One "some" or "full" line of a /proc/pressure file.
+ *
+ * @param avg10 Share of time stalled over the last 10 seconds, in percent.
+ * @param avg60 Share of time stalled over the last 60 seconds, in percent.
+ * @param avg300 Share of time stalled over the last 300 seconds, in percent.
+ * @param total Total stalled time since boot, in microseconds.
+ */
+typedef struct {
+    double avg10;
+    double avg60;
+    double avg300;
+    uint64_t total;
+} PressureLine;
+
+/**
+ * @brief The load averages and run queue from /proc/loadavg.
+ *
+ * @param load1 Load average over 1 minute.
+ * @param load5 Load average over 5 minutes.
+ * @param load15 Load average over 15 minutes.
+ * @param running Number of runnable tasks.
+ * @param tasks Number of tasks on the system.
+ */
+typedef struct {
+    double load1;
+    double load5;
+    double load15;
+    int running;
+    int tasks;
+} LoadAvg;
+
+/**
+ * @brief The counters of one block device in /proc/diskstats.
+ *
+ * @param name Name of the device.
+ * @param reads Reads completed.
+ * @param read_sectors Sectors read.
+ * @param read_ms Time spent reading, in milliseconds.
+ * @param writes Writes completed.
+ * @param write_sectors Sectors written.
+ * @param write_ms Time spent writing, in milliseconds.
+ * @param io_ms Time the device had I/O in flight, in milliseconds.
+ */
+typedef struct {
+    char name[DEVICE_NAME_LEN];
+    uint64_t reads;
+    uint64_t read_sectors;
+    uint64_t read_ms;
+    uint64_t writes;
+    uint64_t write_sectors;
+    uint64_t write_ms;
+    uint64_t io_ms;
+} DiskCounters;
+
+/**
+ * @brief The counters of one network interface in /proc/net/dev.
+ *
+ * @param name Name of the interface.
+ * @param rx_bytes Bytes received.
+ * @param rx_packets Packets received.
+ * @param tx_bytes Bytes sent.
+ * @param tx_packets Packets sent.
+ */
+typedef struct {
+    char name[DEVICE_NAME_LEN];
+    uint64_t rx_bytes;
+    uint64_t rx_packets;
+    uint64_t tx_bytes;
+    uint64_t tx_packets;
+} NetCounters;
+
+/**
+ * @brief Counts the number of processor cores available on the system.
+ * 
+ * This function reads the "/proc/cpuinfo" file to count the number of occurrences
+ * of the string "processor", which corresponds to an individual core. It returns
+ * the total count of processor cores found. If the file cannot be opened, it returns -1,
+ * indicating an error. The file is only parsed by the first successful call; later calls
+ * return the cached count.
+ * 
+ * @return The number of processor cores on the system. Returns -1 if the file cannot be opened.
+ */
+int count_cores();
+
+/**
+ * @brief Reads the current memory statistics.
+ *
+ * @param memInfo Receives total and used physical and virtual memory in GB.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int readMemoryInfo(SysStatsMemory *memInfo);
+
+/**
+ * @brief Reads the aggregate and per-core CPU counters from "/proc/stat".
+ *
+ * The file is opened on the first call and re-read with pread afterwards; all lines are
+ * parsed from that single read however many cores there are.
+ *
+ * @param cpu_stats Receives the aggregate and per-core counters.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int readCpuStats(SysStatsCpuSample *cpu_stats);
+
+/**
+ * @brief Reads the time since boot from "/proc/uptime".
+ *
+ * The file is opened on the first call and re-read with pread afterwards.
+ *
+ * @param seconds Receives the uptime in seconds.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int readUptime(double *seconds);
+
+/**
+ * @brief Makes every collector read below `root` instead of the live /proc, /sys and utmp.
+ *
+ * Paths are still written as on the live system; procOpen and procPath place them below the
+ * root at the moment they are opened. Call it before opening any collector.
+ *
+ * @param root A directory laid out like / (see --capture), or NULL or "/" for the live system.
+ * @return 0 on success, -1 with errno set to ENAMETOOLONG if the path is too long.
+ */
+int procSetRoot(const char *root);
+
+/**
+ * @brief Tells whether the collectors read a captured tree rather than the live system.
+ *
+ * @return True after procSetRoot with a directory other than "/".
+ */
+bool procRooted(void);
+
+/**
+ * @brief Places an absolute path below the root set by procSetRoot.
+ *
+ * @param path A path as on the live system.
+ * @param buf Receives the rooted path.
+ * @param len Size of `buf`.
+ * @return `path` itself without a root or for relative paths, `buf` otherwise, or NULL with
+ *         errno set to ENAMETOOLONG if the rooted path does not fit.
+ */
+const char *procPath(const char *path, char *buf, size_t len);
+
+/**
+ * @brief Opens a /proc file for repeated reads.
+ *
+ * @param file The reader to initialise.
+ * @param path Path of the file to open, below the root set by procSetRoot if any.
+ * @param cap Initial size of the read buffer.
+ * @return 0 on success, -1 on error with errno set; `file->fd` is -1 on error.
+ */
+int procOpen(ProcFile *file, const char *path, size_t cap);
+
+/**
+ * @brief Re-reads the whole file into the reader's buffer with pread from offset 0.
+ *
+ * No stdio is involved and nothing is allocated unless the file has outgrown the buffer.
+ *
+ * @param file An open reader.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int procRead(ProcFile *file);
+
+/**
+ * @brief Closes a reader and frees its buffer.
+ *
+ * @param file The reader.
+ * @return void
+ */
+void procClose(ProcFile *file);
+
+/**
+ * @brief Skips spaces and tabs.
+ *
+ * @param p Position in a NUL-terminated buffer.
+ * @return The first position that is not a space or tab.
+ */
+const char *scanSpaces(const char *p);
+
+/**
+ * @brief Parses an unsigned decimal integer after optional spaces.
+ *
+ * @param p Position in a NUL-terminated buffer.
+ * @param value Receives the parsed value.
+ * @return The position after the last digit, or NULL if there is no digit.
+ */
+const char *scanU64(const char *p, uint64_t *value);
+
+/**
+ * @brief Returns the start of the next line.
+ *
+ * @param p Position in a NUL-terminated buffer.
+ * @return The position after the next newline, or the terminating NUL if there is none.
+ */
+const char *scanNextLine(const char *p);
+
+/**
+ * @brief Parses the aggregate "cpu" line at the start of /proc/stat.
+ *
+ * @param buf The contents of /proc/stat.
+ * @param cpu_stats Receives the idle time and the time spent on all other activities.
+ * @return 0 on success, -1 with errno set to EINVAL if the line is malformed.
+ */
+int parseCpuStats(const char *buf, SysStatsCpu *cpu_stats);
+
+/**
+ * @brief Parses the aggregate "cpu" line and every "cpuN" line of /proc/stat in one pass.
+ *
+ * Cores numbered SYSSTATS_MAX_CORES or higher are ignored.
+ *
+ * @param buf The contents of /proc/stat.
+ * @param cpu_stats Receives the aggregate and per-core counters.
+ * @return 0 on success, -1 with errno set to EINVAL if the aggregate line is malformed.
+ */
+int parseCpuCores(const char *buf, SysStatsCpuSample *cpu_stats);
+
+/**
+ * @brief Counts the "processor" lines of /proc/cpuinfo.
+ *
+ * @param buf The contents of /proc/cpuinfo.
+ * @return The number of processor cores.
+ */
+int parseCoreCount(const char *buf);
+
+/**
+ * @brief Parses the first field of /proc/uptime.
+ *
+ * @param buf The contents of /proc/uptime.
+ * @param seconds Receives the uptime in seconds.
+ * @return 0 on success, -1 with errno set to EINVAL if the field is malformed.
+ */
+int parseUptime(const char *buf, double *seconds);
+
+/**
+ * @brief Parses the command name, CPU time and start time from /proc/[pid]/stat.
+ *
+ * The command name is taken up to the last ')', since it may contain spaces and parentheses.
+ *
+ * @param buf The contents of /proc/[pid]/stat.
+ * @param proc Receives `comm`, `ticks` and `starttime`.
+ * @return 0 on success, -1 with errno set to EINVAL if the line is malformed.
+ */
+int parsePidStat(const char *buf, ProcSample *proc);
+
+/**
+ * @brief Parses the fields of MeminfoField from /proc/meminfo.
+ *
+ * @param buf The contents of /proc/meminfo.
+ * @param len Number of bytes in `buf`.
+ * @param index The line offsets of a previous read; built or rebuilt as needed.
+ * @param values Receives MEMINFO_FIELDS values, in kB except for the huge page counts; 0 for missing keys.
+ * @return 0 on success, -1 with errno set to EINVAL if MemTotal or a number is missing.
+ */
+int parseMeminfo(const char *buf, size_t len, MeminfoIndex *index, uint64_t *values);
+
+/**
+ * @brief Parses the resident set size from /proc/[pid]/statm.
+ *
+ * @param buf The contents of /proc/[pid]/statm.
+ * @param rss_pages Receives the resident set size in pages.
+ * @return 0 on success, -1 with errno set to EINVAL if the line is malformed.
+ */
+int parsePidStatm(const char *buf, uint64_t *rss_pages);
+
+/**
+ * @brief Parses a /proc/pressure file.
+ *
+ * @param buf The contents of /proc/pressure/cpu, memory or io.
+ * @param some Receives the "some" line.
+ * @param full Receives the "full" line, if there is one.
+ * @return 1 if both lines were parsed, 0 if the file has no "full" line, -1 with errno set to EINVAL if it is malformed.
+ */
+int parsePressure(const char *buf, PressureLine *some, PressureLine *full);
+
+/**
+ * @brief Parses the load averages and the run queue from /proc/loadavg.
+ *
+ * @param buf The contents of /proc/loadavg.
+ * @param load Receives the load averages and task counts.
+ * @return 0 on success, -1 with errno set to EINVAL if the line is malformed.
+ */
+int parseLoadavg(const char *buf, LoadAvg *load);
+
+/**
+ * @brief Parses the counters of every device in /proc/diskstats.
+ *
+ * @param buf The contents of /proc/diskstats.
+ * @param devices Receives the counters of up to `cap` devices, in file order.
+ * @param cap Number of entries in `devices`.
+ * @return Number of devices parsed, or -1 with errno set to EINVAL if a line is malformed.
+ */
+int parseDiskstats(const char *buf, DiskCounters *devices, int cap);
+
+/**
+ * @brief Parses the counters of every interface in /proc/net/dev.
+ *
+ * @param buf The contents of /proc/net/dev.
+ * @param interfaces Receives the counters of up to `cap` interfaces, in file order.
+ * @param cap Number of entries in `interfaces`.
+ * @return Number of interfaces parsed, or -1 with errno set to EINVAL if a line is malformed.
+ */
+int parseNetdev(const char *buf, NetCounters *interfaces, int cap);
+
+/**
+ * @brief Parses the values of the given keys from a flat-keyed file such as memory.stat or cpu.stat.
+ *
+ * @param buf The contents of the file, one "key value" pair per line.
+ * @param keys The keys to look for.
+ * @param count Number of entries in `keys` and `values`.
+ * @param values Receives the value of each key; left unchanged for keys that are missing.
+ * @return Number of keys found, or -1 with errno set to EINVAL if a value is not a number.
+ */
+int parseFlatKeyed(const char *buf, const char *const *keys, int count, uint64_t *values);
+
+/**
+ * @brief Parses a cgroup limit such as memory.max, or the two fields of cpu.max.
+ *
+ * @param buf The contents of the file: a number or "max", optionally followed by a second number.
+ * @param limit Receives the first field, or CGROUP_UNLIMITED for "max".
+ * @param second Receives the second field if there is one, or NULL.
+ * @return 0 on success, -1 with errno set to EINVAL if the line is malformed.
+ */
+int parseCgroupLimit(const char *buf, uint64_t *limit, uint64_t *second);
+
+/**
+ * @brief Finds the cgroup v2 path of the process in /proc/self/cgroup.
+ *
+ * @param buf The contents of /proc/self/cgroup.
+ * @param path Receives the path of the "0::" line.
+ * @param len Size of `path`.
+ * @return 0 on success, -1 with errno set to ENOENT if the process is in no cgroup v2 hierarchy.
+ */
+int parseSelfCgroup(const char *buf, char *path, size_t len);
+
+#endif
@@ -0,0 +1,296 @@
+#define _GNU_SOURCE
+#include "header.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char recordMagic[8] = RECORD_MAGIC;
+
+/**
+ * Converts a size in GB, as kept in MemoryInfo, back to whole kilobytes.
+ */
+static uint64_t gbToKb(double gb) {
+    return (uint64_t) llround(gb * 1e9 / 1024.0);
+}
+
+static double kbToGb(uint64_t kb) {
+    return (double) kb * 1024.0 / 1e9;
+}
+
+void recordFromSample(const SampleSet *set, int cores, int sessions, int64_t wall_offset, SampleRecord *record) {
+    memset(record, 0, sizeof(*record));
+    record->timestamp = set->timestamp;
+    record->wall_time = (int64_t) set->timestamp + wall_offset;
+    record->total_memory_kb = gbToKb(set->memory.total_memory);
+    record->used_memory_kb = gbToKb(set->memory.used_memory);
+    record->total_virtual_kb = gbToKb(set->memory.total_virtual);
+    record->used_virtual_kb = gbToKb(set->memory.used_virtual);
+    record->cpu_tot = set->cpu.total.tot;
+    record->cpu_idle = set->cpu.total.time;
+    record->cores = (uint32_t) cores;
+    record->sessions = (uint32_t) sessions;
+    record->available_kb = gbToKb(set->memory.available);
+    record->cached_kb = gbToKb(set->memory.cached);
+    record->buffers_kb = gbToKb(set->memory.buffers);
+    record->dirty_kb = gbToKb(set->memory.dirty);
+    record->writeback_kb = gbToKb(set->memory.writeback);
+    record->anon_pages_kb = gbToKb(set->memory.anon_pages);
+    record->slab_kb = gbToKb(set->memory.slab);
+    record->huge_total_kb = gbToKb(set->memory.huge_total);
+    record->huge_free_kb = gbToKb(set->memory.huge_free);
+}
+
+void sampleFromRecord(const SampleRecord *record, SampleSet *set) {
+    set->timestamp = record->timestamp;
+    set->memory.total_memory = kbToGb(record->total_memory_kb);
+    set->memory.used_memory = kbToGb(record->used_memory_kb);
+    set->memory.total_virtual = kbToGb(record->total_virtual_kb);
+    set->memory.used_virtual = kbToGb(record->used_virtual_kb);
+    set->memory.available = kbToGb(record->available_kb);
+    set->memory.cached = kbToGb(record->cached_kb);
+    set->memory.buffers = kbToGb(record->buffers_kb);
+    set->memory.dirty = kbToGb(record->dirty_kb);
+    set->memory.writeback = kbToGb(record->writeback_kb);
+    set->memory.anon_pages = kbToGb(record->anon_pages_kb);
+    set->memory.slab = kbToGb(record->slab_kb);
+    set->memory.huge_total = kbToGb(record->huge_total_kb);
+    set->memory.huge_free = kbToGb(record->huge_free_kb);
+    set->cpu.total.tot = (long int) record->cpu_tot;
+    set->cpu.total.time = (long int) record->cpu_idle;
+    set->cpu.ncores = 0;
+}
+
+/**
+ * Checks that a header belongs to a recording this version can read.
+ */
+static int checkHeader(const RecordHeader *header) {
+    size_t size = header->version == RECORD_VERSION ? sizeof(SampleRecord) : RECORD_BASIC_SIZE;
+    if (memcmp(header->magic, recordMagic, sizeof(recordMagic)) != 0 ||
+        (header->version != RECORD_VERSION && header->version != RECORD_VERSION_BASIC &&
+         header->version != RECORD_VERSION_RAW) ||
+        header->record_size != size) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int recorderOpen(Recorder *recorder, const char *path, uint64_t interval) {
+    recorder->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (recorder->fd == -1) {
+        return -1;
+    }
+    recorder->records = 0;
+    recorder->version = RECORD_VERSION;
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    recorder->wall_offset = (int64_t) ((uint64_t) real.tv_sec * 1000000000ull + (uint64_t) real.tv_nsec) - (int64_t) nowNanos();
+    struct stat st;
+    if (fstat(recorder->fd, &st) == -1) {
+        close(recorder->fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        // Appending to an earlier recording: its header must match ours
+        RecordHeader header;
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        int status = fd == -1 ? -1 : readFull(fd, &header, sizeof(header));
+        if (status == 0) status = checkHeader(&header);
+        if (fd != -1) close(fd);
+        if (status == -1) {
+            int saved = errno == EPIPE ? EINVAL : errno;
+            close(recorder->fd);
+            errno = saved;
+            return -1;
+        }
+        // Deltas are taken against the recording's own interval
+        recorder->version = header.version;
+        codecInit(&recorder->codec, header.interval);
+        return 0;
+    }
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, recordMagic, sizeof(recordMagic));
+    header.version = RECORD_VERSION;
+    header.record_size = sizeof(SampleRecord);
+    header.interval = interval;
+    if (writeFull(recorder->fd, &header, sizeof(header)) == -1) {
+        close(recorder->fd);
+        return -1;
+    }
+    codecInit(&recorder->codec, interval);
+    return 0;
+}
+
+int recorderAppend(Recorder *recorder, const SampleSet *set, int cores, int sessions) {
+    SampleRecord record;
+    recordFromSample(set, cores, sessions, recorder->wall_offset, &record);
+    if (recorder->version != RECORD_VERSION) {
+        // Older recordings have no room for the memory breakdown
+        memset((char *) &record + RECORD_BASIC_SIZE, 0, sizeof(record) - RECORD_BASIC_SIZE);
+    }
+    // With O_APPEND a single small write lands as one whole record
+    int status;
+    if (recorder->version == RECORD_VERSION_RAW) {
+        status = writeFull(recorder->fd, &record, RECORD_BASIC_SIZE);
+    }
+    else {
+        uint8_t packed[RECORD_PACKED_MAX];
+        status = writeFull(recorder->fd, packed, codecEncode(&recorder->codec, &record, packed));
+    }
+    if (status == -1) {
+        return -1;
+    }
+    recorder->records++;
+    return 0;
+}
+
+void recorderClose(Recorder *recorder) {
+    if (recorder->fd != -1) {
+        close(recorder->fd);
+        recorder->fd = -1;
+    }
+}
+
+/**
+ * Counts the records of a packed recording and notes where its keyframes are.
+ */
+static int scanPacked(Replay *replay) {
+    long cap = 0;
+    Codec codec;
+    SampleRecord record;
+    codecInit(&codec, replay->header->interval);
+    const uint8_t *p = replay->data, *next;
+    for (; p < replay->end; p = next) {
+        uint64_t tag;
+        if (getVarint(p, replay->end, &tag) && (tag & 1)) {
+            if (replay->nkeyframes == cap) {
+                cap = cap ? cap * 2 : 64;
+                size_t *offsets = realloc(replay->keyframes, cap * sizeof(*offsets));
+                if (offsets) replay->keyframes = offsets;
+                long *indexes = realloc(replay->keyframe_records, cap * sizeof(*indexes));
+                if (indexes) replay->keyframe_records = indexes;
+                if (!offsets || !indexes) return -1;
+            }
+            replay->keyframes[replay->nkeyframes] = (size_t) (p - replay->data);
+            replay->keyframe_records[replay->nkeyframes] = replay->count;
+            replay->nkeyframes++;
+        }
+        if (!(next = codecDecode(&codec, p, replay->end, &record))) {
+            break;
+        }
+        replay->count++;
+    }
+    // Whatever follows the last complete record cannot be read
+    replay->end = p;
+    return 0;
+}
+
+int replayOpen(Replay *replay, const char *path) {
+    memset(replay, 0, sizeof(*replay));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t) st.st_size < sizeof(RecordHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    replay->map = map;
+    replay->size = (size_t) st.st_size;
+    replay->header = map;
+    if (checkHeader(replay->header) == -1) {
+        munmap(map, replay->size);
+        replay->map = NULL;
+        return -1;
+    }
+    // The records are read front to back
+    madvise(map, replay->size, MADV_SEQUENTIAL);
+    replay->data = (const uint8_t *) map + sizeof(RecordHeader);
+    replay->pos = replay->data;
+    codecInit(&replay->codec, replay->header->interval);
+    if (replay->header->version == RECORD_VERSION_RAW) {
+        replay->count = (long) ((replay->size - sizeof(RecordHeader)) / RECORD_BASIC_SIZE);
+        replay->end = replay->data + (size_t) replay->count * RECORD_BASIC_SIZE;
+        return 0;
+    }
+    replay->end = (const uint8_t *) map + replay->size;
+    if (scanPacked(replay) == -1) {
+        int saved = errno;
+        replayClose(replay);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+int replayNext(Replay *replay, SampleRecord *record) {
+    if (replay->index >= replay->count) {
+        return 0;
+    }
+    bool marked = false;
+    if (replay->header->version == RECORD_VERSION_RAW) {
+        memset(record, 0, sizeof(*record));
+        memcpy(record, replay->pos, RECORD_BASIC_SIZE);
+        replay->pos += RECORD_BASIC_SIZE;
+    }
+    else {
+        replay->pos = codecDecode(&replay->codec, replay->pos, replay->end, record);
+        marked = replay->codec.run;
+    }
+    // Each run fixes its wall-clock offset when it starts, so a new offset is a new run too
+    int64_t wall_offset = record->wall_time - (int64_t) record->timestamp;
+    replay->run_start = replay->index == 0 || marked || wall_offset != replay->wall_offset;
+    replay->wall_offset = wall_offset;
+    replay->index++;
+    return 1;
+}
+
+int replaySeek(Replay *replay, long index) {
+    if (index < 0 || index > replay->count) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (replay->header->version == RECORD_VERSION_RAW) {
+        replay->pos = replay->data + (size_t) index * RECORD_BASIC_SIZE;
+        replay->index = index;
+        return 0;
+    }
+    // Find the last keyframe at or before the record, then decode up to it
+    long lo = 0, hi = replay->nkeyframes - 1;
+    while (lo < hi) {
+        long mid = (lo + hi + 1) / 2;
+        if (replay->keyframe_records[mid] <= index) lo = mid;
+        else hi = mid - 1;
+    }
+    replay->pos = replay->nkeyframes > 0 ? replay->data + replay->keyframes[lo] : replay->data;
+    replay->index = replay->nkeyframes > 0 ? replay->keyframe_records[lo] : 0;
+    codecInit(&replay->codec, replay->header->interval);
+    SampleRecord record;
+    while (replay->index < index) {
+        replayNext(replay, &record);
+    }
+    return 0;
+}
+
+void replayClose(Replay *replay) {
+    if (replay->map) {
+        munmap(replay->map, replay->size);
+        replay->map = NULL;
+    }
+    free(replay->keyframes);
+    free(replay->keyframe_records);
+    replay->keyframes = NULL;
+    replay->keyframe_records = NULL;
+}
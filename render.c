@@ -0,0 +1,163 @@
+#include "header.h"
+#include <stdarg.h>
+
+int frameInit(Frame *frame, size_t cap, bool incremental) {
+    memset(frame, 0, sizeof(*frame));
+    frame->text = malloc(cap);
+    frame->prev = malloc(cap);
+    frame->out = malloc(cap);
+    if (!frame->text || !frame->prev || !frame->out) {
+        frameFree(frame);
+        return -1;
+    }
+    frame->cap = cap;
+    frame->prev_cap = cap;
+    frame->out_cap = cap;
+    frame->incremental = incremental;
+    return 0;
+}
+
+void frameFree(Frame *frame) {
+    free(frame->text);
+    free(frame->prev);
+    free(frame->out);
+    frame->text = frame->prev = frame->out = NULL;
+}
+
+void frameBegin(Frame *frame) {
+    frame->len = 0;
+}
+
+/**
+ * Grows a frame buffer so that it can hold at least `need` bytes.
+ */
+static int growBuffer(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) {
+        return 0;
+    }
+    size_t new_cap = *cap * 2;
+    while (new_cap < need) new_cap *= 2;
+    char *grown = realloc(*buf, new_cap);
+    if (!grown) {
+        return -1;
+    }
+    *buf = grown;
+    *cap = new_cap;
+    return 0;
+}
+
+void framePrintf(Frame *frame, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(frame->text + frame->len, frame->cap - frame->len, fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return;
+    }
+    if ((size_t) n >= frame->cap - frame->len) {
+        // Only happens while frames are still getting bigger
+        if (growBuffer(&frame->text, &frame->cap, frame->len + n + 1) == -1) {
+            return;
+        }
+        va_start(args, fmt);
+        vsnprintf(frame->text + frame->len, frame->cap - frame->len, fmt, args);
+        va_end(args);
+    }
+    frame->len += n;
+}
+
+/**
+ * Appends bytes to the output buffer of a frame.
+ */
+static int emit(Frame *frame, size_t *out_len, const char *bytes, size_t n) {
+    if (growBuffer(&frame->out, &frame->out_cap, *out_len + n) == -1) {
+        return -1;
+    }
+    memcpy(frame->out + *out_len, bytes, n);
+    *out_len += n;
+    return 0;
+}
+
+/**
+ * Returns the length of the line starting at `p`, without its newline.
+ */
+static size_t lineLength(const char *p, const char *end) {
+    const char *nl = memchr(p, '\n', end - p);
+    return nl ? (size_t) (nl - p) : (size_t) (end - p);
+}
+
+void frameRedraw(Frame *frame) {
+    frame->redraw = true;
+}
+
+int frameFlush(Frame *frame) {
+    size_t out_len = 0;
+    int status = 0;
+
+    if (!frame->incremental || frame->frames == 0) {
+        status = emit(frame, &out_len, frame->text, frame->len);
+    }
+    else if (frame->redraw) {
+        // The lines of the old frame may have wrapped differently: start over on a clear screen
+        status |= emit(frame, &out_len, "\x1b[H\x1b[2J", 7);
+        status |= emit(frame, &out_len, frame->text, frame->len);
+    }
+    else {
+        // Go back to the first line of the previous frame
+        char seq[32];
+        if (frame->prev_lines > 0) {
+            int n = snprintf(seq, sizeof(seq), "\r\x1b[%dA", frame->prev_lines);
+            status |= emit(frame, &out_len, seq, n);
+        }
+        const char *cur = frame->text, *cur_end = frame->text + frame->len;
+        const char *old = frame->prev, *old_end = frame->prev + frame->prev_len;
+        while (cur < cur_end) {
+            size_t cur_n = lineLength(cur, cur_end);
+            size_t old_n = old < old_end ? lineLength(old, old_end) : (size_t) -1;
+            if (old_n != cur_n || memcmp(cur, old, cur_n) != 0) {
+                // Rewrite the changed line and clear what is left of the old one
+                status |= emit(frame, &out_len, cur, cur_n);
+                status |= emit(frame, &out_len, "\x1b[K", 3);
+            }
+            // A bare newline moves past an unchanged line
+            status |= emit(frame, &out_len, "\n", 1);
+            cur += cur_n + 1;
+            if (old < old_end) old += old_n + 1;
+        }
+        if (old < old_end) {
+            // The new frame is shorter: clear the rest of the old one
+            status |= emit(frame, &out_len, "\x1b[J", 3);
+        }
+    }
+    if (status != 0) {
+        return -1;
+    }
+
+    // Anything still buffered by stdio must come out before the frame
+    fflush(stdout);
+    if (writeFull(STDOUT_FILENO, frame->out, out_len) == -1) {
+        return -1;
+    }
+
+    // Count the lines of the frame, then keep it to diff the next one against
+    int lines = 0;
+    for (const char *p = frame->text; (p = memchr(p, '\n', frame->text + frame->len - p)); p++) {
+        lines++;
+    }
+    frame->prev_lines = lines;
+    char *swap = frame->prev;
+    size_t swap_cap = frame->prev_cap;
+    frame->prev = frame->text;
+    frame->prev_cap = frame->cap;
+    frame->prev_len = frame->len;
+    frame->text = swap;
+    frame->cap = swap_cap;
+    frame->len = 0;
+
+    frame->redraw = false;
+    frame->frames++;
+    frame->last_bytes = out_len;
+    frame->bytes += out_len;
+    frame->full_bytes += frame->prev_len;
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "header.h"
+
+static const char *tierNames[ROLLUP_TIERS] = { "1s", "10s", "1m", "10m" };
+static const uint64_t tierWidths[ROLLUP_TIERS] = {
+    1000000000ull, 10000000000ull, 60000000000ull, 600000000000ull
+};
+
+int rollupTier(const char *name) {
+    for (int t = 0; t < ROLLUP_TIERS; t++) {
+        if (strcmp(name, tierNames[t]) == 0) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+const char *rollupName(int tier) {
+    return tierNames[tier];
+}
+
+int rollupInit(Rollups *rollups, int capacity) {
+    memset(rollups, 0, sizeof(*rollups));
+    for (int t = 0; t < ROLLUP_TIERS; t++) {
+        RollupTier *tier = &rollups->tiers[t];
+        tier->width = tierWidths[t];
+        tier->buckets = malloc((size_t) capacity * sizeof(RollupBucket));
+        if (!tier->buckets || historyInit(&tier->history, capacity) == -1) {
+            rollupFree(rollups);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void rollupFree(Rollups *rollups) {
+    for (int t = 0; t < ROLLUP_TIERS; t++) {
+        free(rollups->tiers[t].buckets);
+        rollups->tiers[t].buckets = NULL;
+        historyFree(&rollups->tiers[t].history);
+    }
+}
+
+static void aggregateStart(Aggregate *aggregate, double value) {
+    aggregate->min = aggregate->max = aggregate->sum = aggregate->last = value;
+}
+
+static void aggregateAdd(Aggregate *aggregate, double value) {
+    if (value < aggregate->min) aggregate->min = value;
+    if (value > aggregate->max) aggregate->max = value;
+    aggregate->sum += value;
+    aggregate->last = value;
+}
+
+void rollupAdd(Rollups *rollups, const HistorySample *sample) {
+    for (int t = 0; t < ROLLUP_TIERS; t++) {
+        RollupTier *tier = &rollups->tiers[t];
+        History *history = &tier->history;
+        // Buckets are aligned to multiples of the width, so all tiers close on round times
+        uint64_t start = sample->timestamp - sample->timestamp % tier->width;
+        int slot = (history->head + history->count - 1) % history->capacity;
+        RollupBucket *bucket = history->count > 0 ? &tier->buckets[slot] : NULL;
+        if (!bucket || bucket->start != start) {
+            // Open a new bucket; the ring drops the oldest one when it is full
+            HistorySample empty = { .timestamp = start };
+            historyPush(history, &empty);
+            slot = (history->head + history->count - 1) % history->capacity;
+            bucket = &tier->buckets[slot];
+            bucket->start = start;
+            bucket->count = 1;
+            aggregateStart(&bucket->memory, sample->memory.used_memory);
+            aggregateStart(&bucket->virtual_memory, sample->memory.used_virtual);
+            aggregateStart(&bucket->available, sample->memory.available);
+            aggregateStart(&bucket->cpu, sample->cpu_usage);
+        }
+        else {
+            bucket->count++;
+            aggregateAdd(&bucket->memory, sample->memory.used_memory);
+            aggregateAdd(&bucket->virtual_memory, sample->memory.used_virtual);
+            aggregateAdd(&bucket->available, sample->memory.available);
+            aggregateAdd(&bucket->cpu, sample->cpu_usage);
+        }
+        // The bucket is shown as a sample holding its means
+        HistorySample *mean = &history->samples[slot];
+        mean->memory = sample->memory;
+        mean->memory.used_memory = bucket->memory.sum / bucket->count;
+        mean->memory.used_virtual = bucket->virtual_memory.sum / bucket->count;
+        mean->memory.available = bucket->available.sum / bucket->count;
+        mean->cpu_usage = bucket->cpu.sum / bucket->count;
+        mean->memory_delta = history->count > 1 ? memoryShown(&mean->memory, rollups->available)
+                             - memoryShown(&historyAt(history, history->count - 2)->memory, rollups->available) : 0;
+    }
+}
+
+const RollupBucket *rollupLast(const Rollups *rollups, int tier) {
+    const RollupTier *t = &rollups->tiers[tier];
+    const History *history = &t->history;
+    return history->count > 0 ? &t->buckets[(history->head + history->count - 1) % history->capacity] : NULL;
+}
+
+void rollupOutput(Frame *frame, const Rollups *rollups, int tier) {
+    const RollupBucket *bucket = rollupLast(rollups, tier);
+    if (!bucket) {
+        return;
+    }
+    framePrintf(frame, "--------------------------------------------\n");
+    framePrintf(frame, "### %s rollup ### (%ld samples: min / mean / max / last)\n", rollupName(tier), bucket->count);
+    framePrintf(frame, "Memory used:  %.2f / %.2f / %.2f / %.2f GB\n", bucket->memory.min,
+                bucket->memory.sum / bucket->count, bucket->memory.max, bucket->memory.last);
+    framePrintf(frame, "Virtual used: %.2f / %.2f / %.2f / %.2f GB\n", bucket->virtual_memory.min,
+                bucket->virtual_memory.sum / bucket->count, bucket->virtual_memory.max, bucket->virtual_memory.last);
+    // Recordings and published samples do not carry available memory
+    if (bucket->available.max > 0) {
+        framePrintf(frame, "Available:    %.2f / %.2f / %.2f / %.2f GB\n", bucket->available.min,
+                    bucket->available.sum / bucket->count, bucket->available.max, bucket->available.last);
+    }
+    framePrintf(frame, "CPU:          %.2f / %.2f / %.2f / %.2f %%\n", bucket->cpu.min,
+                bucket->cpu.sum / bucket->count, bucket->cpu.max, bucket->cpu.last);
+}
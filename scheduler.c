@@ -0,0 +1,117 @@
+#include "header.h"
+
+uint64_t nowNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+void schedStart(Scheduler *sched, uint64_t interval) {
+    memset(sched, 0, sizeof(*sched));
+    sched->interval = interval;
+    histInit(&sched->intervals);
+    histInit(&sched->lateness);
+}
+
+/**
+ * Sleeps until an absolute CLOCK_MONOTONIC time, resuming after signal handlers.
+ */
+static void sleepUntil(uint64_t deadline) {
+    struct timespec ts;
+    ts.tv_sec = (time_t) (deadline / 1000000000ull);
+    ts.tv_nsec = (long) (deadline % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+uint64_t schedPlan(Scheduler *sched) {
+    uint64_t now = nowNanos();
+    if (sched->ticks == 0 || sched->interval == 0) {
+        // The first sample is taken right away, and back-to-back sampling has no grid to keep
+        sched->deadline = now;
+    }
+    else if (sched->retimed) {
+        // A new grid starts one new interval after the previous sample, or now if that has passed
+        sched->deadline = sched->last + sched->interval;
+        if (sched->deadline < now) sched->deadline = now;
+    }
+    else {
+        sched->deadline += sched->interval;
+        if (now >= sched->deadline + sched->interval) {
+            // Whole periods went by while we were busy: count them and keep the grid
+            uint64_t skipped = (now - sched->deadline) / sched->interval;
+            sched->missed += (long) skipped;
+            sched->deadline += skipped * sched->interval;
+        }
+    }
+    return sched->deadline;
+}
+
+uint64_t schedTick(Scheduler *sched) {
+    uint64_t now = nowNanos();
+    if (sched->ticks == 0) {
+        // The first sample anchors every later deadline
+        sched->deadline = now;
+    }
+    else if (!sched->retimed) {
+        histAdd(&sched->intervals, now - sched->last);
+        histAdd(&sched->lateness, now > sched->deadline ? now - sched->deadline : 0);
+    }
+    sched->retimed = false;
+    sched->last = now;
+    sched->ticks++;
+    return now;
+}
+
+void schedRetime(Scheduler *sched, uint64_t interval) {
+    sched->interval = interval;
+    sched->retimed = sched->ticks > 0;
+}
+
+void schedAdjust(Scheduler *sched, uint64_t interval) {
+    // The deadline of the current sample stays the base, so schedPlan adds the new interval to it
+    sched->interval = interval;
+}
+
+uint64_t schedNext(Scheduler *sched) {
+    uint64_t deadline = schedPlan(sched);
+    if (nowNanos() < deadline) {
+        sleepUntil(deadline);
+    }
+    return schedTick(sched);
+}
+
+void schedReport(const Scheduler *sched, FILE *out) {
+    if (sched->ticks < 2) {
+        return;
+    }
+    char interval[32];
+    formatDuration(sched->interval, interval, sizeof(interval));
+    const Histogram *h = &sched->intervals;
+    fprintf(out, "Scheduler: %ld samples every %s, %ld missed deadlines\n", sched->ticks, interval, sched->missed);
+    fprintf(out, "Interval (ms): min %.3f avg %.3f p99 %.3f max %.3f -- wake-up lateness p99 %.3f ms\n",
+           h->min / 1e6, histMean(h) / 1e6, histPercentile(h, 99) / 1e6, h->max / 1e6,
+           histPercentile(&sched->lateness, 99) / 1e6);
+}
+
+bool parseDuration(const char *str, uint64_t *ns) {
+    if (!str || !isdigit((unsigned char) *str)) {
+        return false;
+    }
+    uint64_t value = 0;
+    while (isdigit((unsigned char) *str)) {
+        value = value * 10 + (uint64_t) (*str++ - '0');
+    }
+    if (*str == '\0' || strcmp(str, "s") == 0) *ns = value * 1000000000ull;
+    else if (strcmp(str, "ms") == 0) *ns = value * 1000000ull;
+    else if (strcmp(str, "us") == 0) *ns = value * 1000ull;
+    else if (strcmp(str, "ns") == 0) *ns = value;
+    else return false;
+    return true;
+}
+
+void formatDuration(uint64_t ns, char *buf, size_t len) {
+    if (ns % 1000000000ull == 0) snprintf(buf, len, "%llu secs", (unsigned long long) (ns / 1000000000ull));
+    else if (ns % 1000000ull == 0) snprintf(buf, len, "%llu ms", (unsigned long long) (ns / 1000000ull));
+    else if (ns % 1000ull == 0) snprintf(buf, len, "%llu us", (unsigned long long) (ns / 1000ull));
+    else snprintf(buf, len, "%llu ns", (unsigned long long) ns);
+}
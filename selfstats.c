@@ -0,0 +1,74 @@
+#include "header.h"
+
+static const char *stageNames[STAGE_COUNT] = { "memory", "user", "cpu", "engine", "render" };
+
+/**
+ * Returns the user and system time of a getrusage() target, in nanoseconds.
+ */
+static uint64_t rusageTime(int who) {
+    struct rusage usage;
+    if (getrusage(who, &usage) == -1) {
+        return 0;
+    }
+    return (uint64_t) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ull +
+           (uint64_t) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+}
+
+uint64_t selfCpuTime(void) {
+    return rusageTime(RUSAGE_SELF) + rusageTime(RUSAGE_CHILDREN);
+}
+
+void selfStart(SelfStats *self) {
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        histInit(&self->stages[s]);
+    }
+    histInit(&self->cpu);
+    self->samples = 0;
+    self->start = nowNanos();
+    self->cpu_start = self->cpu_last = selfCpuTime();
+}
+
+void selfRecord(SelfStats *self, SelfStage stage, uint64_t elapsed) {
+    histAdd(&self->stages[stage], elapsed);
+}
+
+void selfSample(SelfStats *self, const SampleSet *set, const bool *enabled) {
+    for (int k = 0; k < COLLECT_COUNT; k++) {
+        if (enabled[k]) histAdd(&self->stages[k], set->collect_ns[k]);
+    }
+    // Worker processes are only reaped at the end, so until then they report their own time
+    uint64_t cpu = selfCpuTime() + set->worker_cpu;
+    histAdd(&self->cpu, cpu > self->cpu_last ? cpu - self->cpu_last : 0);
+    self->cpu_last = cpu;
+    self->samples++;
+}
+
+/**
+ * Prints one row of the latency table.
+ */
+static void reportRow(FILE *out, const char *name, const Histogram *hist) {
+    fprintf(out, "%-12s %8" PRIu64 " %11.1f %11.1f %11.1f\n", name, hist->count, histPercentile(hist, 50) / 1e3,
+            histPercentile(hist, 99) / 1e3, hist->max / 1e3);
+}
+
+void selfReport(const SelfStats *self, const CollectorSet *collectors, FILE *out) {
+    if (self->samples == 0) {
+        return;
+    }
+    fprintf(out, "Self stats over %ld samples\n", self->samples);
+    fprintf(out, "%-12s %8s %11s %11s %11s\n", "stage", "count", "p50 (us)", "p99 (us)", "max (us)");
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        if (self->stages[s].count > 0) reportRow(out, stageNames[s], &self->stages[s]);
+    }
+    for (int c = 0; collectors && c < collectors->count; c++) {
+        // The engine's collectors are timed as stages above
+        if (collectors->collectors[c].ops->sample) reportRow(out, collectors->collectors[c].ops->name, &collectors->collectors[c].latency);
+    }
+    reportRow(out, "CPU/sample", &self->cpu);
+    // The engine is stopped by now, so worker processes count as reaped children
+    double wall = (nowNanos() - self->start) / 1e9;
+    double cpu = (selfCpuTime() - self->cpu_start) / 1e9;
+    int cores = count_cores();
+    fprintf(out, "Monitor CPU: %.3f s over %.3f s = %.2f%% of one CPU, %.2f%% of %d CPUs\n", cpu, wall,
+            wall > 0 ? 100.0 * cpu / wall : 0.0, wall > 0 && cores > 0 ? 100.0 * cpu / wall / cores : 0.0, cores);
+}
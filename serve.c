@@ -0,0 +1,350 @@
+#define _GNU_SOURCE
+#include "header.h"
+#include <stdarg.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+int serveAddress(const char *spec, struct sockaddr_storage *addr, socklen_t *len) {
+    memset(addr, 0, sizeof(*addr));
+    if (strncmp(spec, "unix:", 5) == 0) {
+        struct sockaddr_un *un = (struct sockaddr_un *) addr;
+        const char *path = spec + 5;
+        if (*path == '\0' || strlen(path) >= sizeof(un->sun_path)) {
+            errno = EINVAL;
+            return -1;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, path);
+        *len = sizeof(*un);
+        return 0;
+    }
+    if (strncmp(spec, "tcp:", 4) == 0 && isInteger(spec + 4) && atoi(spec + 4) > 0 && atoi(spec + 4) < 65536) {
+        // Only ever on the loopback interface
+        struct sockaddr_in *in = (struct sockaddr_in *) addr;
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t) atoi(spec + 4));
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        *len = sizeof(*in);
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+/**
+ * Removes the socket file of an earlier run that is no longer listening, so that bind can reuse
+ * its path. Any other file, and a socket another server still accepts on, is left alone and
+ * reported as EADDRINUSE.
+ */
+static int removeStaleSocket(const char *path, const struct sockaddr_storage *addr, socklen_t len) {
+    struct stat st;
+    if (lstat(path, &st) == -1) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        errno = EADDRINUSE;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    int live = connect(fd, (const struct sockaddr *) addr, len);
+    close(fd);
+    if (live == 0) {
+        errno = EADDRINUSE;
+        return -1;
+    }
+    return unlink(path) == -1 && errno != ENOENT ? -1 : 0;
+}
+
+int serverOpen(Server *server, const char *spec, int epoll_fd) {
+    memset(server, 0, sizeof(*server));
+    server->listen_fd = -1;
+    server->epoll_fd = epoll_fd;
+    struct sockaddr_storage addr;
+    socklen_t len;
+    if (serveAddress(spec, &addr, &len) == -1) {
+        return -1;
+    }
+    server->buf = malloc(SERVE_BUFFER_SIZE);
+    if (!server->buf) {
+        return -1;
+    }
+    server->cap = SERVE_BUFFER_SIZE;
+    if (addr.ss_family == AF_UNIX && removeStaleSocket(((struct sockaddr_un *) &addr)->sun_path, &addr, len) == -1) {
+        int saved = errno;
+        serverClose(server);
+        errno = saved;
+        return -1;
+    }
+    server->listen_fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd == -1) {
+        serverClose(server);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = server };
+    if (bind(server->listen_fd, (struct sockaddr *) &addr, len) == -1) {
+        int saved = errno;
+        serverClose(server);
+        errno = saved;
+        return -1;
+    }
+    if (addr.ss_family == AF_UNIX) {
+        // Only the file this server bound is removed again on close
+        server->path = strdup(((struct sockaddr_un *) &addr)->sun_path);
+        if (!server->path) {
+            unlink(((struct sockaddr_un *) &addr)->sun_path);
+            serverClose(server);
+            return -1;
+        }
+    }
+    if (listen(server->listen_fd, SERVE_BACKLOG) == -1 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event) == -1) {
+        int saved = errno;
+        serverClose(server);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Appends to the exposition body, growing the buffer if a sample needs more room.
+ */
+static void metricPrintf(Server *server, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(server->buf + server->len, server->cap - server->len, fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return;
+    }
+    if ((size_t) n >= server->cap - server->len) {
+        size_t cap = server->cap * 2;
+        while (cap < server->len + n + 1) cap *= 2;
+        char *grown = realloc(server->buf, cap);
+        if (!grown) {
+            return;
+        }
+        server->buf = grown;
+        server->cap = cap;
+        va_start(args, fmt);
+        vsnprintf(server->buf + server->len, server->cap - server->len, fmt, args);
+        va_end(args);
+    }
+    server->len += n;
+}
+
+static void metricHeader(Server *server, const char *name, const char *type, const char *help) {
+    metricPrintf(server, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void serverPublish(Server *server, const SampleSet *set, int cores, int sessions, double uptime, double cpu_usage) {
+    // The body goes after room for the HTTP header, which is written in front of it at the end
+    server->len = SERVE_HEADER_RESERVE;
+    const MemoryInfo *m = &set->memory;
+    metricHeader(server, "mystats_memory_total_bytes", "gauge", "Total physical memory.");
+    metricPrintf(server, "mystats_memory_total_bytes %.0f\n", m->total_memory * 1e9);
+    metricHeader(server, "mystats_memory_used_bytes", "gauge", "Used physical memory.");
+    metricPrintf(server, "mystats_memory_used_bytes %.0f\n", m->used_memory * 1e9);
+    metricHeader(server, "mystats_virtual_total_bytes", "gauge", "Total virtual memory (physical memory and swap).");
+    metricPrintf(server, "mystats_virtual_total_bytes %.0f\n", m->total_virtual * 1e9);
+    metricHeader(server, "mystats_virtual_used_bytes", "gauge", "Used virtual memory (physical memory and swap).");
+    metricPrintf(server, "mystats_virtual_used_bytes %.0f\n", m->used_virtual * 1e9);
+    metricHeader(server, "mystats_memory_available_bytes", "gauge", "Memory available without swapping (MemAvailable).");
+    metricPrintf(server, "mystats_memory_available_bytes %.0f\n", m->available * 1e9);
+    metricHeader(server, "mystats_memory_cached_bytes", "gauge", "Page cache (Cached).");
+    metricPrintf(server, "mystats_memory_cached_bytes %.0f\n", m->cached * 1e9);
+    metricHeader(server, "mystats_memory_buffers_bytes", "gauge", "Block device buffers (Buffers).");
+    metricPrintf(server, "mystats_memory_buffers_bytes %.0f\n", m->buffers * 1e9);
+    metricHeader(server, "mystats_memory_dirty_bytes", "gauge", "Page cache waiting to be written back (Dirty).");
+    metricPrintf(server, "mystats_memory_dirty_bytes %.0f\n", m->dirty * 1e9);
+    metricHeader(server, "mystats_memory_writeback_bytes", "gauge", "Page cache being written back (Writeback).");
+    metricPrintf(server, "mystats_memory_writeback_bytes %.0f\n", m->writeback * 1e9);
+    metricHeader(server, "mystats_memory_anon_bytes", "gauge", "Anonymous memory (AnonPages).");
+    metricPrintf(server, "mystats_memory_anon_bytes %.0f\n", m->anon_pages * 1e9);
+    metricHeader(server, "mystats_memory_slab_bytes", "gauge", "Kernel slab caches (Slab).");
+    metricPrintf(server, "mystats_memory_slab_bytes %.0f\n", m->slab * 1e9);
+    metricHeader(server, "mystats_hugepages_total_bytes", "gauge", "Memory in the huge page pool.");
+    metricPrintf(server, "mystats_hugepages_total_bytes %.0f\n", m->huge_total * 1e9);
+    metricHeader(server, "mystats_hugepages_free_bytes", "gauge", "Free memory in the huge page pool.");
+    metricPrintf(server, "mystats_hugepages_free_bytes %.0f\n", m->huge_free * 1e9);
+    metricHeader(server, "mystats_cpu_busy_ticks_total", "counter", "Non-idle CPU time from /proc/stat, in clock ticks.");
+    metricPrintf(server, "mystats_cpu_busy_ticks_total %ld\n", set->cpu.total.tot);
+    for (int c = 0; c < set->cpu.ncores; c++) {
+        metricPrintf(server, "mystats_cpu_busy_ticks_total{core=\"%d\"} %ld\n", c, set->cpu.cores[c].tot);
+    }
+    metricHeader(server, "mystats_cpu_idle_ticks_total", "counter", "Idle CPU time from /proc/stat, in clock ticks.");
+    metricPrintf(server, "mystats_cpu_idle_ticks_total %ld\n", set->cpu.total.time);
+    for (int c = 0; c < set->cpu.ncores; c++) {
+        metricPrintf(server, "mystats_cpu_idle_ticks_total{core=\"%d\"} %ld\n", c, set->cpu.cores[c].time);
+    }
+    metricHeader(server, "mystats_cpu_usage_percent", "gauge", "CPU usage over the last sampling interval.");
+    metricPrintf(server, "mystats_cpu_usage_percent %.2f\n", cpu_usage);
+    metricHeader(server, "mystats_cores", "gauge", "Number of processor cores.");
+    metricPrintf(server, "mystats_cores %d\n", cores);
+    metricHeader(server, "mystats_sessions", "gauge", "Number of user sessions.");
+    metricPrintf(server, "mystats_sessions %d\n", sessions);
+    metricHeader(server, "mystats_uptime_seconds", "gauge", "Time since boot.");
+    metricPrintf(server, "mystats_uptime_seconds %.2f\n", uptime);
+
+    char header[SERVE_HEADER_RESERVE];
+    int n = snprintf(header, sizeof(header),
+        "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+        server->len - SERVE_HEADER_RESERVE);
+    server->response = server->buf + SERVE_HEADER_RESERVE - n;
+    memcpy(server->response, header, (size_t) n);
+    server->response_len = server->len - SERVE_HEADER_RESERVE + (size_t) n;
+    server->samples++;
+}
+
+static void closeClient(Server *server, ServeClient *client) {
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    if (client->prev) client->prev->next = client->next;
+    else server->clients = client->next;
+    if (client->next) client->next->prev = client->prev;
+    free(client->copy);
+    free(client);
+    server->active--;
+}
+
+static void acceptClients(Server *server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            // EAGAIN once the backlog is empty; anything else is the client's problem
+            return;
+        }
+        ServeClient *client = calloc(1, sizeof(*client));
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = client };
+        if (!client || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            free(client);
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->since = nowNanos();
+        client->next = server->clients;
+        if (server->clients) server->clients->prev = client;
+        server->clients = client;
+        server->connections++;
+        if (++server->active > server->peak) server->peak = server->active;
+    }
+}
+
+/**
+ * Sends what is left of the response; returns true once the client can be closed.
+ */
+static bool sendResponse(Server *server, ServeClient *client) {
+    while (client->left > 0) {
+        ssize_t n = send(client->fd, client->out, client->left, MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && errno == EAGAIN) {
+            if (!client->copy) {
+                // The shared response may be rebuilt before this client catches up
+                client->copy = malloc(client->left);
+                if (!client->copy) return true;
+                memcpy(client->copy, client->out, client->left);
+                client->out = client->copy;
+                struct epoll_event event = { .events = EPOLLOUT, .data.ptr = client };
+                epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+            }
+            return false;
+        }
+        if (n <= 0) {
+            return true;
+        }
+        client->out += n;
+        client->left -= (size_t) n;
+    }
+    server->scrapes++;
+    return true;
+}
+
+/**
+ * Reads the request until its blank line; the request itself is not needed, every
+ * request is answered with the exposition.
+ */
+static bool readRequest(ServeClient *client) {
+    char buf[1024];
+    for (;;) {
+        ssize_t n = recv(client->fd, buf, sizeof(buf), 0);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && errno == EAGAIN) return false;
+        if (n <= 0) {
+            // The peer went away before the end of its request
+            client->request = SERVE_REQUEST_MAX + 1;
+            return true;
+        }
+        client->request += (size_t) n;
+        for (ssize_t k = 0; k < n; k++) {
+            // Track the "\r\n\r\n" (or "\n\n") that ends the header
+            if (buf[k] == '\n') client->matched++;
+            else if (buf[k] != '\r') client->matched = 0;
+            if (client->matched == 2) return true;
+        }
+        if (client->request > SERVE_REQUEST_MAX) return true;
+    }
+}
+
+void serverEvent(Server *server, void *tag, uint32_t events) {
+    if (tag == server) {
+        acceptClients(server);
+        return;
+    }
+    ServeClient *client = tag;
+    if (events & EPOLLOUT) {
+        if (sendResponse(server, client)) closeClient(server, client);
+        return;
+    }
+    if (!readRequest(client)) {
+        return;
+    }
+    if (client->request > SERVE_REQUEST_MAX || !server->response) {
+        closeClient(server, client);
+        return;
+    }
+    client->out = server->response;
+    client->left = server->response_len;
+    if (sendResponse(server, client)) closeClient(server, client);
+}
+
+void serverExpire(Server *server, uint64_t now) {
+    ServeClient *client = server->clients;
+    while (client) {
+        ServeClient *next = client->next;
+        if (now - client->since > SERVE_CLIENT_TIMEOUT) {
+            closeClient(server, client);
+            server->expired++;
+        }
+        client = next;
+    }
+}
+
+void serverClose(Server *server) {
+    while (server->clients) {
+        closeClient(server, server->clients);
+    }
+    if (server->listen_fd != -1) {
+        close(server->listen_fd);
+        server->listen_fd = -1;
+    }
+    if (server->path) {
+        unlink(server->path);
+        free(server->path);
+        server->path = NULL;
+    }
+    free(server->buf);
+    server->buf = NULL;
+}
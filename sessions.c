@@ -0,0 +1,175 @@
+#define _GNU_SOURCE
+#include "header.h"
+#include <sys/inotify.h>
+#include <fcntl.h>
+
+/**
+ * Orders session keys by process id, then by terminal.
+ */
+static int compareKeys(const void *a, const void *b) {
+    const SessionKey *x = a, *y = b;
+    if (x->pid != y->pid) {
+        return x->pid < y->pid ? -1 : 1;
+    }
+    return strncmp(x->line, y->line, sizeof(x->line));
+}
+
+/**
+ * Watches the utmp file for changes. While it cannot be watched, the list is re-read every time.
+ */
+static void addWatch(SessionWatch *watch) {
+    char path[PROC_PATH_LEN];
+    const char *utmp = procPath(_PATH_UTMP, path, sizeof(path));
+    if (watch->fd != -1 && watch->wd == -1 && utmp) {
+        watch->wd = inotify_add_watch(watch->fd, utmp, IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+    }
+}
+
+int sessionsOpen(SessionWatch *watch) {
+    memset(watch, 0, sizeof(*watch));
+    watch->wd = -1;
+    watch->stale = true;
+    // Without inotify the watch still works, it just reads utmp on every refresh
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    addWatch(watch);
+    return 0;
+}
+
+void sessionsClose(SessionWatch *watch) {
+    if (watch->fd != -1) {
+        close(watch->fd);
+    }
+    free(watch->list);
+    free(watch->keys);
+    free(watch->previous);
+    memset(watch, 0, sizeof(*watch));
+    watch->fd = -1;
+    watch->wd = -1;
+}
+
+/**
+ * Reads every pending inotify event and marks the list stale if utmp changed.
+ */
+static void drainEvents(SessionWatch *watch) {
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    while ((n = read(watch->fd, events, sizeof(events))) > 0) {
+        watch->stale = true;
+        for (char *p = events; p < events + n; p += sizeof(struct inotify_event) + ((struct inotify_event *) p)->len) {
+            const struct inotify_event *event = (const struct inotify_event *) p;
+            // The file was removed or replaced: watch the new one on the next refresh
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                if (watch->wd != -1) inotify_rm_watch(watch->fd, watch->wd);
+                watch->wd = -1;
+            }
+        }
+    }
+}
+
+/**
+ * Makes sure the formatted list can take one more line.
+ */
+static int reserveLine(SessionWatch *watch) {
+    if (watch->cap - watch->len >= MAX_STR_LEN) {
+        return 0;
+    }
+    size_t new_cap = watch->cap ? watch->cap * 2 : 4 * MAX_STR_LEN;
+    char *grown = realloc(watch->list, new_cap);
+    if (!grown) {
+        return -1;
+    }
+    watch->list = grown;
+    watch->cap = new_cap;
+    return 0;
+}
+
+/**
+ * Makes sure both key arrays can hold `count` keys.
+ */
+static int reserveKeys(SessionWatch *watch, int count) {
+    if (count <= watch->keys_cap) {
+        return 0;
+    }
+    int new_cap = watch->keys_cap ? watch->keys_cap * 2 : 64;
+    while (new_cap < count) new_cap *= 2;
+    SessionKey *keys = realloc(watch->keys, (size_t) new_cap * sizeof(SessionKey));
+    if (!keys) {
+        return -1;
+    }
+    watch->keys = keys;
+    SessionKey *previous = realloc(watch->previous, (size_t) new_cap * sizeof(SessionKey));
+    if (!previous) {
+        return -1;
+    }
+    watch->previous = previous;
+    watch->keys_cap = new_cap;
+    return 0;
+}
+
+/**
+ * Re-reads utmp into the formatted list and the sorted keys of the sessions.
+ */
+static int readList(SessionWatch *watch) {
+    char path[PROC_PATH_LEN];
+    const char *utmp = procPath(_PATH_UTMP, path, sizeof(path));
+    if (!utmp || utmpname(utmp) != 0) {
+        return -1;
+    }
+    setutent();
+    watch->len = 0;
+    watch->count = 0;
+    struct utmp *entry;
+    while ((entry = getutent()) != NULL) {
+        if (entry->ut_type != USER_PROCESS) {
+            continue;
+        }
+        if (reserveLine(watch) == -1 || reserveKeys(watch, watch->count + 1) == -1) {
+            endutent();
+            return -1;
+        }
+        watch->len += snprintf(watch->list + watch->len, watch->cap - watch->len, "%s\t%s (%s)\n", entry->ut_user, entry->ut_line, entry->ut_host);
+        SessionKey *key = &watch->keys[watch->count++];
+        key->pid = entry->ut_pid;
+        memcpy(key->line, entry->ut_line, sizeof(key->line));
+    }
+    endutent();
+    qsort(watch->keys, (size_t) watch->count, sizeof(SessionKey), compareKeys);
+    return 0;
+}
+
+int sessionsRefresh(SessionWatch *watch) {
+    watch->logins = 0;
+    watch->logouts = 0;
+    if (watch->fd != -1) {
+        drainEvents(watch);
+        addWatch(watch);
+    }
+    if (!watch->stale) {
+        return 0;
+    }
+    // Keep the old keys to count who came and went
+    int old_count = watch->count;
+    if (old_count > 0) {
+        memcpy(watch->previous, watch->keys, (size_t) old_count * sizeof(SessionKey));
+    }
+    if (readList(watch) == -1) {
+        return -1;
+    }
+    // Stay stale while nothing watches the file
+    watch->stale = watch->wd == -1;
+    if (watch->version > 0) {
+        int i = 0, j = 0;
+        while (i < old_count || j < watch->count) {
+            int order = i == old_count ? 1 : j == watch->count ? -1 : compareKeys(&watch->previous[i], &watch->keys[j]);
+            if (order < 0) { watch->logouts++; i++; }
+            else if (order > 0) { watch->logins++; j++; }
+            else { i++; j++; }
+        }
+        if (watch->logins == 0 && watch->logouts == 0 && old_count == watch->count) {
+            // utmp was rewritten with the same sessions, e.g. an idle-time update
+            return 0;
+        }
+    }
+    watch->version++;
+    return 1;
+}
@@ -0,0 +1,184 @@
+#define _GNU_SOURCE
+#include "header.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+static const char shmMagic[8] = SHM_MAGIC;
+
+static size_t segmentSize(uint32_t capacity) {
+    return offsetof(ShmSegment, slots) + (size_t) capacity * sizeof(ShmSlot);
+}
+
+/**
+ * Maps a freshly created segment and fills in its header.
+ */
+static int initSegment(ShmPublisher *pub, int fd, uint64_t interval) {
+    pub->size = segmentSize(SHM_CAPACITY);
+    if (ftruncate(fd, (off_t) pub->size) == -1) {
+        return -1;
+    }
+    void *map = mmap(NULL, pub->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    // ftruncate zero-fills the segment, so every slot starts out as never written
+    pub->segment = map;
+    memcpy(pub->segment->magic, shmMagic, sizeof(shmMagic));
+    pub->segment->version = SHM_VERSION;
+    pub->segment->capacity = SHM_CAPACITY;
+    pub->segment->interval = interval;
+    pub->segment->pid = getpid();
+    __atomic_store_n(&pub->segment->running, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * Tells whether the daemon of a segment is still running: it holds an exclusive lock on the
+ * segment for as long as it lives, and the kernel drops the lock however the daemon ends.
+ */
+static bool daemonAlive(int fd) {
+    if (flock(fd, LOCK_SH | LOCK_NB) == 0) {
+        flock(fd, LOCK_UN);
+        return false;
+    }
+    return errno == EWOULDBLOCK;
+}
+
+int shmCreate(ShmPublisher *pub, const char *name, uint64_t interval) {
+    memset(pub, 0, sizeof(*pub));
+    pub->name = name;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1 && errno == EEXIST) {
+        // Take over the segment of a daemon that did not exit cleanly, but not of a live one
+        int old = shm_open(name, O_RDONLY, 0);
+        bool alive = old != -1 && daemonAlive(old);
+        if (old != -1) close(old);
+        if (alive) {
+            errno = EEXIST;
+            return -1;
+        }
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    }
+    if (fd == -1) {
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1 || initSegment(pub, fd, interval) == -1) {
+        int saved = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = saved;
+        return -1;
+    }
+    // The descriptor carries the lock, so it stays open until shmDestroy
+    pub->fd = fd;
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    pub->wall_offset = (int64_t) ((uint64_t) real.tv_sec * 1000000000ull + (uint64_t) real.tv_nsec) - (int64_t) nowNanos();
+    return 0;
+}
+
+void shmPublish(ShmPublisher *pub, const SampleSet *set, int cores, int sessions) {
+    ShmSegment *segment = pub->segment;
+    uint64_t index = segment->published;
+    ShmSlot *slot = &segment->slots[index % segment->capacity];
+    // An odd sequence tells readers that the slot is being rewritten
+    __atomic_store_n(&slot->seq, 2 * index + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    recordFromSample(set, cores, sessions, pub->wall_offset, &slot->record);
+    __atomic_store_n(&slot->seq, 2 * index + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&segment->published, index + 1, __ATOMIC_RELEASE);
+}
+
+void shmDestroy(ShmPublisher *pub) {
+    if (!pub->segment) {
+        return;
+    }
+    // Readers that are still attached see that no more samples will come
+    __atomic_store_n(&pub->segment->running, 0, __ATOMIC_RELEASE);
+    munmap(pub->segment, pub->size);
+    shm_unlink(pub->name);
+    close(pub->fd);
+    pub->segment = NULL;
+}
+
+int shmAttach(ShmReader *reader, const char *name) {
+    memset(reader, 0, sizeof(*reader));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t) st.st_size < sizeof(ShmSegment)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    ShmSegment *segment = map;
+    if (memcmp(segment->magic, shmMagic, sizeof(shmMagic)) != 0 || segment->version != SHM_VERSION ||
+        segment->capacity == 0 || segmentSize(segment->capacity) > (size_t) st.st_size) {
+        munmap(map, (size_t) st.st_size);
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    reader->fd = fd;
+    reader->segment = segment;
+    reader->size = (size_t) st.st_size;
+    // Start with whatever history the ring still holds
+    uint64_t published = __atomic_load_n(&segment->published, __ATOMIC_ACQUIRE);
+    reader->next = published > segment->capacity ? published - segment->capacity : 0;
+    return 0;
+}
+
+int shmRead(ShmReader *reader, SampleRecord *record) {
+    const ShmSegment *segment = reader->segment;
+    for (;;) {
+        uint64_t published = __atomic_load_n(&segment->published, __ATOMIC_ACQUIRE);
+        if (reader->next >= published) {
+            return 0;
+        }
+        if (published - reader->next > segment->capacity) {
+            // The writer lapped us: skip to the oldest sample still in the ring
+            reader->dropped += published - segment->capacity - reader->next;
+            reader->next = published - segment->capacity;
+        }
+        const ShmSlot *slot = &segment->slots[reader->next % segment->capacity];
+        uint64_t expect = 2 * reader->next + 2;
+        uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (before == expect) {
+            memcpy(record, (const void *) &slot->record, sizeof(*record));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == expect) {
+                reader->next++;
+                return 1;
+            }
+        }
+        // The writer is reusing the slot for a newer sample: drop this one rather than wait
+        reader->dropped++;
+        reader->next++;
+    }
+}
+
+bool shmAlive(const ShmReader *reader) {
+    return __atomic_load_n(&reader->segment->running, __ATOMIC_ACQUIRE) && daemonAlive(reader->fd);
+}
+
+void shmDetach(ShmReader *reader) {
+    if (reader->segment) {
+        munmap((void *) reader->segment, reader->size);
+        close(reader->fd);
+        reader->segment = NULL;
+    }
+}
@@ -1,76 +1,57 @@
 #include "header.h"
 
-int count_cores() {
-    FILE *fp = fopen("/proc/cpuinfo", "r");
-    if (!fp) return -1;
 
-    char line[256];
-    int cores = 0;
-    while (fgets(line, sizeof(line), fp)) {
-        if (strncmp(line, "processor", 9) == 0) {
-            cores++;
-        }
+double memoryShown(const MemoryInfo *memory, bool available){
+    return available ? memory->available : memory->used_memory;
+}
+void formatMemoryRow(const HistorySample *sample, bool graph, bool available, char *row, size_t len){
+    const char *tail = graph ? "\t|" : "\n";
+    if (! available) snprintf(row, len, "%.2f GB / %.2f GB -- %.2f GB/ %.2f GB%s", sample->memory.used_memory, sample->memory.total_memory, sample->memory.used_virtual, sample->memory.total_virtual, tail);
+    else snprintf(row, len, "%.2f GB avail / %.2f GB -- %.2f GB/ %.2f GB%s", sample->memory.available, sample->memory.total_memory, sample->memory.used_virtual, sample->memory.total_virtual, tail);
+    if (graph){
+        appendMemoryGraphicToTail(memoryShown(&sample->memory, available), sample->memory_delta, row, len);
     }
-
-    fclose(fp);
-    return cores;
 }
-
-void memoryUsage(int samples, int i, MemoryInfo info, bool graph, bool seq, double *previous, char record[][MAX_STR_LEN]){
+void memoryUsage(Frame *frame, const History *history, int window, bool graph, bool seq, bool available){
     struct rusage usage;
-    struct sysinfo sys_info;
     getrusage(RUSAGE_SELF, &usage); 
-    sysinfo(&sys_info);
-    if (sysinfo(&sys_info) == -1) {
-        fprintf(stderr, "Failed to get system information. (%s)\n", strerror(errno));
-        fprintf(stderr, "Terminating the process and its parent.\n");
-        kill(getpid(), SIGTERM); 
-        kill(getppid(), SIGTERM);
-        return;
-    }
-    printf("MemoryUsage: %ld kilobytes\n", usage.ru_maxrss);
-    printf("--------------------------------------------\n");
-    printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)\n");
-    float ram = sys_info.totalram / 1000000000.0;
-    float phys = ram - sys_info.freeram / 1000000000.0;
-    float mem = sys_info.totalswap / 1000000000.0 + ram;
-    float virtual = phys + sys_info.totalswap / 1000000000.0 - sys_info.freeswap / 1000000000.0;
-    if (! graph) sprintf(record[i],"%.2f GB / %.2f GB -- %.2f GB/ %.2f GB\n", info.used_memory, info.total_memory, info.used_virtual, info.total_virtual);
-    else sprintf(record[i],"%.2f GB / %.2f GB -- %.2f GB/ %.2f GB\t|", info.used_memory, info.total_memory, info.used_virtual, info.total_virtual);
-    if (graph){
-        appendMemoryGraphicToTail(info.used_memory, previous, i, record);
-    }
+    framePrintf(frame, "MemoryUsage: %ld kilobytes\n", usage.ru_maxrss);
+    framePrintf(frame, "--------------------------------------------\n");
+    if (! available) framePrintf(frame, "### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)\n");
+    else framePrintf(frame, "### Memory ### (Phys.Avail/Tot -- Virtual Used/Tot)\n");
 
-    for (int j = 0; j <= i; j++){
-        if (!seq || j == i){
-            printf("%s", record[j]);
+    // Rows are only formatted here, when they are printed
+    char row[MAX_STR_LEN];
+    for (int j = 0; j < history->count; j++){
+        if (!seq || j == history->count - 1){
+            formatMemoryRow(historyAt(history, j), graph, available, row, sizeof(row));
+            framePrintf(frame, "%s", row);
         }
         else{
-            printf("\n");
+            framePrintf(frame, "\n");
         }
     }
-    for (int j = 0; j < samples - i - 1; j++){
-        printf("\n");
+    for (int j = 0; j < window - history->count; j++){
+        framePrintf(frame, "\n");
+    }
+    // Recordings and published samples only carry the totals
+    const MemoryInfo *m = history->count > 0 ? &historyAt(history, history->count - 1)->memory : NULL;
+    if (m && m->available > 0){
+        framePrintf(frame, "Available %.2f GB -- cached %.2f, buffers %.2f, dirty %.2f, writeback %.2f GB\n",
+                    m->available, m->cached, m->buffers, m->dirty, m->writeback);
+        framePrintf(frame, "Anon %.2f GB, slab %.2f GB, huge pages %.2f / %.2f GB free\n",
+                    m->anon_pages, m->slab, m->huge_free, m->huge_total);
     }
 }
 void memoryStats(int pipe[2]) {
-    struct sysinfo sys_memory_info;
-    int result = sysinfo(&sys_memory_info);
-
-    if (result != 0) {
+    MemoryInfo memInfo;
+    if (readMemoryInfo(&memInfo) != 0) {
         fprintf(stderr, "Error: %d - %s\n", errno, strerror(errno));
         kill(getpid(), SIGTERM);
         kill(getppid(), SIGTERM);
         return;
     }
 
-    MemoryInfo memInfo;
-    const double convert = 1000000000.0;
-    memInfo.total_memory = (double) sys_memory_info.totalram / convert;
-    memInfo.used_memory = (double) (sys_memory_info.totalram - sys_memory_info.freeram) / convert;
-    memInfo.total_virtual = (double) (sys_memory_info.totalram + sys_memory_info.totalswap) / convert;
-    memInfo.used_virtual = (double) (sys_memory_info.totalram - sys_memory_info.freeram + sys_memory_info.totalswap - sys_memory_info.freeswap) / convert;
-
     ssize_t bytes_written = write(pipe[1], &memInfo, sizeof(memInfo));
 
     if (bytes_written == -1) {
@@ -79,14 +60,9 @@ void memoryStats(int pipe[2]) {
         kill(getppid(), SIGTERM);
     }
 }
-void appendMemoryGraphicToTail(double memory_current, double *memory_previous, int i, char record[][MAX_STR_LEN]) {
-    if (i == 0) {
-        *memory_previous = memory_current;
-    }
-
-    // Calculate the absolute difference in memory usage
-    double diff = memory_current - *memory_previous;
-    double abs_diff = fabs(diff);
+void appendMemoryGraphicToTail(double memory_current, double memory_delta, char *row, size_t len) {
+    // The absolute difference in memory usage
+    double abs_diff = fabs(memory_delta);
 
     // Initialize the visual representation string
     int visual_len = (int)( abs_diff / 0.01 );
@@ -94,7 +70,7 @@ void appendMemoryGraphicToTail(double memory_current, double *memory_previous, i
     char sign;
 
     // Choose the appropriate sign and last character based on the difference in memory usage
-    if (diff >= 0) { 
+    if (memory_delta >= 0) { 
         sign = '#';
         last_char = '*';
         if (visual_len == 0){ 
@@ -106,96 +82,116 @@ void appendMemoryGraphicToTail(double memory_current, double *memory_previous, i
         last_char = '@'; 
     }
 
-    *memory_previous = memory_current;
     // Fill in the visual representation
-    int visual_start = strlen(record[i]);
-    for (int j = 0; j < visual_len && visual_start + j + 6 < 1023; ++j) {
-        record[i][visual_start + j] = sign;
+    size_t visual_start = strlen(row);
+    size_t j;
+    for (j = 0; j < (size_t) visual_len && visual_start + j + 7 < len; ++j) {
+        row[visual_start + j] = sign;
     }
+    row[visual_start + j] = '\0';
 
-    if (visual_start + visual_len + 6 < 1023) {
-        record[i][visual_start + visual_len] = last_char;
+    if (visual_start + visual_len + 7 < len) {
+        row[visual_start + visual_len] = last_char;
         // Account for the newline and null terminator in the remaining space calculation
-        snprintf(record[i] + visual_start + visual_len + 1, 1024 - visual_start - visual_len - 1, " %.2f (%.2f)\n", abs_diff, memory_current);
+        snprintf(row + visual_start + visual_len + 1, len - visual_start - visual_len - 1, " %.2f (%.2f)\n", abs_diff, memory_current);
     }
 }
 
-void userOutput(int pipe[2]) {
+int readSessions(char **buf, size_t *len, size_t *cap) {
     // Set the path to the utmp file to read login records
-    if (utmpname(_PATH_UTMP) != 0) {
-        perror("Error setting utmp file path");
-        kill(getpid(), SIGTERM);
-        kill(getppid(), SIGTERM);
-        return; // Early return as the parent process should decide what to do next
+    char path[PROC_PATH_LEN];
+    const char *utmp = procPath(_PATH_UTMP, path, sizeof(path));
+    if (!utmp || utmpname(utmp) != 0) {
+        return -1;
     }
 
     // Rewind to the start of the utmp file to begin reading
     setutent();
 
+    *len = 0;
     struct utmp *userSession;
     while ((userSession = getutent()) != NULL) { // Read each record
         // Filter for user processes
-        if (userSession->ut_type == USER_PROCESS) {
-            // Prepare a string with user, session ID, and host
-            char buffer[MAX_STR_LEN];
-            snprintf(buffer, sizeof(buffer), "%s\t%s (%s)\n", userSession->ut_user, userSession->ut_line, userSession->ut_host);
-
-            // Write the formatted string to the pipe
-            ssize_t bytesWritten = write(pipe[1], buffer, strlen(buffer));
-            if (bytesWritten == -1) {
-                perror("Error writing to pipe");
-                kill(getpid(), SIGTERM); 
-                kill(getppid(), SIGTERM);
-                return; 
+        if (userSession->ut_type != USER_PROCESS) {
+            continue;
+        }
+        // Grow the buffer so that a full line always fits; this only happens while the session list grows
+        if (*cap - *len < MAX_STR_LEN) {
+            size_t new_cap = *cap ? *cap * 2 : 4 * MAX_STR_LEN;
+            char *grown = realloc(*buf, new_cap);
+            if (!grown) {
+                endutent();
+                return -1;
             }
+            *buf = grown;
+            *cap = new_cap;
         }
+        // Append a line with user, session ID, and host
+        *len += snprintf(*buf + *len, *cap - *len, "%s\t%s (%s)\n", userSession->ut_user, userSession->ut_line, userSession->ut_host);
     }
-    // Cleanup: Close the utmp file and the write-end of the pipe
     endutent();
-    close(pipe[1]);
+    return 0;
 }
-void cpuStats(int pipe[2]) {
-    CPU cpu_stats;
-    // Attempt to retrieve system info
-    if (sysinfo(&(struct sysinfo){}) != 0) {
-        fprintf(stderr, "Error: (%s)\n", strerror(errno));
+void userOutput(int pipe[2]) {
+    char *buffer = NULL;
+    size_t len = 0, cap = 0;
+    if (readSessions(&buffer, &len, &cap) != 0) {
+        perror("Error reading utmp file");
         kill(getpid(), SIGTERM);
         kill(getppid(), SIGTERM);
-        return; // Ensures that we don't execute further code
+        return; // Early return as the parent process should decide what to do next
     }
 
-    FILE *fp = fopen("/proc/stat", "r");
-    if (!fp) {
-        fprintf(stderr, "Error: (%s)\n", strerror(errno));
-        kill(getpid(), SIGTERM);
+    // Write the formatted lines to the pipe
+    ssize_t bytesWritten = write(pipe[1], buffer, len);
+    free(buffer);
+    if (bytesWritten == -1) {
+        perror("Error writing to pipe");
+        kill(getpid(), SIGTERM); 
         kill(getppid(), SIGTERM);
-        return;
+        return; 
     }
-
-    long int user, nice, system, idle, iowait, irq, softirq;
-    int read_items = fscanf(fp, "cpu %ld %ld %ld %ld %ld %ld %ld", 
-                            &user, &nice, &system, &idle, 
-                            &iowait, &irq, &softirq);
-    cpu_stats.tot = user + nice + system + iowait + irq + softirq;
-    cpu_stats.time = idle;
-    fclose(fp); 
-    if (read_items != 7) {
-        fprintf(stderr, "Error\n");
+    // Cleanup: Close the write-end of the pipe
+    close(pipe[1]);
+}
+void cpuStats(int pipe[2]) {
+    CpuSample cpu_stats;
+    if (readCpuStats(&cpu_stats) != 0) {
+        fprintf(stderr, "Error: (%s)\n", strerror(errno));
         kill(getpid(), SIGTERM);
         kill(getppid(), SIGTERM);
-        return;
+        return; // Ensures that we don't execute further code
     }
-    ssize_t bytes_written = write(pipe[1], &cpu_stats, sizeof(cpu_stats));
-    if (bytes_written == -1) {
+    if (writeFull(pipe[1], &cpu_stats, CPU_SAMPLE_SIZE(cpu_stats.ncores)) == -1) {
         perror("Error writing to pipe");
         kill(getpid(), SIGTERM);
         kill(getppid(),SIGTERM);
     }  
 }
 
+/**
+ * Reads one line of a /proc/sys/kernel file into `value`, without its newline.
+ */
+static void readKernelString(const char *path, char *value, size_t len) {
+    ProcFile file;
+    snprintf(value, len, "unknown");
+    if (procOpen(&file, path, PROC_UPTIME_SIZE) == 0 && procRead(&file) == 0) {
+        snprintf(value, len, "%.*s", (int) strcspn(file.buf, "\n"), file.buf);
+    }
+    procClose(&file);
+}
+
 void getOSInfo() {
     struct utsname unameData;
     uname(&unameData);
+    if (procRooted()) {
+        // A captured host: the same fields from the files that mirror them, except the architecture
+        readKernelString("/proc/sys/kernel/ostype", unameData.sysname, sizeof(unameData.sysname));
+        readKernelString("/proc/sys/kernel/hostname", unameData.nodename, sizeof(unameData.nodename));
+        readKernelString("/proc/sys/kernel/version", unameData.version, sizeof(unameData.version));
+        readKernelString("/proc/sys/kernel/osrelease", unameData.release, sizeof(unameData.release));
+        snprintf(unameData.machine, sizeof(unameData.machine), "unknown");
+    }
     printf("System Name = %s\n", unameData.sysname);
     printf("Machine Name = %s\n", unameData.nodename);
     printf("Version = %s\n", unameData.version);
@@ -219,18 +215,13 @@ bool isInteger(const char *str) {
     return true; // Only digit characters were found
 }
 void getUptime() {
-    FILE* uptimefile;
     int days, hours, minutes, seconds, total_hours;
-    float uptime_seconds;
+    double uptime_seconds;
 
-    uptimefile = fopen("/proc/uptime", "r");
-    if (uptimefile == NULL) {
-        perror("Error opening uptime file");
+    if (readUptime(&uptime_seconds) == -1) {
+        perror("Error reading uptime file");
         exit(1);
     }
-   
-    fscanf(uptimefile, "%f", &uptime_seconds);
-    fclose(uptimefile);
     days = (int)uptime_seconds / (24 * 3600);
     uptime_seconds -= days * (24 * 3600);
     hours = (int)uptime_seconds / 3600;
@@ -248,30 +239,26 @@ void systemInfo(){
     getUptime();
 }
 
-void appendAndPrintCpuGraphics(double usage, int i, char record[][MAX_STR_LEN]) {
+void formatCpuRow(double usage, char *row, size_t len) {
    // Construct the graphical representation
     int usageBars = (int)usage;
     int visualLength = usageBars + 3; // Starting '|||' plus usage bars
-    if (visualLength > MAX_STR_LEN - 10) {
-        visualLength = MAX_STR_LEN - 10; // Reserve space for usage text
+    if (visualLength > (int) len - 10) {
+        visualLength = (int) len - 10; // Reserve space for usage text
     }
 
-    // Initialize the string with spaces
-    memset(record[i], ' ', MAX_STR_LEN - 1);
-    record[i][MAX_STR_LEN - 1] = '\0'; // Ensure string is null-terminated
-
     // Build the graphical representation
-    strncpy(record[i], "|||", 3);
-    for (int j = 3; j < visualLength; ++j) {
-        record[i][j] = '|';
-    }
-    snprintf(record[i] + visualLength, MAX_STR_LEN - visualLength, " %.2f%%", usage);
-
-    for (int j = 0; j <= i; j++){
-        printf("%s\n", record[j]);
+    memset(row, '|', visualLength);
+    snprintf(row + visualLength, len - visualLength, " %.2f%%", usage);
+}
+void appendAndPrintCpuGraphics(Frame *frame, const History *history) {
+    char row[MAX_STR_LEN];
+    for (int j = 0; j < history->count; j++){
+        formatCpuRow(historyAt(history, j)->cpu_usage, row, sizeof(row));
+        framePrintf(frame, "%s\n", row);
     }
 }
-void cpu_output(bool graphics, int i, long int* cpu_previous, long int* time_previous, CPU info, char record[][MAX_STR_LEN]){
+double cpuUsage(CPU info, long int* cpu_previous, long int* time_previous){
     long int total_prev = *cpu_previous + *time_previous;
     long int total_cur = info.time + info.tot;
     double totald = (double) total_cur - (double) total_prev;
@@ -280,10 +267,44 @@ void cpu_output(bool graphics, int i, long int* cpu_previous, long int* time_pre
     if (cpu_use > 100){ cpu_use = 100; }
     *cpu_previous = info.tot;
     *time_previous = info.time;
-    printf("--------------------------------------------\n");
-    printf("Number of Cores: %d\n", count_cores());
-    printf("CPU Usage: %.2f%%\n", cpu_use);
+    return cpu_use;
+}
+void cpu_output(Frame *frame, bool graphics, const History *history, int cores){
+    framePrintf(frame, "--------------------------------------------\n");
+    framePrintf(frame, "Number of Cores: %d\n", cores);
+    framePrintf(frame, "CPU Usage: %.2f%%\n", historyAt(history, history->count - 1)->cpu_usage);
     if(graphics){
-        appendAndPrintCpuGraphics(cpu_use, i, record);
+        appendAndPrintCpuGraphics(frame, history);
     }
-}
\ No newline at end of file
+}
+void perCoreOutput(Frame *frame, const double *usage, int ncores, int hottest) {
+    framePrintf(frame, "--------------------------------------------\n");
+    framePrintf(frame, "### Per-core ### (%d cores)\n", ncores);
+    for (int c = 0; c < ncores; c++) {
+        // One bar character per 10%, rounded to the nearest
+        int bars = (int) ((usage[c] + 5) / 10);
+        framePrintf(frame, "%4d [%-10.*s] %5.1f%%", c, bars, "##########", usage[c]);
+        framePrintf(frame, "%s", (c + 1) % CORE_COLUMNS == 0 || c + 1 == ncores ? "\n" : "   ");
+    }
+
+    // Keep the hottest cores in a small array sorted by decreasing usage
+    if (hottest > ncores) hottest = ncores;
+    int top[hottest > 0 ? hottest : 1];
+    int found = 0;
+    for (int c = 0; c < ncores; c++) {
+        if (found == hottest && usage[c] <= usage[top[found - 1]]) {
+            continue;
+        }
+        int j = found < hottest ? found++ : found - 1;
+        while (j > 0 && usage[top[j - 1]] < usage[c]) {
+            top[j] = top[j - 1];
+            j--;
+        }
+        top[j] = c;
+    }
+    framePrintf(frame, "Hottest:");
+    for (int j = 0; j < found; j++) {
+        framePrintf(frame, " cpu%d %.1f%%", top[j], usage[top[j]]);
+    }
+    framePrintf(frame, "\n");
+}
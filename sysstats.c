@@ -0,0 +1,191 @@
+#include "procfs.h"
+
+/**
+ * The files of an open sampler; they stay open and are re-read with pread.
+ */
+struct SysStats {
+    unsigned flags;
+    ProcFile meminfo;
+    MeminfoIndex meminfo_index;
+    ProcFile stat;
+    ProcFile utmp;
+    int cores;
+};
+
+// /proc files read outside a sampler stay open for the life of the process and are re-read with pread
+static ProcFile meminfoFile = { .fd = -1 };
+static MeminfoIndex meminfoIndex;
+static ProcFile statFile = { .fd = -1 };
+static ProcFile uptimeFile = { .fd = -1 };
+
+/**
+ * Counts the cores listed in /proc/cpuinfo.
+ */
+static int readCoreCount(void) {
+    ProcFile cpuinfo;
+    if (procOpen(&cpuinfo, "/proc/cpuinfo", PROC_CPUINFO_SIZE) == -1) return -1;
+    int cores = -1;
+    if (procRead(&cpuinfo) == 0) {
+        cores = parseCoreCount(cpuinfo.buf);
+    }
+    procClose(&cpuinfo);
+    return cores;
+}
+
+int count_cores() {
+    // The core count does not change while we run, so /proc/cpuinfo is only parsed once
+    static int cores = -1;
+    if (cores == -1) cores = readCoreCount();
+    return cores;
+}
+
+/**
+ * Reads /proc/meminfo into a SysStatsMemory, in GB.
+ */
+static int sampleMemory(ProcFile *file, MeminfoIndex *index, SysStatsMemory *memInfo) {
+    uint64_t kb[MEMINFO_FIELDS];
+    if (procRead(file) == -1 || parseMeminfo(file->buf, file->len, index, kb) == -1) {
+        return -1;
+    }
+    const double convert = 1000000000.0 / 1024.0;
+    memInfo->total_memory = (double) kb[MEMINFO_TOTAL] / convert;
+    memInfo->used_memory = (double) (kb[MEMINFO_TOTAL] - kb[MEMINFO_FREE]) / convert;
+    memInfo->total_virtual = (double) (kb[MEMINFO_TOTAL] + kb[MEMINFO_SWAP_TOTAL]) / convert;
+    memInfo->used_virtual = (double) (kb[MEMINFO_TOTAL] - kb[MEMINFO_FREE] + kb[MEMINFO_SWAP_TOTAL] - kb[MEMINFO_SWAP_FREE]) / convert;
+    // Kernels before 3.14 have no MemAvailable; free memory and caches are the usual estimate
+    uint64_t available = index->offset[MEMINFO_AVAILABLE] != MEMINFO_MISSING ? kb[MEMINFO_AVAILABLE]
+                         : kb[MEMINFO_FREE] + kb[MEMINFO_BUFFERS] + kb[MEMINFO_CACHED];
+    memInfo->available = (double) available / convert;
+    memInfo->cached = (double) kb[MEMINFO_CACHED] / convert;
+    memInfo->buffers = (double) kb[MEMINFO_BUFFERS] / convert;
+    memInfo->dirty = (double) kb[MEMINFO_DIRTY] / convert;
+    memInfo->writeback = (double) kb[MEMINFO_WRITEBACK] / convert;
+    memInfo->anon_pages = (double) kb[MEMINFO_ANON_PAGES] / convert;
+    memInfo->slab = (double) kb[MEMINFO_SLAB] / convert;
+    memInfo->huge_total = (double) (kb[MEMINFO_HUGE_TOTAL] * kb[MEMINFO_HUGE_SIZE]) / convert;
+    memInfo->huge_free = (double) (kb[MEMINFO_HUGE_FREE] * kb[MEMINFO_HUGE_SIZE]) / convert;
+    return 0;
+}
+
+int readMemoryInfo(SysStatsMemory *memInfo) {
+    if (meminfoFile.fd == -1 && procOpen(&meminfoFile, "/proc/meminfo", PROC_MEMINFO_SIZE) == -1) {
+        return -1;
+    }
+    return sampleMemory(&meminfoFile, &meminfoIndex, memInfo);
+}
+
+int readCpuStats(SysStatsCpuSample *cpu_stats) {
+    if (statFile.fd == -1 && procOpen(&statFile, "/proc/stat", PROC_STAT_SIZE) == -1) {
+        return -1;
+    }
+    if (procRead(&statFile) == -1) {
+        return -1;
+    }
+    return parseCpuCores(statFile.buf, cpu_stats);
+}
+
+int readUptime(double *seconds) {
+    if (uptimeFile.fd == -1 && procOpen(&uptimeFile, "/proc/uptime", PROC_UPTIME_SIZE) == -1) {
+        return -1;
+    }
+    if (procRead(&uptimeFile) == -1) {
+        return -1;
+    }
+    return parseUptime(uptimeFile.buf, seconds);
+}
+
+/**
+ * Counts the user sessions in a utmp file read into memory.
+ */
+static int countUtmpSessions(const ProcFile *utmp) {
+    int sessions = 0;
+    const struct utmp *entry = (const struct utmp *) utmp->buf;
+    for (size_t k = 0; k < utmp->len / sizeof(struct utmp); k++) {
+        if (entry[k].ut_type == USER_PROCESS) sessions++;
+    }
+    return sessions;
+}
+
+int sysstats_root(const char *dir) {
+    return procSetRoot(dir);
+}
+
+SysStats *sysstats_open(unsigned flags) {
+    SysStats *stats = calloc(1, sizeof(*stats));
+    if (!stats) {
+        return NULL;
+    }
+    stats->flags = flags;
+    stats->meminfo.fd = -1;
+    stats->stat.fd = -1;
+    stats->utmp.fd = -1;
+    if ((flags & SYSSTATS_MEMORY) && procOpen(&stats->meminfo, "/proc/meminfo", PROC_MEMINFO_SIZE) == -1) {
+        sysstats_close(stats);
+        return NULL;
+    }
+    if ((flags & SYSSTATS_CPU) && procOpen(&stats->stat, "/proc/stat", PROC_STAT_SIZE) == -1) {
+        sysstats_close(stats);
+        return NULL;
+    }
+    // No utmp file just means that nobody is logged in
+    if ((flags & SYSSTATS_SESSIONS) && procOpen(&stats->utmp, _PATH_UTMP, PROC_UTMP_SIZE) == -1 && errno != ENOENT) {
+        sysstats_close(stats);
+        return NULL;
+    }
+    stats->cores = count_cores();
+    return stats;
+}
+
+int sysstats_sample(SysStats *stats, SysStatsSnapshot *snapshot) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    snapshot->timestamp = (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+    snapshot->cores = stats->cores;
+    if ((stats->flags & SYSSTATS_MEMORY) && sampleMemory(&stats->meminfo, &stats->meminfo_index, &snapshot->memory) == -1) {
+        return -1;
+    }
+    if (stats->flags & SYSSTATS_CPU) {
+        if (procRead(&stats->stat) == -1 || parseCpuCores(stats->stat.buf, &snapshot->cpu) == -1) {
+            return -1;
+        }
+    }
+    if (stats->flags & SYSSTATS_SESSIONS) {
+        if (stats->utmp.fd == -1) {
+            snapshot->sessions = 0;
+        }
+        else if (procRead(&stats->utmp) == -1) {
+            return -1;
+        }
+        else {
+            snapshot->sessions = countUtmpSessions(&stats->utmp);
+        }
+    }
+    return 0;
+}
+
+void sysstats_close(SysStats *stats) {
+    if (!stats) {
+        return;
+    }
+    procClose(&stats->meminfo);
+    procClose(&stats->stat);
+    procClose(&stats->utmp);
+    free(stats);
+}
+
+double sysstats_cpu_usage(const SysStatsCpu *previous, const SysStatsCpu *current) {
+    double usage;
+    sysstats_core_usage(previous, current, 1, &usage);
+    return usage;
+}
+
+void sysstats_core_usage(const SysStatsCpu *previous, const SysStatsCpu *current, int ncores, double *usage) {
+    for (int c = 0; c < ncores; c++) {
+        double busy = (double) current[c].tot - (double) previous[c].tot;
+        double idle = (double) current[c].time - (double) previous[c].time;
+        double total = busy + idle;
+        usage[c] = total > 0 ? 100.0 * busy / total : 0.0;
+        if (usage[c] < 0) usage[c] = 0;
+        if (usage[c] > 100) usage[c] = 100;
+    }
+}
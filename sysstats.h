@@ -0,0 +1,194 @@
+#ifndef SYSSTATS_H
+#define SYSSTATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * libsysstats: the collectors of mySystemStats as an in-process library.
+ *
+ * A SysStats handle keeps the /proc and utmp files it needs open, and every call to
+ * sysstats_sample re-reads them into a caller-provided snapshot. Nothing is printed and
+ * nothing is allocated per sample, so the handle can be polled at a high rate.
+ */
+
+/**
+ * @brief Marks the functions exported by libsysstats.so; everything else is built hidden.
+ */
+#if defined(__GNUC__)
+#define SYSSTATS_API __attribute__((visibility("default")))
+#else
+#define SYSSTATS_API
+#endif
+
+/**
+ * @brief Highest number of cores tracked by the per-core CPU collector.
+ */
+#define SYSSTATS_MAX_CORES 1024
+
+/**
+ * @brief A structure to hold detailed memory statistics.
+ * 
+ * This structure encapsulates information about the system's memory usage, including
+ * total and used physical memory, as well as total and used virtual memory. It is used
+ * to aggregate memory statistics for easy access and manipulation. All values come from
+ * /proc/meminfo and are in GB.
+ *
+ * @param total_memory Total physical memory available on the system (in GB).
+ * @param used_memory Amount of physical memory currently in use, as total minus free (in GB).
+ * @param total_virtual Total virtual memory available on the system (in GB).
+ * @param used_virtual Amount of virtual memory currently in use (in GB).
+ * @param available Memory available to new work without swapping (MemAvailable).
+ * @param cached Page cache (Cached).
+ * @param buffers Block device buffers (Buffers).
+ * @param dirty Page cache waiting to be written back (Dirty).
+ * @param writeback Page cache being written back (Writeback).
+ * @param anon_pages Anonymous memory mapped by processes (AnonPages).
+ * @param slab Kernel slab caches (Slab).
+ * @param huge_total Memory in the huge page pool (HugePages_Total times Hugepagesize).
+ * @param huge_free Free memory in the huge page pool (HugePages_Free times Hugepagesize).
+ */
+typedef struct {
+    double total_memory;
+    double used_memory;
+    double total_virtual;
+    double used_virtual;
+    double available;
+    double cached;
+    double buffers;
+    double dirty;
+    double writeback;
+    double anon_pages;
+    double slab;
+    double huge_total;
+    double huge_free;
+} SysStatsMemory;
+
+/**
+ * @brief A structure to hold CPU usage statistics.
+ * 
+ * Represents the CPU usage data by storing the total idle time and the total time
+ * spent performing all system activities. This structure can be used to calculate
+ * CPU utilization percentages and to track CPU activity over time.
+ *
+ * @param time Total idle time of the CPU.
+ * @param tot Total time spent on all CPU activities including system, user, and idle processes.
+ */
+typedef struct {
+    long int time;
+    long int tot;
+} SysStatsCpu;
+
+/**
+ * @brief Aggregate and per-core CPU counters from one read of /proc/stat.
+ *
+ * Core N is stored at index N, so counters of the same core line up between samples even
+ * if some cores are offline; offline cores have zero counters. Only the first `ncores`
+ * entries are meaningful, and only those need to be copied (see SYSSTATS_CPU_SAMPLE_SIZE).
+ *
+ * @param total Counters of the aggregate "cpu" line.
+ * @param ncores One more than the highest core number found.
+ * @param cores Counters of the "cpuN" lines, indexed by N.
+ */
+typedef struct {
+    SysStatsCpu total;
+    int ncores;
+    SysStatsCpu cores[SYSSTATS_MAX_CORES];
+} SysStatsCpuSample;
+
+/**
+ * @brief Number of meaningful bytes in a SysStatsCpuSample with `n` cores.
+ */
+#define SYSSTATS_CPU_SAMPLE_SIZE(n) (offsetof(SysStatsCpuSample, cores) + (size_t) (n) * sizeof(SysStatsCpu))
+
+/**
+ * @brief Collector flags of sysstats_open.
+ */
+#define SYSSTATS_MEMORY 0x1
+#define SYSSTATS_CPU 0x2
+#define SYSSTATS_SESSIONS 0x4
+#define SYSSTATS_ALL (SYSSTATS_MEMORY | SYSSTATS_CPU | SYSSTATS_SESSIONS)
+
+/**
+ * @brief An open sampler; see sysstats_open.
+ */
+typedef struct SysStats SysStats;
+
+/**
+ * @brief One sample taken by sysstats_sample.
+ *
+ * Fields of collectors that were not enabled are left as they were.
+ *
+ * @param timestamp CLOCK_MONOTONIC time of the sample in nanoseconds.
+ * @param memory Memory statistics (SYSSTATS_MEMORY).
+ * @param cpu Aggregate and per-core CPU counters (SYSSTATS_CPU).
+ * @param cores Number of processor cores.
+ * @param sessions Number of user sessions in the utmp file (SYSSTATS_SESSIONS).
+ */
+typedef struct {
+    uint64_t timestamp;
+    SysStatsMemory memory;
+    SysStatsCpuSample cpu;
+    int cores;
+    int sessions;
+} SysStatsSnapshot;
+
+/**
+ * @brief Reads every file below a captured directory tree instead of the live system.
+ *
+ * The tree is laid out like /: DIR/proc/stat, DIR/proc/meminfo, DIR/var/run/utmp and so on.
+ * It applies to the whole process and to samplers opened after the call.
+ *
+ * @param dir The directory, or NULL or "/" for the live system.
+ * @return 0 on success, -1 on error with errno set.
+ */
+SYSSTATS_API int sysstats_root(const char *dir);
+
+/**
+ * @brief Opens a sampler and the files its collectors read.
+ *
+ * This is the only call that allocates; the buffers it creates are reused by every sample.
+ *
+ * @param flags The collectors to enable, any of SYSSTATS_MEMORY, SYSSTATS_CPU and SYSSTATS_SESSIONS.
+ * @return The sampler, or NULL on error with errno set.
+ */
+SYSSTATS_API SysStats *sysstats_open(unsigned flags);
+
+/**
+ * @brief Takes one sample of every enabled collector.
+ *
+ * @param stats The sampler.
+ * @param snapshot Receives the sample.
+ * @return 0 on success, -1 on error with errno set.
+ */
+SYSSTATS_API int sysstats_sample(SysStats *stats, SysStatsSnapshot *snapshot);
+
+/**
+ * @brief Closes the files of a sampler and frees it.
+ *
+ * @param stats The sampler, or NULL.
+ * @return void
+ */
+SYSSTATS_API void sysstats_close(SysStats *stats);
+
+/**
+ * @brief Computes the utilization of a CPU between two samples.
+ *
+ * @param previous Counters of the previous sample.
+ * @param current Counters of the current sample.
+ * @return The utilization in percent, 0 if no time passed.
+ */
+SYSSTATS_API double sysstats_cpu_usage(const SysStatsCpu *previous, const SysStatsCpu *current);
+
+/**
+ * @brief Computes the utilization of every core between two samples.
+ *
+ * @param previous Per-core counters of the previous sample.
+ * @param current Per-core counters of the current sample.
+ * @param ncores Number of cores in both arrays.
+ * @param usage Receives the utilization of each core in percent.
+ * @return void
+ */
+SYSSTATS_API void sysstats_core_usage(const SysStatsCpu *previous, const SysStatsCpu *current, int ncores, double *usage);
+
+#endif
@@ -0,0 +1,62 @@
+#!/bin/sh
+# Synthesizes a 256-core, 10000-session host with hundreds of block devices and interfaces from
+# the captured VM fixture and checks what the collectors read from it through --proc-root.
+set -eu
+
+BIN=${1:-./mySystemStats}
+FIXTURE=${2:-fixtures/vm}
+CORES=256
+SESSIONS=10000
+HOST=$(mktemp -d)
+trap 'rm -rf "$HOST"' EXIT
+
+failures=0
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: expected $3, got $2"
+        failures=$((failures + 1))
+    fi
+}
+
+"$BIN" --proc-root="$FIXTURE" --capture="$HOST" --synthesize=$CORES:$SESSIONS >/dev/null
+
+check "cpuinfo processors" "$(grep -c '^processor' "$HOST/proc/cpuinfo")" $CORES
+check "stat core lines" "$(grep -c '^cpu[0-9]' "$HOST/proc/stat")" $CORES
+
+# Two samples of an unchanging host: the cores and sessions are counted, memory is the
+# fixture's, and no CPU time passes between them
+records=$("$BIN" --proc-root="$HOST" --samples=2 --tdelay=10ms --format=jsonl 2>/dev/null)
+last=$(printf '%s\n' "$records" | tail -n 1)
+field() {
+    printf '%s\n' "$last" | sed -n "s/.*\"$1\":\([^,}]*\).*/\1/p"
+}
+check "jsonl records" "$(printf '%s\n' "$records" | wc -l | tr -d ' ')" 2
+check "cores" "$(field cores)" $CORES
+check "sessions" "$(field sessions)" $SESSIONS
+# cpuUsage rounds up by 0.1 point, so an idle interval reads 0.10
+check "cpu usage" "$(field cpu_usage)" 0.10
+total=$(awk '/^MemTotal:/ { printf "%.6f", $2 * 1024 / 1e9 }' "$FIXTURE/proc/meminfo")
+check "total memory" "$(field total_memory_gb)" "$total"
+
+text=$("$BIN" --proc-root="$HOST" --samples=1 --per-core=3 --user --system --pressure 2>/dev/null)
+check "per-core rows" "$(printf '%s\n' "$text" | grep -o ' 255 \[' | wc -l | tr -d ' ')" 1
+check "session rows" "$(printf '%s\n' "$text" | grep -c 'pts/')" $SESSIONS
+load=$(awk '{ print $1, $2, $3 }' "$FIXTURE/proc/loadavg")
+check "load average" "$(printf '%s\n' "$text" | sed -n 's/^Load: \([^ ]* [^ ]* [^ ]*\) .*/\1/p')" "$load"
+
+# Hundreds of loop devices ahead of the only disk, and of veth interfaces: none may be cut off
+awk 'BEGIN { for (i = 0; i < 300; i++) printf "   7 %7d loop%d 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n", i + 100, i + 100 }' >>"$HOST/proc/diskstats"
+echo " 253       0 vdz 100 0 800 50 200 0 1600 80 0 120 130" >>"$HOST/proc/diskstats"
+mkdir -p "$HOST/sys/block/vdz"
+awk 'BEGIN { for (i = 0; i < 200; i++) printf "veth%d: 1000 10 0 0 0 0 0 0 2000 20 0 0 0 0 0 0\n", i }' >>"$HOST/proc/net/dev"
+text=$("$BIN" --proc-root="$HOST" --samples=1 --disk --net 2>/dev/null)
+check "disk after 300 loop devices" "$(printf '%s\n' "$text" | grep -c '^vdz ')" 1
+check "last of 200 veth interfaces" "$(printf '%s\n' "$text" | grep -c '^veth199 ')" 1
+
+if [ $failures -ne 0 ]; then
+    echo "$failures checks failed"
+    exit 1
+fi
+echo "All checks passed"
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Stalls the CPU with more busy loops than there are cores and checks that --psi-trigger wakes
+# the sampling loop between two ticks. Skipped where the kernel has no pressure stall
+# information or refuses the trigger.
+set -eu
+
+BIN=${1:-./mySystemStats}
+
+if [ ! -r /proc/pressure/cpu ]; then
+    echo "skip psi trigger: no /proc/pressure"
+    exit 0
+fi
+
+loops=$(($(nproc) * 2 + 1))
+pids=""
+while [ $loops -gt 0 ]; do
+    sh -c 'while :; do :; done' &
+    pids="$pids $!"
+    loops=$((loops - 1))
+done
+trap 'kill $pids 2>/dev/null' EXIT
+
+# Two ticks 4s apart leave room for at least one 2s trigger window in between
+out=$("$BIN" --samples=2 --tdelay=4s --psi-trigger=50ms 2>&1 | sed 's/\x1b\[[0-9;]*[A-Za-z]//g')
+if printf '%s\n' "$out" | grep -q '^Pressure trigger'; then
+    echo "skip psi trigger: $(printf '%s\n' "$out" | grep '^Pressure trigger' | head -n 1)"
+    exit 0
+fi
+if printf '%s\n' "$out" | grep -q '^Woken by a stall trigger'; then
+    echo "ok   psi trigger wakes the loop"
+    echo "All checks passed"
+else
+    echo "FAIL psi trigger: no wake-up under a CPU stall"
+    exit 1
+fi
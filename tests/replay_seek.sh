@@ -0,0 +1,36 @@
+#!/bin/sh
+# Records more than one keyframe block and checks that --from starts a replay in the middle
+# of a block with the same samples, CPU usage included, as the tail of a full replay.
+set -eu
+
+BIN=${1:-./mySystemStats}
+REC=$(mktemp)
+trap 'rm -f "$REC" "$REC.all" "$REC.from"' EXIT
+# --record appends, so start from no file at all
+rm -f "$REC"
+
+"$BIN" --samples=1100 --tdelay=1ms --record="$REC" --format=csv >/dev/null 2>&1
+"$BIN" --replay="$REC" --format=csv 2>/dev/null > "$REC.all"
+if [ "$(wc -l < "$REC.all")" -ne 1101 ]; then
+    echo "FAIL the recording does not hold 1100 samples"
+    exit 1
+fi
+
+fail=0
+for from in 0 700 1030 1100; do
+    "$BIN" --replay="$REC" --from=$from --format=csv 2>/dev/null | tail -n +2 > "$REC.from"
+    if tail -n +$((from + 2)) "$REC.all" | cmp -s - "$REC.from"; then
+        echo "ok   --from=$from matches the full replay"
+    else
+        echo "FAIL --from=$from differs from the full replay"
+        fail=1
+    fi
+done
+if "$BIN" --replay="$REC" --from=1101 --format=csv >/dev/null 2>&1; then
+    echo "FAIL --from past the end was accepted"
+    fail=1
+else
+    echo "ok   --from past the end is refused"
+fi
+[ $fail -eq 0 ] && echo "All checks passed"
+exit $fail
@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+#include "header.h"
+#include <fcntl.h>
+
+/**
+ * Reads a small file relative to the /proc directory into `buf`, NUL-terminated.
+ */
+static int readAt(int dir_fd, const char *path, char *buf, size_t len) {
+    int fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t n;
+    while ((n = read(fd, buf, len - 1)) == -1 && errno == EINTR);
+    close(fd);
+    if (n <= 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    return 0;
+}
+
+/**
+ * Reads /proc/[pid]/stat and /proc/[pid]/statm of one process. A process that exited
+ * since the directory was listed is marked with pid 0.
+ */
+static void scanPid(int proc_fd, ProcSample *proc) {
+    char path[32], buf[TOP_STAT_SIZE];
+    snprintf(path, sizeof(path), "%d/stat", (int) proc->pid);
+    if (readAt(proc_fd, path, buf, sizeof(buf)) == -1 || parsePidStat(buf, proc) == -1) {
+        proc->pid = 0;
+        return;
+    }
+    snprintf(path, sizeof(path), "%d/statm", (int) proc->pid);
+    if (readAt(proc_fd, path, buf, sizeof(buf)) == -1 || parsePidStatm(buf, &proc->rss_pages) == -1) {
+        proc->pid = 0;
+    }
+}
+
+/**
+ * Scans the listed processes, taking batches from the shared cursor until none are left.
+ */
+static void scanBatches(ProcTop *top) {
+    for (;;) {
+        int first = __atomic_fetch_add(&top->cursor, TOP_BATCH, __ATOMIC_RELAXED);
+        if (first >= top->count) {
+            return;
+        }
+        int last = first + TOP_BATCH < top->count ? first + TOP_BATCH : top->count;
+        for (int k = first; k < last; k++) {
+            scanPid(top->proc_fd, &top->procs[k]);
+        }
+    }
+}
+
+/**
+ * Main loop of a scan thread: wait at the start barrier, scan, meet at the done barrier.
+ */
+static void *scanThread(void *arg) {
+    ProcTop *top = arg;
+    // Wait until topOpen knows whether the whole pool started
+    pthread_mutex_lock(&top->gate);
+    pthread_mutex_unlock(&top->gate);
+    if (top->quit) {
+        return NULL;
+    }
+    for (;;) {
+        pthread_barrier_wait(&top->start);
+        if (top->quit) {
+            return NULL;
+        }
+        scanBatches(top);
+        pthread_barrier_wait(&top->done);
+    }
+}
+
+int topOpen(ProcTop *top, int shown) {
+    memset(top, 0, sizeof(*top));
+    top->shown = shown;
+    top->clock_ticks = sysconf(_SC_CLK_TCK);
+    top->page_size = sysconf(_SC_PAGESIZE);
+    char path[PROC_PATH_LEN];
+    const char *proc = procPath("/proc", path, sizeof(path));
+    top->proc_fd = proc ? open(proc, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    if (top->proc_fd == -1) {
+        return -1;
+    }
+    // The directory stream works on its own descriptor, so that rewinding it does not disturb openat
+    int list_fd = dup(top->proc_fd);
+    if (list_fd == -1 || !(top->dir = fdopendir(list_fd))) {
+        if (list_fd != -1) close(list_fd);
+        close(top->proc_fd);
+        return -1;
+    }
+    top->heap = malloc((size_t) (shown > 0 ? shown : 1) * sizeof(int));
+    if (!top->heap) {
+        topClose(top);
+        return -1;
+    }
+
+    // The caller scans too, so one CPU needs no extra threads
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > TOP_MAX_THREADS ? TOP_MAX_THREADS : (int) cpus;
+    if (threads > 1) {
+        pthread_barrier_init(&top->start, NULL, (unsigned) threads);
+        pthread_barrier_init(&top->done, NULL, (unsigned) threads);
+        pthread_mutex_init(&top->gate, NULL);
+        pthread_mutex_lock(&top->gate);
+        // Leave the signals to the thread that reads them
+        sigset_t block, old;
+        sigfillset(&block);
+        pthread_sigmask(SIG_BLOCK, &block, &old);
+        for (top->threads = 0; top->threads < threads - 1; top->threads++) {
+            if (pthread_create(&top->workers[top->threads], NULL, scanThread, top) != 0) {
+                break;
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        // The barriers were sized for the full pool: without it, the threads that did start quit at the gate
+        top->quit = top->threads < threads - 1;
+        pthread_mutex_unlock(&top->gate);
+        if (top->quit) {
+            topClose(top);
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void topClose(ProcTop *top) {
+    if (top->threads > 0) {
+        // Threads that passed the gate are waiting at the start barrier
+        if (!top->quit) {
+            top->quit = true;
+            pthread_barrier_wait(&top->start);
+        }
+        for (int k = 0; k < top->threads; k++) {
+            pthread_join(top->workers[k], NULL);
+        }
+        pthread_barrier_destroy(&top->start);
+        pthread_barrier_destroy(&top->done);
+        pthread_mutex_destroy(&top->gate);
+        top->threads = 0;
+    }
+    if (top->dir) closedir(top->dir);
+    if (top->proc_fd != -1) close(top->proc_fd);
+    free(top->procs);
+    free(top->table);
+    free(top->previous);
+    free(top->heap);
+    memset(top, 0, sizeof(*top));
+    top->proc_fd = -1;
+}
+
+/**
+ * Lists the numeric entries of /proc into the process array.
+ */
+static int listPids(ProcTop *top) {
+    rewinddir(top->dir);
+    top->count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(top->dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (*name < '1' || *name > '9') {
+            continue;
+        }
+        if (top->count == top->cap) {
+            int new_cap = top->cap ? top->cap * 2 : 1024;
+            ProcSample *grown = realloc(top->procs, (size_t) new_cap * sizeof(ProcSample));
+            if (!grown) {
+                return -1;
+            }
+            top->procs = grown;
+            top->cap = new_cap;
+        }
+        top->procs[top->count++].pid = (pid_t) atoi(name);
+    }
+    return 0;
+}
+
+/**
+ * Hashes a process identity; the start time tells apart processes that reused a pid.
+ */
+static size_t hashProc(pid_t pid, uint64_t starttime, size_t mask) {
+    uint64_t h = ((uint64_t) (uint32_t) pid << 32 | (uint32_t) starttime) * 0x9E3779B97F4A7C15ull;
+    return (size_t) (h >> 32) & mask;
+}
+
+/**
+ * Looks up the CPU ticks a process had at the previous scan.
+ */
+static bool previousTicks(const ProcTop *top, pid_t pid, uint64_t starttime, uint64_t *ticks) {
+    if (!top->previous) {
+        return false;
+    }
+    size_t mask = top->previous_cap - 1;
+    for (size_t k = hashProc(pid, starttime, mask); top->previous[k].pid != 0; k = (k + 1) & mask) {
+        if (top->previous[k].pid == pid && top->previous[k].starttime == starttime) {
+            *ticks = top->previous[k].ticks;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Stores the ticks of every scanned process in a fresh table, for the next scan.
+ */
+static int storeTicks(ProcTop *top) {
+    // Keep the table at most half full so that probe sequences stay short
+    size_t cap = 1024;
+    while (cap < (size_t) top->count * 2) cap *= 2;
+    if (cap > top->table_cap) {
+        ProcTicks *grown = realloc(top->table, cap * sizeof(ProcTicks));
+        if (!grown) {
+            return -1;
+        }
+        top->table = grown;
+        top->table_cap = cap;
+    }
+    memset(top->table, 0, top->table_cap * sizeof(ProcTicks));
+    size_t mask = top->table_cap - 1;
+    for (int k = 0; k < top->count; k++) {
+        const ProcSample *proc = &top->procs[k];
+        if (proc->pid == 0) continue;
+        size_t slot = hashProc(proc->pid, proc->starttime, mask);
+        while (top->table[slot].pid != 0) slot = (slot + 1) & mask;
+        top->table[slot].pid = proc->pid;
+        top->table[slot].starttime = proc->starttime;
+        top->table[slot].ticks = proc->ticks;
+    }
+    // The new table is the previous one of the next scan
+    ProcTicks *swap = top->previous;
+    size_t swap_cap = top->previous_cap;
+    top->previous = top->table;
+    top->previous_cap = top->table_cap;
+    top->table = swap;
+    top->table_cap = swap_cap;
+    return 0;
+}
+
+/**
+ * Orders two processes for the top list: busier first, then larger.
+ */
+static bool busier(const ProcSample *a, const ProcSample *b) {
+    return a->cpu != b->cpu ? a->cpu > b->cpu : a->rss_pages > b->rss_pages;
+}
+
+/**
+ * Restores the min-heap order of the top list below `k`, with the least busy process at the root.
+ */
+static void siftDown(const ProcSample *procs, int *heap, int len, int k) {
+    for (;;) {
+        int least = k, left = 2 * k + 1, right = left + 1;
+        if (left < len && busier(&procs[heap[least]], &procs[heap[left]])) least = left;
+        if (right < len && busier(&procs[heap[least]], &procs[heap[right]])) least = right;
+        if (least == k) {
+            return;
+        }
+        int swap = heap[k];
+        heap[k] = heap[least];
+        heap[least] = swap;
+        k = least;
+    }
+}
+
+/**
+ * Selects the `shown` busiest processes with a bounded min-heap, then orders them busiest first.
+ */
+static void selectTop(ProcTop *top) {
+    int len = 0;
+    for (int k = 0; k < top->count; k++) {
+        if (top->procs[k].pid == 0) {
+            continue;
+        }
+        if (len < top->shown) {
+            // Sift the new process up from the bottom
+            int j = len++;
+            top->heap[j] = k;
+            while (j > 0 && busier(&top->procs[top->heap[(j - 1) / 2]], &top->procs[top->heap[j]])) {
+                int swap = top->heap[j];
+                top->heap[j] = top->heap[(j - 1) / 2];
+                top->heap[(j - 1) / 2] = swap;
+                j = (j - 1) / 2;
+            }
+        }
+        else if (len > 0 && busier(&top->procs[k], &top->procs[top->heap[0]])) {
+            top->heap[0] = k;
+            siftDown(top->procs, top->heap, len, 0);
+        }
+    }
+    // Popping the least busy process to the back leaves the heap sorted busiest first
+    top->found = len;
+    while (len > 1) {
+        int swap = top->heap[0];
+        top->heap[0] = top->heap[--len];
+        top->heap[len] = swap;
+        siftDown(top->procs, top->heap, len, 0);
+    }
+}
+
+int topScan(ProcTop *top, uint64_t timestamp) {
+    uint64_t start = nowNanos();
+    if (listPids(top) == -1) {
+        return -1;
+    }
+    top->cursor = 0;
+    if (top->threads > 0 && top->count >= TOP_PARALLEL_MIN) {
+        pthread_barrier_wait(&top->start);
+        scanBatches(top);
+        pthread_barrier_wait(&top->done);
+    }
+    else {
+        scanBatches(top);
+    }
+
+    // CPU usage in percent of one core, like top
+    double elapsed = top->last ? (double) (timestamp - top->last) / 1e9 : 0;
+    top->live = 0;
+    for (int k = 0; k < top->count; k++) {
+        ProcSample *proc = &top->procs[k];
+        if (proc->pid == 0) continue;
+        top->live++;
+        uint64_t before = 0;
+        proc->cpu = 0;
+        // A process first seen in this scan may have run for far longer than the interval, so it
+        // shows 0% until the next scan gives it a delta
+        if (elapsed > 0 && previousTicks(top, proc->pid, proc->starttime, &before)) {
+            if (proc->ticks > before) {
+                proc->cpu = 100.0 * (double) (proc->ticks - before) / ((double) top->clock_ticks * elapsed);
+            }
+        }
+    }
+    if (storeTicks(top) == -1) {
+        return -1;
+    }
+    selectTop(top);
+    top->last = timestamp;
+    top->scans++;
+    top->scan_ns = nowNanos() - start;
+    return 0;
+}
+
+void topOutput(Frame *frame, const ProcTop *top) {
+    framePrintf(frame, "--------------------------------------------\n");
+    framePrintf(frame, "### Top processes ### (%d of %d, scanned in %.2f ms)\n", top->found, top->live, top->scan_ns / 1e6);
+    framePrintf(frame, "%8s %7s %10s  %s\n", "PID", "CPU%", "RSS (MB)", "COMMAND");
+    for (int j = 0; j < top->found; j++) {
+        const ProcSample *proc = &top->procs[top->heap[j]];
+        framePrintf(frame, "%8d %7.1f %10.1f  %s\n", (int) proc->pid, proc->cpu,
+                    (double) proc->rss_pages * top->page_size / (1024.0 * 1024.0), proc->comm);
+    }
+}
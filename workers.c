@@ -0,0 +1,427 @@
+#include "header.h"
+
+int writeFull(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int readFull(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            // The other end went away before sending the whole message
+            errno = EPIPE;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+void freeSampleSet(SampleSet *set) {
+    free(set->sessions);
+    set->sessions = NULL;
+    set->sessions_len = 0;
+    set->sessions_cap = 0;
+}
+
+/**
+ * Makes sure the session buffer of a sample set can hold `len` bytes.
+ */
+static int reserveSessions(SampleSet *set, size_t len) {
+    if (len <= set->sessions_cap) {
+        return 0;
+    }
+    char *grown = realloc(set->sessions, len);
+    if (!grown) {
+        return -1;
+    }
+    set->sessions = grown;
+    set->sessions_cap = len;
+    return 0;
+}
+
+/**
+ * Collects one sample for the worker's collector and writes the reply to its data pipe.
+ * The session list is kept between calls and only sent again when utmp changed.
+ */
+static int workerReply(CollectorWorker *worker, SessionWatch *sessions) {
+    WorkerReply reply = {0, 0, false, 0, 0, 0, 0};
+    MemoryInfo memory;
+    CpuSample cpu;
+    const void *payload = NULL;
+    int changed;
+    uint64_t start = nowNanos();
+
+    switch (worker->kind) {
+        case COLLECT_MEMORY:
+            if (readMemoryInfo(&memory) != 0) reply.status = errno;
+            payload = &memory;
+            reply.length = sizeof(memory);
+            break;
+        case COLLECT_CPU:
+            if (readCpuStats(&cpu) != 0) reply.status = errno;
+            payload = &cpu;
+            reply.length = CPU_SAMPLE_SIZE(cpu.ncores);
+            break;
+        default:
+            if ((changed = sessionsRefresh(sessions)) == -1) reply.status = errno;
+            payload = sessions->list;
+            reply.unchanged = changed == 0;
+            reply.length = reply.unchanged ? 0 : sessions->len;
+            reply.logins = sessions->logins;
+            reply.logouts = sessions->logouts;
+            break;
+    }
+    if (reply.status != 0) {
+        reply.length = 0;
+    }
+    reply.elapsed = nowNanos() - start;
+    // Only meaningful for a worker process; a thread's time is already the parent's
+    reply.cpu_time = selfCpuTime();
+    if (writeFull(worker->data[1], &reply, sizeof(reply)) == -1) {
+        return -1;
+    }
+    return writeFull(worker->data[1], payload, reply.length);
+}
+
+/**
+ * Main loop of a persistent worker: wait for a command, answer it, repeat.
+ * The loop ends on WORKER_QUIT, or when the parent closes the command pipe.
+ */
+static void workerLoop(CollectorWorker *worker) {
+    SessionWatch sessions;
+    if (worker->kind == COLLECT_USER) sessionsOpen(&sessions);
+    char command;
+    while (readFull(worker->cmd[0], &command, 1) == 0 && command == WORKER_SAMPLE) {
+        if (workerReply(worker, &sessions) == -1) {
+            break;
+        }
+    }
+    if (worker->kind == COLLECT_USER) sessionsClose(&sessions);
+}
+
+static void *workerThread(void *arg) {
+    workerLoop(arg);
+    return NULL;
+}
+
+/**
+ * Starts the persistent worker of one collector, as a child process or as a thread.
+ */
+static int startWorker(SampleEngine *engine, CollectorWorker *worker) {
+    if (pipe(worker->cmd) == -1) {
+        return -1;
+    }
+    if (pipe(worker->data) == -1) {
+        close(worker->cmd[0]); close(worker->cmd[1]);
+        return -1;
+    }
+
+    if (engine->mode == ENGINE_THREAD) {
+        // Leave the interactive signals to the main thread
+        sigset_t block, old;
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        sigaddset(&block, SIGTSTP);
+        pthread_sigmask(SIG_BLOCK, &block, &old);
+        int err = pthread_create(&worker->thread, NULL, workerThread, worker);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (err != 0) {
+            close(worker->cmd[0]); close(worker->cmd[1]);
+            close(worker->data[0]); close(worker->data[1]);
+            errno = err;
+            return -1;
+        }
+        worker->running = true;
+        return 0;
+    }
+
+    fflush(stdout);
+    worker->pid = fork();
+    if (worker->pid == -1) {
+        close(worker->cmd[0]); close(worker->cmd[1]);
+        close(worker->data[0]); close(worker->data[1]);
+        return -1;
+    }
+    else if (worker->pid == 0) {
+        // The quit prompt belongs to the parent
+        signal(SIGINT, SIG_IGN);
+        signal(SIGTSTP, SIG_IGN);
+        close(worker->cmd[1]);
+        close(worker->data[0]);
+        // Drop the pipes of the workers started before this one
+        for (int k = 0; k < COLLECT_COUNT; k++) {
+            CollectorWorker *other = &engine->workers[k];
+            if (other != worker && other->running) {
+                close(other->cmd[1]);
+                close(other->data[0]);
+            }
+        }
+        workerLoop(worker);
+        exit(EXIT_SUCCESS);
+    }
+    close(worker->cmd[0]);
+    close(worker->data[1]);
+    worker->running = true;
+    return 0;
+}
+
+int startEngine(SampleEngine *engine, EngineMode mode, bool sys, bool user) {
+    memset(engine, 0, sizeof(*engine));
+    engine->sessions.fd = -1;
+    engine->sessions.wd = -1;
+    engine->mode = mode;
+    engine->enabled[COLLECT_MEMORY] = sys;
+    engine->enabled[COLLECT_CPU] = sys;
+    engine->enabled[COLLECT_USER] = user;
+    if (mode == ENGINE_FORK) {
+        return 0;
+    }
+    if (mode == ENGINE_INLINE) {
+        // Sessions are listed by the session watch, which libsysstats only counts
+        if (sys && (!(engine->memory_stats = sysstats_open(SYSSTATS_MEMORY)) || !(engine->cpu_stats = sysstats_open(SYSSTATS_CPU)))) {
+            int saved = errno;
+            stopEngine(engine);
+            errno = saved;
+            return -1;
+        }
+        if (user) sessionsOpen(&engine->sessions);
+        return 0;
+    }
+    for (int k = 0; k < COLLECT_COUNT; k++) {
+        engine->workers[k].kind = (CollectorKind) k;
+        if (engine->enabled[k] && startWorker(engine, &engine->workers[k]) == -1) {
+            int saved = errno;
+            stopEngine(engine);
+            errno = saved;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void stopEngine(SampleEngine *engine) {
+    sysstats_close(engine->memory_stats);
+    sysstats_close(engine->cpu_stats);
+    engine->memory_stats = NULL;
+    engine->cpu_stats = NULL;
+    sessionsClose(&engine->sessions);
+    for (int k = 0; k < COLLECT_COUNT; k++) {
+        CollectorWorker *worker = &engine->workers[k];
+        if (!worker->running) {
+            continue;
+        }
+        char command = WORKER_QUIT;
+        writeFull(worker->cmd[1], &command, 1);
+        close(worker->cmd[1]);
+        if (engine->mode == ENGINE_THREAD) {
+            pthread_join(worker->thread, NULL);
+            close(worker->cmd[0]);
+            close(worker->data[1]);
+        }
+        else {
+            waitpid(worker->pid, NULL, 0);
+        }
+        close(worker->data[0]);
+        worker->running = false;
+    }
+}
+
+/**
+ * Reads one worker reply into the matching field of the sample set.
+ */
+static int readReply(CollectorWorker *worker, SampleSet *set) {
+    WorkerReply reply;
+    if (readFull(worker->data[0], &reply, sizeof(reply)) == -1) {
+        return -1;
+    }
+    if (reply.status != 0) {
+        errno = reply.status;
+        return -1;
+    }
+    set->collect_ns[worker->kind] = reply.elapsed;
+    worker->cpu_time = reply.cpu_time;
+    switch (worker->kind) {
+        case COLLECT_MEMORY:
+            return readFull(worker->data[0], &set->memory, sizeof(set->memory));
+        case COLLECT_CPU:
+            if (reply.length < CPU_SAMPLE_SIZE(0) || reply.length > sizeof(set->cpu)) {
+                errno = EPROTO;
+                return -1;
+            }
+            return readFull(worker->data[0], &set->cpu, reply.length);
+        default:
+            set->logins = reply.logins;
+            set->logouts = reply.logouts;
+            if (reply.unchanged) {
+                return 0;
+            }
+            if (reserveSessions(set, reply.length) == -1) {
+                return -1;
+            }
+            set->sessions_version++;
+            set->sessions_len = reply.length;
+            return readFull(worker->data[0], set->sessions, reply.length);
+    }
+}
+
+/**
+ * Forks one short-lived child for a collector, the way every sample used to be taken.
+ */
+static pid_t forkCollector(CollectorKind kind, int pipefd[2]) {
+    // Do not let the child flush a copy of our pending output when it exits
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+    close(pipefd[0]);
+    if (kind == COLLECT_MEMORY) memoryStats(pipefd);
+    else if (kind == COLLECT_CPU) cpuStats(pipefd);
+    else userOutput(pipefd);
+    close(pipefd[1]);
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * Takes one sample with the original engine: a new pipe and a new child per collector.
+ */
+static int forkSample(SampleEngine *engine, SampleSet *set) {
+    int pipes[COLLECT_COUNT][2];
+    pid_t pids[COLLECT_COUNT];
+    int status = 0;
+    // The children run side by side: each collector's time runs from the first fork until its data is read
+    uint64_t start = nowNanos();
+
+    for (int k = 0; k < COLLECT_COUNT; k++) {
+        pids[k] = -1;
+        if (!engine->enabled[k]) {
+            continue;
+        }
+        if (pipe(pipes[k]) == -1 || (pids[k] = forkCollector((CollectorKind) k, pipes[k])) == -1) {
+            status = -1;
+            break;
+        }
+        close(pipes[k][1]);
+    }
+    for (int k = 0; k < COLLECT_COUNT; k++) {
+        if (pids[k] == -1) {
+            continue;
+        }
+        if (status == 0) {
+            if (k == COLLECT_MEMORY) {
+                status = readFull(pipes[k][0], &set->memory, sizeof(set->memory));
+            }
+            else if (k == COLLECT_CPU) {
+                // The per-core counters follow the fixed part of the sample
+                status = readFull(pipes[k][0], &set->cpu, CPU_SAMPLE_SIZE(0));
+                if (status == 0 && (set->cpu.ncores < 0 || set->cpu.ncores > MAX_CORES)) {
+                    errno = EPROTO;
+                    status = -1;
+                }
+                if (status == 0) {
+                    status = readFull(pipes[k][0], set->cpu.cores, (size_t) set->cpu.ncores * sizeof(CPU));
+                }
+            }
+            else {
+                // Session lines arrive until the child closes the pipe
+                set->sessions_len = 0;
+                ssize_t bytesRead;
+                do {
+                    if (reserveSessions(set, set->sessions_len + MAX_STR_LEN) == -1) {
+                        status = -1;
+                        break;
+                    }
+                    bytesRead = read(pipes[k][0], set->sessions + set->sessions_len, MAX_STR_LEN);
+                    if (bytesRead > 0) set->sessions_len += bytesRead;
+                } while (bytesRead > 0 || (bytesRead == -1 && errno == EINTR));
+            }
+        }
+        close(pipes[k][0]);
+        while (waitpid(pids[k], NULL, 0) == -1 && errno == EINTR);
+        set->collect_ns[k] = nowNanos() - start;
+    }
+    return status;
+}
+
+/**
+ * Takes one sample in the calling thread, through libsysstats and the session watch.
+ */
+static int inlineSample(SampleEngine *engine, SampleSet *set) {
+    uint64_t start = nowNanos();
+    if (engine->memory_stats) {
+        if (sysstats_sample(engine->memory_stats, &engine->snapshot) == -1) {
+            return -1;
+        }
+        set->memory = engine->snapshot.memory;
+        set->collect_ns[COLLECT_MEMORY] = nowNanos() - start;
+    }
+    start = nowNanos();
+    if (engine->cpu_stats) {
+        if (sysstats_sample(engine->cpu_stats, &engine->snapshot) == -1) {
+            return -1;
+        }
+        memcpy(&set->cpu, &engine->snapshot.cpu, CPU_SAMPLE_SIZE(engine->snapshot.cpu.ncores));
+        set->collect_ns[COLLECT_CPU] = nowNanos() - start;
+    }
+    start = nowNanos();
+    if (engine->enabled[COLLECT_USER]) {
+        SessionWatch *watch = &engine->sessions;
+        if (sessionsRefresh(watch) == -1) {
+            return -1;
+        }
+        set->logins = watch->logins;
+        set->logouts = watch->logouts;
+        // The set only gets a new copy of the list when it changed
+        if (set->sessions_version != watch->version) {
+            if (reserveSessions(set, watch->len) == -1) {
+                return -1;
+            }
+            if (watch->len > 0) memcpy(set->sessions, watch->list, watch->len);
+            set->sessions_len = watch->len;
+            set->sessions_version = watch->version;
+        }
+        set->collect_ns[COLLECT_USER] = nowNanos() - start;
+    }
+    return 0;
+}
+
+int engineSample(SampleEngine *engine, SampleSet *set) {
+    if (engine->mode == ENGINE_FORK) {
+        return forkSample(engine, set);
+    }
+    if (engine->mode == ENGINE_INLINE) {
+        return inlineSample(engine, set);
+    }
+    // Wake every worker first so that the collectors run in parallel
+    char command = WORKER_SAMPLE;
+    for (int k = 0; k < COLLECT_COUNT; k++) {
+        if (engine->workers[k].running && writeFull(engine->workers[k].cmd[1], &command, 1) == -1) {
+            return -1;
+        }
+    }
+    set->worker_cpu = 0;
+    for (int k = 0; k < COLLECT_COUNT; k++) {
+        if (engine->workers[k].running && readReply(&engine->workers[k], set) == -1) {
+            return -1;
+        }
+        if (engine->mode == ENGINE_PROCESS) set->worker_cpu += engine->workers[k].cpu_time;
+    }
+    return 0;
+}